@@ -30,12 +30,16 @@
  *
  */
 
+#define DEBUG_MODULE DBG_APP
+
 #include <app.h>
 #include <debug.h>
 #include <arch/arm.h>
 #include <dev/udc.h>
 #include <string.h>
+#include <stdlib.h>
 #include <kernel/thread.h>
+#include <kernel/event.h>
 #include <arch/ops.h>
 
 #include <dev/flash.h>
@@ -49,16 +53,23 @@
 #include <platform.h>
 #include <crypto_hash.h>
 #include <smem.h> //ML
+#include <smp.h>
 
 #if DEVICE_TREE
 #include <libfdt.h>
 #endif
 
+#if WITH_LIB_PROFILE
+#include <lib/profile.h>
+#endif
+
 #include "image_verify.h"
 #include "recovery.h"
 #include "bootimg.h"
 #include "fastboot.h"
 #include "sparse_format.h"
+#include "nand_tag_format.h"
+#include "boot_payload.h"
 #include "mmc.h"
 #include "devinfo.h"
 #include "board.h"
@@ -82,7 +93,9 @@
 #define DEV_TREE_SUCCESS        0
 #define DEV_TREE_MAGIC          "QCDT"
 #define DEV_TREE_VERSION        1
+#define DEV_TREE_VERSION_V2     2	/* entries sorted, table may span pages */
 #define DEV_TREE_HEADER_SIZE    12
+#define DEV_TREE_MAX_ENTRIES    4096
 
 
 struct dt_entry{
@@ -99,6 +112,7 @@ struct dt_table{
 	unsigned num_entries;
 };
 struct dt_entry * get_device_tree_ptr(struct dt_table *);
+unsigned dev_tree_table_size(const struct dt_table *);
 int update_device_tree(const void *, char *, void *, unsigned);
 #endif
 
@@ -126,9 +140,6 @@ static const char *baseband_sglte   = " androidboot.baseband=sglte";
 /* Assuming unauthorized kernel image by default */
 static int auth_kernel_img = 0;
 
-/* TODO: The size is hard coded */
-static unsigned char cpr_buf[4096];
-
 static device_info device = {DEVICE_MAGIC, 0, 0};
 
 static struct udc_device surf_udc_device = {
@@ -269,7 +280,7 @@ boot_mode_type get_boot_mode_from_misc()
 	}
 }
 
-boot_mode_type get_boot_mode()
+static boot_mode_type eval_boot_mode()
 {
 	unsigned res;
 	boot_mode_type bootmode;
@@ -292,6 +303,20 @@ boot_mode_type get_boot_mode()
 	return bootmode;
 }
 
+/* Evaluated once: misc, the power on reason and boot_into_recovery are
+ * settled by the time the boot image is loaded */
+boot_mode_type get_boot_mode()
+{
+	static boot_mode_type bootmode;
+	static int bootmode_valid;
+
+	if (!bootmode_valid) {
+		bootmode = eval_boot_mode();
+		bootmode_valid = 1;
+	}
+	return bootmode;
+}
+
 static void ptentry_to_tag(unsigned **ptr, struct ptentry *ptn)
 {
 	struct atag_ptbl_entry atag_ptn;
@@ -582,6 +607,60 @@ void generate_atags(unsigned *ptr, const char *cmdline,
 	ptr = atag_end(ptr);
 }
 
+#if NAND_SCRUB
+/*
+ * Blocks of the NAND boot partition whose reads came close to the ECC
+ * limit are rewritten by a thread while the kernel is being prepared;
+ * boot_linux() waits for it before leaving LK.
+ *
+ * A block is erased before its data is programmed back, so losing power
+ * in between leaves a hole in the image just booted from. Only enable
+ * this on targets that can still reach recovery or fastboot when boot
+ * does not verify.
+ */
+static event_t nand_scrub_done;
+static int nand_scrub_running;
+
+static int nand_scrub_thread(void *arg)
+{
+	struct ptentry *ptn = arg;
+	int ret;
+
+	ret = flash_scrub(ptn, NAND_SCRUB_THRESHOLD);
+	if (ret)
+		dprintf(INFO, "nand scrub: '%s' %d blocks rewritten\n",
+			ptn->name, ret);
+	event_signal(&nand_scrub_done, false);
+	return 0;
+}
+
+static void nand_scrub_start(struct ptentry *ptn)
+{
+	thread_t *thr;
+
+	event_init(&nand_scrub_done, false, 0);
+	thr = thread_create("nand_scrub", nand_scrub_thread, ptn,
+			    DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+	if (thr == NULL) {
+		nand_scrub_thread(ptn);
+		return;
+	}
+	nand_scrub_running = 1;
+	thread_resume(thr);
+}
+
+static void nand_scrub_wait(void)
+{
+	if (nand_scrub_running) {
+		event_wait(&nand_scrub_done);
+		nand_scrub_running = 0;
+	}
+}
+#else
+static void nand_scrub_start(struct ptentry *ptn) { }
+static void nand_scrub_wait(void) { }
+#endif
+
 void boot_linux(void *kernel, unsigned *tags,
 		const char *cmdline, unsigned machtype,
 		void *ramdisk, unsigned ramdisk_size)
@@ -607,6 +686,20 @@ void boot_linux(void *kernel, unsigned *tags,
 	if (cmdline)
 		dprintf(INFO, "cmdline: %s\n", cmdline);
 
+	if (target_is_emmc_boot())
+		boot_state_flush();
+	else
+		nand_scrub_wait();
+
+	/* deferred records go into the log before it is saved */
+	dlog_flush();
+
+	/* only the tail logged since the last save is left to write */
+	save_debug_message_flush();
+
+	/* the kernel brings the second core up itself */
+	smp_park();
+
 	enter_critical_section();
 	/* do any platform specific cleanup before kernel entry */
 	platform_uninit();
@@ -650,10 +743,13 @@ int boot_linux_from_mmc(void)
 	unsigned dt_actual = 0;
 	boot_mode_type boot_mode;
 	struct cpr_status_info info;
+	struct boot_source src;
+	int ret;
 
 #if DEVICE_TREE
 	struct dt_table *table;
 	struct dt_entry *dt_entry_ptr;
+	struct dt_entry dt_entry;
 	unsigned dt_table_offset;
 #endif
 
@@ -742,21 +838,30 @@ int boot_linux_from_mmc(void)
 		}
 
 		/* Move kernel, ramdisk and device tree to correct address */
-		memmove((void*) hdr->kernel_addr, (char *)(image_addr + page_size), hdr->kernel_size);
-		memmove((void*) hdr->ramdisk_addr, (char *)(image_addr + page_size + kernel_actual), hdr->ramdisk_size);
+		ret = boot_payload_unpack("kernel", image_addr + page_size,
+					  hdr->kernel_size, (void *)hdr->kernel_addr,
+					  boot_payload_room(hdr, hdr->kernel_addr), 0);
+		if (ret < 0)
+			return -1;
+		hdr->kernel_size = ret;
+
+		ret = boot_payload_unpack("ramdisk", image_addr + page_size + kernel_actual,
+					  hdr->ramdisk_size, (void *)hdr->ramdisk_addr,
+					  boot_payload_room(hdr, hdr->ramdisk_addr),
+					  BOOT_PAYLOAD_RAW_FALLBACK);
+		if (ret < 0)
+			return -1;
+		hdr->ramdisk_size = ret;
 
 		#if DEVICE_TREE
 		if(hdr->dt_size) {
-			table = (struct dt_table*) dt_buf;
 			dt_table_offset = (image_addr + page_size + kernel_actual + ramdisk_actual + second_actual);
 
-			memmove((void *) dt_buf, (char *)dt_table_offset, page_size);
-
-			/* Restriction that the device tree entry table should be less than a page*/
-			ASSERT(((table->num_entries * sizeof(struct dt_entry))+ DEV_TREE_HEADER_SIZE) < hdr->page_size);
+			/* the whole image is in memory, use the table in place */
+			table = (struct dt_table*) dt_table_offset;
 
 			/* Validate the device tree table header */
-			if((table->magic != DEV_TREE_MAGIC) && (table->version != DEV_TREE_VERSION)) {
+			if (!dev_tree_table_size(table)) {
 				dprintf(CRITICAL, "ERROR: Cannot validate Device Tree Table \n");
 				return -1;
 			}
@@ -785,24 +890,33 @@ int boot_linux_from_mmc(void)
 	}
 	else
 	{
-		offset += page_size;
-
-		n = ROUND_TO_PAGE(hdr->kernel_size, page_mask);
-		if (mmc_read(ptn + offset, (void *)hdr->kernel_addr, n)) {
+		src.mmc_ptn = ptn;
+		src.flash_ptn = NULL;
+		src.offset = page_size;
+		src.page_mask = page_mask;
+
+		ret = boot_payload_load(&src, "kernel", hdr->kernel_size,
+					(void *)hdr->kernel_addr,
+					boot_payload_room(hdr, hdr->kernel_addr), 0);
+		if (ret < 0) {
 			dprintf(CRITICAL, "ERROR: Cannot read kernel image\n");
 					return -1;
 		}
-		offset += n;
+		hdr->kernel_size = ret;
 
-		n = ROUND_TO_PAGE(hdr->ramdisk_size, page_mask);
-		if(n != 0)
+		if(hdr->ramdisk_size != 0)
 		{
-			if (mmc_read(ptn + offset, (void *)hdr->ramdisk_addr, n)) {
+			ret = boot_payload_load(&src, "ramdisk", hdr->ramdisk_size,
+						(void *)hdr->ramdisk_addr,
+						boot_payload_room(hdr, hdr->ramdisk_addr),
+						BOOT_PAYLOAD_RAW_FALLBACK);
+			if (ret < 0) {
 				dprintf(CRITICAL, "ERROR: Cannot read ramdisk image\n");
 				return -1;
 			}
+			hdr->ramdisk_size = ret;
 		}
-		offset += n;
+		offset = src.offset;
 
 		if(hdr->second_size != 0) {
 			n = ROUND_TO_PAGE(hdr->second_size, page_mask);
@@ -819,25 +933,39 @@ int boot_linux_from_mmc(void)
 			}
 			table = (struct dt_table*) dt_buf;
 
-			/* Restriction that the device tree entry table should be less than a page*/
-			ASSERT(((table->num_entries * sizeof(struct dt_entry))+ DEV_TREE_HEADER_SIZE) < hdr->page_size);
-
 			/* Validate the device tree table header */
-			if((table->magic != DEV_TREE_MAGIC) && (table->version != DEV_TREE_VERSION)) {
+			n = dev_tree_table_size(table);
+			if (!n) {
 				dprintf(CRITICAL, "ERROR: Cannot validate Device Tree Table \n");
 				return -1;
 			}
 
+			/* the rest of a table spanning several pages */
+			if (n > page_size) {
+				n = ROUND_TO_PAGE(n, page_mask);
+				table = malloc(n);
+				if (!table || mmc_read(ptn + offset, (unsigned int *) table, n)) {
+					dprintf(CRITICAL, "ERROR: Cannot read the Device Tree Table\n");
+					free(table);
+					return -1;
+				}
+			}
+
 			/* Calculate the offset of device tree within device tree table */
 			if((dt_entry_ptr = get_device_tree_ptr(table)) == NULL){
 				dprintf(CRITICAL, "ERROR: Getting device tree address failed\n");
+				if (table != (struct dt_table*) dt_buf)
+					free(table);
 				return -1;
 			}
+			dt_entry = *dt_entry_ptr;
+			if (table != (struct dt_table*) dt_buf)
+				free(table);
 
-			/* Read device device tree in the "tags_add */
+			/* Read only the selected device tree, to "tags_addr" */
 			hdr->tags_addr = 0x8400000;
-			if(mmc_read(ptn + offset + dt_entry_ptr->offset,
-						 (void *)hdr->tags_addr, dt_entry_ptr->size)) {
+			if(mmc_read(ptn + offset + dt_entry.offset,
+						 (void *)hdr->tags_addr, ROUND_TO_PAGE(dt_entry.size, page_mask))) {
 				dprintf(CRITICAL, "ERROR: Cannot read device tree\n");
 				return -1;
 			}
@@ -882,7 +1010,6 @@ unified_boot:
 int boot_linux_from_flash(void)
 {
 	struct boot_img_hdr *hdr = (void*) buf;
-	unsigned n;
 	struct ptentry *ptn;
 	struct ptable *ptable;
 	unsigned offset = 0;
@@ -892,6 +1019,8 @@ int boot_linux_from_flash(void)
 	unsigned kernel_actual;
 	unsigned ramdisk_actual;
 	unsigned imagesize_actual;
+	struct boot_source src;
+	int ret;
 
 	if (target_is_emmc_boot()) {
 		hdr = (struct boot_img_hdr *)EMMC_BOOT_IMG_HEADER_ADDR;
@@ -983,8 +1112,20 @@ int boot_linux_from_flash(void)
 		}
 
 		/* Move kernel and ramdisk to correct address */
-		memmove((void*) hdr->kernel_addr, (char *)(image_addr + page_size), hdr->kernel_size);
-		memmove((void*) hdr->ramdisk_addr, (char *)(image_addr + page_size + kernel_actual), hdr->ramdisk_size);
+		ret = boot_payload_unpack("kernel", image_addr + page_size,
+					  hdr->kernel_size, (void *)hdr->kernel_addr,
+					  boot_payload_room(hdr, hdr->kernel_addr), 0);
+		if (ret < 0)
+			return -1;
+		hdr->kernel_size = ret;
+
+		ret = boot_payload_unpack("ramdisk", image_addr + page_size + kernel_actual,
+					  hdr->ramdisk_size, (void *)hdr->ramdisk_addr,
+					  boot_payload_room(hdr, hdr->ramdisk_addr),
+					  BOOT_PAYLOAD_RAW_FALLBACK);
+		if (ret < 0)
+			return -1;
+		hdr->ramdisk_size = ret;
 
 		/* Make sure everything from scratch address is read before next step!*/
 		if(device.is_tampered)
@@ -997,22 +1138,32 @@ int boot_linux_from_flash(void)
 	}
 	else
 	{
-		offset = page_size;
-
-		n = ROUND_TO_PAGE(hdr->kernel_size, page_mask);
-		if (flash_read(ptn, offset, (void *)hdr->kernel_addr, n)) {
+		src.mmc_ptn = 0;
+		src.flash_ptn = ptn;
+		src.offset = page_size;
+		src.page_mask = page_mask;
+
+		ret = boot_payload_load(&src, "kernel", hdr->kernel_size,
+					(void *)hdr->kernel_addr,
+					boot_payload_room(hdr, hdr->kernel_addr), 0);
+		if (ret < 0) {
 			dprintf(CRITICAL, "ERROR: Cannot read kernel image\n");
 			return -1;
 		}
-		offset += n;
+		hdr->kernel_size = ret;
 
-		n = ROUND_TO_PAGE(hdr->ramdisk_size, page_mask);
-		if (flash_read(ptn, offset, (void *)hdr->ramdisk_addr, n)) {
+		ret = boot_payload_load(&src, "ramdisk", hdr->ramdisk_size,
+					(void *)hdr->ramdisk_addr,
+					boot_payload_room(hdr, hdr->ramdisk_addr),
+					BOOT_PAYLOAD_RAW_FALLBACK);
+		if (ret < 0) {
 			dprintf(CRITICAL, "ERROR: Cannot read ramdisk image\n");
 			return -1;
 		}
-		offset += n;
+		hdr->ramdisk_size = ret;
+		offset = src.offset;
 	}
+	nand_scrub_start(ptn);
 continue_boot:
 	dprintf(INFO, "\nkernel  @ %x (%d bytes)\n", hdr->kernel_addr,
 		hdr->kernel_size);
@@ -1036,53 +1187,124 @@ continue_boot:
 	return 0;
 }
 
-unsigned char info_buf[4096];
-void write_device_info_mmc(device_info *dev)
+/*
+ * eMMC bootloader state: the small records read on every boot are loaded
+ * once, kept here, and written back together by boot_state_flush().
+ * The fastmmi message shares the first misc sector with the recovery
+ * message, so the two are one record. CPR (48K into misc) and devinfo
+ * (end of aboot) are too far apart for a merged read to beat separate
+ * commands.
+ */
+#define BOOT_STATE_MISC_MSG_SIZE	ROUND_TO_PAGE(sizeof(struct recovery_message), 511)
+
+static unsigned char bs_misc_msg[BOOT_STATE_MISC_MSG_SIZE] __ALIGNED(CACHE_LINE);
+static unsigned char bs_cpr[512] __ALIGNED(CACHE_LINE);
+static unsigned char bs_devinfo[512] __ALIGNED(CACHE_LINE);
+
+static struct boot_state_rec {
+	const char *ptn;
+	unsigned long long offset;	/* from the end of ptn if from_end */
+	unsigned from_end;
+	unsigned char *buf;
+	unsigned size;
+	unsigned long long addr;	/* resolved card address, 0 if unknown */
+	unsigned loaded;
+	unsigned dirty;
+} boot_state[BOOT_STATE_MAX] = {
+	[BOOT_STATE_MISC_MSG] = {
+		.ptn = "misc",
+		.offset = 0,
+		.buf = bs_misc_msg,
+		.size = sizeof(bs_misc_msg),
+	},
+	[BOOT_STATE_CPR] = {
+		.ptn = "misc",
+		.offset = SZ_MISC_BOOT_REASON + SZ_MISC_SWITCH_CTL + SZ_MISC_LOG,
+		.buf = bs_cpr,
+		.size = sizeof(bs_cpr),
+	},
+	[BOOT_STATE_DEVINFO] = {
+		.ptn = "aboot",
+		.offset = sizeof(bs_devinfo),
+		.from_end = 1,
+		.buf = bs_devinfo,
+		.size = sizeof(bs_devinfo),
+	},
+};
+
+void *boot_state_get(enum boot_state_id id)
 {
-	struct device_info *info = (void*) info_buf;
-	unsigned long long ptn = 0;
-	unsigned long long size;
-	int index = INVALID_PTN;
+	struct boot_state_rec *rec = &boot_state[id];
+	int index;
 
-	index = partition_get_index("aboot");
-	ptn = partition_get_offset(index);
-	if(ptn == 0)
-	{
-		return;
+	if (rec->loaded)
+		return rec->buf;
+
+	index = partition_get_index(rec->ptn);
+	rec->addr = partition_get_offset(index);
+	if (rec->addr == 0) {
+		dprintf(CRITICAL, "ERROR: partition %s doesn't exist\n", rec->ptn);
+		return NULL;
 	}
+	if (rec->from_end)
+		rec->addr += partition_get_size(index) - rec->offset;
+	else
+		rec->addr += rec->offset;
 
-	size = partition_get_size(index);
+	if (mmc_read(rec->addr, (unsigned int *) rec->buf, rec->size)) {
+		dprintf(CRITICAL, "ERROR: Cannot read %s state\n", rec->ptn);
+		return NULL;
+	}
+	rec->loaded = 1;
+	return rec->buf;
+}
 
-	memcpy(info, dev, sizeof(device_info));
+void boot_state_dirty(enum boot_state_id id)
+{
+	if (boot_state[id].loaded)
+		boot_state[id].dirty = 1;
+}
 
-	if(mmc_write((ptn + size - 512), 512, (void *)info_buf))
-	{
-		dprintf(CRITICAL, "ERROR: Cannot write device info\n");
-		return;
+int boot_state_flush(void)
+{
+	struct boot_state_rec *rec;
+	int ret = 0;
+	int i;
+
+	for (i = 0; i < BOOT_STATE_MAX; i++) {
+		rec = &boot_state[i];
+		if (!rec->dirty)
+			continue;
+		if (mmc_write_reliable(rec->addr, rec->size,
+				       (unsigned int *) rec->buf)) {
+			dprintf(CRITICAL, "ERROR: Cannot write %s state\n",
+				rec->ptn);
+			ret = -1;
+			continue;
+		}
+		rec->dirty = 0;
 	}
+	return ret;
 }
 
-void read_device_info_mmc(device_info *dev)
+unsigned char info_buf[4096];
+void write_device_info_mmc(device_info *dev)
 {
-	struct device_info *info = (void*) info_buf;
-	unsigned long long ptn = 0;
-	unsigned long long size;
-	int index = INVALID_PTN;
+	struct device_info *info = boot_state_get(BOOT_STATE_DEVINFO);
 
-	index = partition_get_index("aboot");
-	ptn = partition_get_offset(index);
-	if(ptn == 0)
-	{
+	if (info == NULL)
 		return;
-	}
 
-	size = partition_get_size(index);
+	memcpy(info, dev, sizeof(device_info));
+	boot_state_dirty(BOOT_STATE_DEVINFO);
+}
 
-	if(mmc_read((ptn + size - 512), (void *)info_buf, 512))
-	{
-		dprintf(CRITICAL, "ERROR: Cannot read device info\n");
+void read_device_info_mmc(device_info *dev)
+{
+	struct device_info *info = boot_state_get(BOOT_STATE_DEVINFO);
+
+	if (info == NULL)
 		return;
-	}
 
 	if (memcmp(info->magic, DEVICE_MAGIC, DEVICE_MAGIC_SIZE))
 	{
@@ -1090,7 +1312,7 @@ void read_device_info_mmc(device_info *dev)
 		info->is_unlocked = 0;
 		info->is_tampered = 0;
 
-		write_device_info_mmc(info);
+		boot_state_dirty(BOOT_STATE_DEVINFO);
 	}
 	memcpy(dev, info, sizeof(device_info));
 }
@@ -1265,29 +1487,58 @@ void cmd_erase(const char *arg, void *data, unsigned sz)
 }
 
 
-#define DEFAULT_ERASE_SECTORS	8
-static unsigned int g_out[512 * DEFAULT_ERASE_SECTORS] = {0};
-void cmd_erase_mmc(const char *arg, void *data, unsigned sz)
+static void erase_mmc_progress(unsigned long long done,
+			       unsigned long long total)
+{
+	char response[64 - 4 - 1];
+
+	snprintf(response, sizeof(response), "erased %llu/%llu MB",
+		 done >> 20, total >> 20);
+	fastboot_info(response);
+}
+
+static void erase_mmc_partition(const char *arg, unsigned flags)
 {
 	unsigned long long ptn = 0;
+	unsigned long long size;
 	int index = INVALID_PTN;
+	unsigned int ret;
+	time_t start;
 
 	index = partition_get_index(arg);
 	ptn = partition_get_offset(index);
+	size = partition_get_size(index);
 
 	if(ptn == 0) {
 		fastboot_fail("Partition table doesn't exist\n");
 		return;
 	}
-	/* Simple inefficient version of erase. Just writing
-       0 in first block */
-	if (mmc_write(ptn , 512 * DEFAULT_ERASE_SECTORS, (unsigned int *)g_out)) {
+
+	start = current_time();
+	ret = mmc_erase_range(ptn, size, flags, erase_mmc_progress);
+	if (ret == MMC_BOOT_E_NOT_SUPPORTED) {
+		fastboot_fail("secure erase not supported by card");
+		return;
+	}
+	if (ret) {
 		fastboot_fail("failed to erase partition");
 		return;
 	}
+	dprintf(INFO, "erased %s: %llu KB in %u ms\n", arg, size >> 10,
+		(unsigned) (current_time() - start));
 	fastboot_okay("");
 }
 
+void cmd_erase_mmc(const char *arg, void *data, unsigned sz)
+{
+	erase_mmc_partition(arg, 0);
+}
+
+void cmd_oem_secure_erase(const char *arg, void *data, unsigned sz)
+{
+	erase_mmc_partition(arg, MMC_ERASE_SECURE);
+}
+
 
 void cmd_flash_mmc_img(const char *arg, void *data, unsigned sz)
 {
@@ -1385,10 +1636,9 @@ void cmd_flash_mmc_sparse_img(const char *arg, void *data, unsigned sz)
 		chunk_header = (chunk_header_t *) data;
 		data += sizeof(chunk_header_t);
 
-		dprintf (SPEW, "=== Chunk Header ===\n");
-		dprintf (SPEW, "chunk_type: 0x%x\n", chunk_header->chunk_type);
-		dprintf (SPEW, "chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
-		dprintf (SPEW, "total_size: 0x%x\n", chunk_header->total_sz);
+		dlog(SPEW, "chunk %u: type 0x%x chunk_sz 0x%x total_sz 0x%x\n",
+		     chunk, chunk_header->chunk_type, chunk_header->chunk_sz,
+		     chunk_header->total_sz);
 
 		if(sparse_header->chunk_hdr_sz > sizeof(chunk_header_t))
 		{
@@ -1490,11 +1740,50 @@ void cmd_flash_mmc(const char *arg, void *data, unsigned sz)
 	return;
 }
 
+/* Blocks past a raw image that "flash:" also erases on NAND; the whole
+ * rest of the partition unless "oem flash-erase-tail" lowers it */
+static unsigned flash_erase_tail = FLASH_ERASE_TAIL_ALL;
+
+/* "getvar nand-tag-size" value */
+static char nand_tag_size[12];
+
+static int nand_tag_img_valid(const nand_tag_header_t *hdr, unsigned sz)
+{
+	if (hdr->hdr_sz < sizeof(*hdr) || (hdr->hdr_sz & 31) ||
+	    hdr->hdr_sz > sz) {
+		dprintf(CRITICAL, "nand tag image: bad header size %u\n",
+			hdr->hdr_sz);
+		return 0;
+	}
+	if (hdr->page_size != page_size) {
+		dprintf(CRITICAL, "nand tag image: page size %u, flash has %u\n",
+			hdr->page_size, page_size);
+		return 0;
+	}
+	if (hdr->tag_size > flash_tag_size()) {
+		dprintf(CRITICAL, "nand tag image: %u tag bytes, only %u fit\n",
+			hdr->tag_size, flash_tag_size());
+		return 0;
+	}
+	if (hdr->pages > (sz - hdr->hdr_sz) / (page_size + hdr->tag_size)) {
+		dprintf(CRITICAL, "nand tag image: truncated (%u pages)\n",
+			hdr->pages);
+		return 0;
+	}
+	return 1;
+}
+
 void cmd_flash(const char *arg, void *data, unsigned sz)
 {
 	struct ptentry *ptn;
 	struct ptable *ptable;
+	struct flash_write_stats stats;
+	nand_tag_header_t *tag_hdr = NULL;
+	unsigned char *pages;
+	char response[64 - 4 - 1];
 	unsigned extra = 0;
+	unsigned tail;
+	int ret;
 
 	ptable = flash_get_ptable();
 	if (ptable == NULL) {
@@ -1519,23 +1808,84 @@ void cmd_flash(const char *arg, void *data, unsigned sz)
 		|| !strcmp(ptn->name, "userdata")
 		|| !strcmp(ptn->name, "persist")
 		|| !strcmp(ptn->name, "recoveryfs")) {
-		if (flash_ecc_bch_enabled())
-			/* Spare data bytes for 8 bit ECC increased by 4 */
-			extra = ((page_size >> 9) * 20);
-		else
-			extra = ((page_size >> 9) * 16);
-	} else
+		tag_hdr = (nand_tag_header_t *) data;
+		if (sz >= UBI_EC_HDR_MAGIC_SIZE &&
+		    !memcmp(data, UBI_EC_HDR_MAGIC, UBI_EC_HDR_MAGIC_SIZE)) {
+			/* UBI images have no spare data */
+			sz = ROUND_TO_PAGE(sz, page_mask);
+			tag_hdr = NULL;
+		} else if (sz < sizeof(*tag_hdr) ||
+			   tag_hdr->magic != NAND_TAG_MAGIC) {
+			tag_hdr = NULL;
+			if (flash_ecc_bch_enabled())
+				/* Spare data bytes for 8 bit ECC increased by 4 */
+				extra = ((page_size >> 9) * 20);
+			else
+				extra = ((page_size >> 9) * 16);
+		} else if (!nand_tag_img_valid(tag_hdr, sz)) {
+			fastboot_fail("invalid nand tag image");
+			return;
+		}
+		/* filesystems must not find stale data behind the image */
+		tail = FLASH_ERASE_TAIL_ALL;
+	} else if (sz >= UBI_EC_HDR_MAGIC_SIZE &&
+		   !memcmp(data, UBI_EC_HDR_MAGIC, UBI_EC_HDR_MAGIC_SIZE)) {
+		/* UBI would attach stale erase blocks left behind the image */
+		sz = ROUND_TO_PAGE(sz, page_mask);
+		tail = FLASH_ERASE_TAIL_ALL;
+	} else {
 		sz = ROUND_TO_PAGE(sz, page_mask);
+		tail = flash_erase_tail;
+	}
 
 	dprintf(INFO, "writing %d bytes to '%s'\n", sz, ptn->name);
-	if (flash_write(ptn, extra, data, sz)) {
+	if (tag_hdr) {
+		pages = (unsigned char *) data + tag_hdr->hdr_sz;
+		ret = flash_write_tags(ptn, pages,
+				       pages + tag_hdr->pages * page_size,
+				       tag_hdr->tag_size, tag_hdr->pages, tail,
+				       FLASH_WRITE_SKIP_ERASED, &stats);
+	} else {
+		ret = flash_write_ext(ptn, extra, data, sz, tail,
+				      FLASH_WRITE_SKIP_ERASED, &stats);
+	}
+	if (ret) {
 		fastboot_fail("flash write failure");
 		return;
 	}
+	snprintf(response, sizeof(response), "erase %u blocks %u ms",
+		 stats.erased_blocks, stats.erase_us / 1000);
+	fastboot_info(response);
+	snprintf(response, sizeof(response), "program %u pages (%u skipped) %u ms",
+		 stats.programmed_pages, stats.skipped_pages,
+		 stats.program_us / 1000);
+	fastboot_info(response);
 	dprintf(INFO, "partition '%s' updated\n", ptn->name);
 	fastboot_okay("");
 }
 
+void cmd_oem_flash_erase_tail(const char *arg, void *data, unsigned sz)
+{
+	char response[64 - 4 - 1];
+
+	if (!strcmp(arg, "all"))
+		flash_erase_tail = FLASH_ERASE_TAIL_ALL;
+	else if (*arg >= '0' && *arg <= '9')
+		flash_erase_tail = atoul(arg);
+	else {
+		fastboot_fail("usage: oem flash-erase-tail:<blocks>|all");
+		return;
+	}
+
+	if (flash_erase_tail == FLASH_ERASE_TAIL_ALL)
+		snprintf(response, sizeof(response), "erase tail: all");
+	else
+		snprintf(response, sizeof(response), "erase tail: %u blocks",
+			 flash_erase_tail);
+	fastboot_info(response);
+	fastboot_okay("");
+}
+
 void disable_poweroff_charging(void);
 
 void cmd_continue(const char *arg, void *data, unsigned sz)
@@ -1556,6 +1906,8 @@ void cmd_continue(const char *arg, void *data, unsigned sz)
 void cmd_reboot(const char *arg, void *data, unsigned sz)
 {
 	dprintf(INFO, "rebooting the device\n");
+	if (target_is_emmc_boot())
+		boot_state_flush();
 	fastboot_okay("");
 	reboot_device(0);
 }
@@ -1563,6 +1915,8 @@ void cmd_reboot(const char *arg, void *data, unsigned sz)
 void cmd_reboot_bootloader(const char *arg, void *data, unsigned sz)
 {
 	dprintf(INFO, "rebooting the device\n");
+	if (target_is_emmc_boot())
+		boot_state_flush();
 	fastboot_okay("");
 	reboot_device(FASTBOOT_MODE);
 }
@@ -1573,6 +1927,10 @@ void cmd_oem_unlock(const char *arg, void *data, unsigned sz)
 	{
 		device.is_unlocked = 1;
 		write_device_info(&device);
+		if (target_is_emmc_boot() && boot_state_flush()) {
+			fastboot_fail("failed to write device info");
+			return;
+		}
 	}
 	fastboot_okay("");
 }
@@ -1587,6 +1945,85 @@ void cmd_oem_devinfo(const char *arg, void *data, unsigned sz)
 	fastboot_okay("");
 }
 
+void cmd_oem_mmc_stats(const char *arg, void *data, unsigned sz)
+{
+	struct mmc_write_stats *st = get_mmc_write_stats();
+	char response[64];
+
+	snprintf(response, 64, "\twrites: %u (cmd23 %u, reliable %u)",
+		 st->writes, st->predefined, st->reliable);
+	fastboot_info(response);
+	snprintf(response, 64, "\tbytes: %llu in %llu us", st->bytes,
+		 st->total_us);
+	fastboot_info(response);
+	snprintf(response, 64, "\tavg: %u us, max: %u us (%u bytes)",
+		 st->writes ? (unsigned) (st->total_us / st->writes) : 0,
+		 st->max_us, st->max_us_bytes);
+	fastboot_info(response);
+	memset(st, 0, sizeof(*st));
+	fastboot_okay("");
+}
+
+void cmd_oem_nand_ecc(const char *arg, void *data, unsigned sz)
+{
+	struct ptable *ptable = flash_get_ptable();
+	struct ptentry *ptn;
+	struct flash_ecc_stats st;
+	unsigned blocks, worst, lost, block;
+	char response[64 - 4 - 1];
+	int i;
+
+	snprintf(response, sizeof(response), "ecc: %u bits/codeword",
+		 flash_ecc_strength());
+	fastboot_info(response);
+	for (i = 0; ptable && i < ptable_size(ptable); i++) {
+		ptn = ptable_get(ptable, i);
+		blocks = worst = lost = 0;
+		for (block = ptn->start; block < ptn->start + ptn->length;
+		     block++) {
+			if (flash_ecc_get_stats(block, &st) ||
+			    (!st.corrected && !st.uncorrectable))
+				continue;
+			blocks++;
+			if (st.max_cw > worst)
+				worst = st.max_cw;
+			lost += st.uncorrectable;
+		}
+		if (!blocks)
+			continue;
+		snprintf(response, sizeof(response),
+			 "\t%s: %u blocks, max %u/cw, %u uncorrectable",
+			 ptn->name, blocks, worst, lost);
+		fastboot_info(response);
+	}
+	fastboot_okay("");
+}
+
+void cmd_oem_nand_scrub(const char *arg, void *data, unsigned sz)
+{
+	static const char *ptns[] = { "boot", "recovery" };
+	struct ptable *ptable = flash_get_ptable();
+	struct ptentry *ptn;
+	char response[64 - 4 - 1];
+	unsigned i;
+	int ret;
+
+	for (i = 0; ptable && i < ARRAY_SIZE(ptns); i++) {
+		ptn = ptable_find(ptable, ptns[i]);
+		if (ptn == NULL)
+			continue;
+		ret = flash_scrub(ptn, NAND_SCRUB_THRESHOLD);
+		if (ret < 0) {
+			fastboot_fail("scrub failed");
+			return;
+		}
+		snprintf(response, sizeof(response), "%s: %d blocks rewritten",
+			 ptn->name, ret);
+		fastboot_info(response);
+	}
+	fastboot_okay("");
+}
+
 /* XXX: Note offset & sz should be page aligned
  * opt: 0 stand for write, otherwise read
  */
@@ -1631,38 +2068,33 @@ int handle_misc_data(enum misc_region_type type, int opt, void* data, uint64_t o
 	return 0;
 }
 
-/* Get the cpr configration */
+/* Set the cpr configration, written to mmc right away */
 int set_cpr_config(struct cpr_status_info *info)
 {
-	if (page_size == 0) {
-		dprintf(CRITICAL, "page_size not initialized yet\n");
-		return -1;
-	}
-
-	memcpy(cpr_buf, info, sizeof(struct cpr_status_info));
+	void *cpr = boot_state_get(BOOT_STATE_CPR);
 
-	/* Write CPR config to mmc */
-	if (handle_misc_data(TYPE_CPR, 0/*Write*/, cpr_buf, 0, page_size)) {
+	if (cpr == NULL) {
 		dprintf(CRITICAL, "get misc data failed\n");
 		return -1;
 	}
 
-	return 0;
+	memcpy(cpr, info, sizeof(struct cpr_status_info));
+	boot_state_dirty(BOOT_STATE_CPR);
+
+	return boot_state_flush();
 }
 
 /* Get the cpr configration */
 int get_cpr_config(struct cpr_status_info *info)
 {
-	if (page_size == 0) {
-		dprintf(CRITICAL, "page_size not initialized yet\n");
-		return -1;
-	}
-	if (handle_misc_data(TYPE_CPR, 1/*Read*/, cpr_buf, 0, page_size)) {
+	void *cpr = boot_state_get(BOOT_STATE_CPR);
+
+	if (cpr == NULL) {
 		dprintf(CRITICAL, "get misc data failed\n");
 		return -1;
 	}
 
-	memcpy(info, cpr_buf, sizeof(struct cpr_status_info));
+	memcpy(info, cpr, sizeof(struct cpr_status_info));
 	return 0;
 }
 
@@ -1770,6 +2202,256 @@ void cmd_oem_log(const char *arg, void *data, unsigned sz)
 
 }
 
+/* data source of "oem dump-partition", read back through "upload" */
+static struct {
+	unsigned long long mmc_ptn;
+	struct ptentry *flash_ptn;
+	unsigned offset;
+	unsigned page_mask;
+} dump_src;
+
+static int dump_partition_read(void *arg, unsigned offset, void *buf,
+			       unsigned len)
+{
+	len = ROUND_TO_PAGE(len, dump_src.page_mask);
+	offset += dump_src.offset;
+
+	if (dump_src.flash_ptn)
+		return flash_read(dump_src.flash_ptn, offset, buf, len) ? -1 : 0;
+	return mmc_read(dump_src.mmc_ptn + offset, buf, len) ? -1 : 0;
+}
+
+/* fastboot oem dump-partition:<name>:<offset>:<len>
+ * stages len bytes (the rest of the partition if 0) at a page aligned
+ * offset for the next "fastboot upload"
+ */
+void cmd_oem_dump_partition(const char *arg, void *data, unsigned sz)
+{
+	char name[MAX_GPT_NAME_SIZE];
+	const char *sep;
+	unsigned long long ptn_size;
+	unsigned offset, len;
+	struct ptable *ptable;
+	int index;
+
+	if (target_use_signed_kernel() && !device.is_unlocked) {
+		fastboot_fail("device is locked");
+		return;
+	}
+
+	sep = strchr(arg, ':');
+	if (!sep || (unsigned)(sep - arg) >= sizeof(name)) {
+		fastboot_fail("usage: oem dump-partition:<name>:<offset>:<len>");
+		return;
+	}
+	memcpy(name, arg, sep - arg);
+	name[sep - arg] = 0;
+	offset = atoul(sep + 1);
+	sep = strchr(sep + 1, ':');
+	len = sep ? atoul(sep + 1) : 0;
+
+	memset(&dump_src, 0, sizeof(dump_src));
+	if (target_is_emmc_boot()) {
+		index = partition_get_index(name);
+		dump_src.mmc_ptn = partition_get_offset(index);
+		ptn_size = partition_get_size(index);
+		dump_src.page_mask = BLOCK_SIZE - 1;
+		if (!dump_src.mmc_ptn) {
+			fastboot_fail("unknown partition name");
+			return;
+		}
+	} else {
+		ptable = flash_get_ptable();
+		dump_src.flash_ptn = ptable ? ptable_find(ptable, name) : NULL;
+		if (!dump_src.flash_ptn) {
+			fastboot_fail("unknown partition name");
+			return;
+		}
+		dump_src.page_mask = flash_page_size() - 1;
+		ptn_size = (unsigned long long) dump_src.flash_ptn->length *
+			   flash_get_info()->block_size;
+	}
+
+	if (offset & dump_src.page_mask) {
+		fastboot_fail("offset not page aligned");
+		return;
+	}
+	if (offset >= ptn_size) {
+		fastboot_fail("offset past end of partition");
+		return;
+	}
+	if (!len || len > ptn_size - offset)
+		len = MIN(ptn_size - offset, 0xffffffffULL);
+
+	dump_src.offset = offset;
+	fastboot_stage_upload(len, dump_partition_read, NULL);
+
+	snprintf(name, sizeof(name), "%u bytes staged", len);
+	fastboot_okay(name);
+}
+
+#ifdef WITH_DEBUG_GLOBAL_RAM
+/* the log ring oldest first, from where the writer was at staging time */
+static unsigned dump_log_start, dump_log_wrapped;
+
+static int dump_log_read(void *arg, unsigned offset, void *buf, unsigned len)
+{
+	extern char print_buf[PRINT_BUFF_SIZE];
+	unsigned char *out = buf;
+	unsigned pos, n;
+
+	while (len) {
+		if (dump_log_wrapped && offset < PRINT_BUFF_SIZE - dump_log_start)
+			pos = dump_log_start + offset;
+		else if (dump_log_wrapped)
+			pos = 12 + offset - (PRINT_BUFF_SIZE - dump_log_start);
+		else
+			pos = 12 + offset;
+		n = MIN(len, PRINT_BUFF_SIZE - pos);
+		memcpy(out, print_buf + pos, n);
+		out += n;
+		offset += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/* fastboot oem dump-log: stages the debug log for "fastboot upload" */
+void cmd_oem_dump_log(const char *arg, void *data, unsigned sz)
+{
+	extern char print_buf[PRINT_BUFF_SIZE];
+	extern unsigned int print_idx;
+	char response[32];
+	unsigned len;
+
+	enter_critical_section();
+	dump_log_start = print_idx;
+	dump_log_wrapped = print_buf[print_idx] != 0;
+	exit_critical_section();
+
+	if (dump_log_wrapped)
+		len = PRINT_BUFF_SIZE - 12;
+	else
+		len = dump_log_start - 12;
+
+	fastboot_stage_upload(len, dump_log_read, NULL);
+	snprintf(response, sizeof(response), "%u bytes staged", len);
+	fastboot_okay(response);
+}
+#endif
+
+/* fastboot oem dump-ram:<addr>:<len>
+ * stages mapped memory for "fastboot upload", unlocked devices only
+ */
+void cmd_oem_dump_ram(const char *arg, void *data, unsigned sz)
+{
+	char response[32];
+	const char *sep;
+	unsigned addr, len;
+
+	if (!device.is_unlocked) {
+		fastboot_fail("device is locked");
+		return;
+	}
+
+	sep = strchr(arg, ':');
+	addr = atoul(arg);
+	len = sep ? atoul(sep + 1) : 0;
+	if (!len || addr + len < addr) {
+		fastboot_fail("usage: oem dump-ram:<addr>:<len>");
+		return;
+	}
+
+	fastboot_stage_upload(len, NULL, (void *) addr);
+	snprintf(response, sizeof(response), "%u bytes staged", len);
+	fastboot_okay(response);
+}
+
+#if WITH_LIB_PROFILE
+/* fastboot oem profile start [ms]: start sampling, default every tick
+ * fastboot oem profile stop:       stop sampling
+ * fastboot oem profile dump:       send the raw samples as INFO lines,
+ *                                  "T <index> <name>" for each thread then
+ *                                  "<pc>:<thread index>" four per line
+ */
+void cmd_oem_profile(const char *arg, void *data, unsigned sz)
+{
+	const struct profile_sample *s;
+	char response[64 - 4 - 1];
+	unsigned count, i, n;
+	const char *p;
+	int len;
+
+	if ((p = strstr(arg, "start"))) {
+		for (p += strlen("start"); *p == ' '; p++) ;
+		if (profile_start(atoui(p)) < 0) {
+			fastboot_fail("profiler already running");
+			return;
+		}
+	} else if (strstr(arg, "stop")) {
+		profile_stop();
+	} else if (strstr(arg, "dump")) {
+		if (profile_running()) {
+			fastboot_fail("profiler is running");
+			return;
+		}
+
+		count = profile_sample_count();
+		s = profile_get_samples();
+
+		for (i = 0; i < PROFILE_MAX_THREADS; i++) {
+			if (!strcmp(profile_thread_name(i), "?"))
+				break;
+			snprintf(response, sizeof(response), "T %u %s", i,
+				 profile_thread_name(i));
+			fastboot_info(response);
+		}
+
+		for (i = 0; i < count; ) {
+			len = 0;
+			for (n = 0; n < 4 && i < count; n++, i++)
+				len += snprintf(response + len, sizeof(response) - len,
+						"%08lx:%x ", s[i].pc, s[i].thread);
+			fastboot_info(response);
+		}
+	} else {
+		fastboot_info("fastboot oem profile start [ms]");
+		fastboot_info("fastboot oem profile stop");
+		fastboot_info("fastboot oem profile dump");
+	}
+
+	fastboot_okay("");
+}
+#endif
+
+#if THREAD_STATS
+/* fastboot getvar:threadstats: one INFO line per thread with run and
+ * ready time in ms, the longest run queue wait in us, switch count and
+ * stack high-water mark.
+ */
+void cmd_getvar_threadstats(const char *arg, void *data, unsigned sz)
+{
+	struct thread_stats_entry entries[16];
+	char response[64 - 4 - 1];
+	int count, i;
+
+	count = thread_stats_snapshot(entries, 16);
+	for (i = 0; i < count; i++) {
+		struct thread_stats_entry *e = &entries[i];
+
+		snprintf(response, sizeof(response),
+			 "%.10s: run %u rdy %u lat %u sw %u stk %u/%u",
+			 e->name, (unsigned) (e->run_time / 1000),
+			 (unsigned) (e->ready_time / 1000),
+			 (unsigned) e->max_ready_latency, e->switch_count,
+			 (unsigned) e->stack_used, (unsigned) e->stack_size);
+		fastboot_info(response);
+	}
+
+	fastboot_okay("");
+}
+#endif
+
 void splash_screen ()
 {
 	struct ptentry *ptn;
@@ -1936,13 +2618,22 @@ fastboot:
 	{
 		fastboot_register("flash:", cmd_flash_mmc);
 		fastboot_register("erase:", cmd_erase_mmc);
-		save_debug_message();
+		fastboot_register("oem secure-erase:", cmd_oem_secure_erase);
+		boot_state_flush();
+		save_debug_message_flush();
 	}
 	else
 	{
 		fastboot_register("flash:", cmd_flash);
 		fastboot_register("erase:", cmd_erase);
-		save_debug_message();
+		fastboot_register("oem flash-erase-tail:",
+				  cmd_oem_flash_erase_tail);
+		fastboot_register("oem nand-ecc", cmd_oem_nand_ecc);
+		fastboot_register("oem nand-scrub", cmd_oem_nand_scrub);
+		snprintf(nand_tag_size, sizeof(nand_tag_size), "%u",
+			 flash_tag_size());
+		fastboot_publish("nand-tag-size", nand_tag_size);
+		save_debug_message_flush();
 	}
 
 	fastboot_register("continue", cmd_continue);
@@ -1950,8 +2641,18 @@ fastboot:
 	fastboot_register("reboot-bootloader", cmd_reboot_bootloader);
 	fastboot_register("oem unlock", cmd_oem_unlock);
 	fastboot_register("oem device-info", cmd_oem_devinfo);
+	if (target_is_emmc_boot())
+		fastboot_register("oem mmc-stats", cmd_oem_mmc_stats);
 	fastboot_register("oem log", cmd_oem_log);
+	fastboot_register("oem dump-partition:", cmd_oem_dump_partition);
+	fastboot_register("oem dump-ram:", cmd_oem_dump_ram);
+#ifdef WITH_DEBUG_GLOBAL_RAM
+	fastboot_register("oem dump-log", cmd_oem_dump_log);
+#endif
 	fastboot_register("oem cpr", cmd_oem_cpr);
+#if WITH_LIB_PROFILE
+	fastboot_register("oem profile", cmd_oem_profile);
+#endif
 	fastboot_publish("product", TARGET(BOARD));
 	fastboot_publish("kernel", "lk");
 	fastboot_publish("serialno", sn_buf);
@@ -1980,6 +2681,10 @@ fastboot:
 	partition_dump();
 	sz = target_get_max_flash_size();
 	fastboot_init(target_get_scratch_address(), sz);
+#if THREAD_STATS
+	/* registered after getvar: so it is matched first */
+	fastboot_register("getvar:threadstats", cmd_getvar_threadstats);
+#endif
 	udc_start();
 }
 
@@ -1988,33 +2693,216 @@ APP_START(aboot)
 APP_END
 
 #if DEVICE_TREE
+/* Returns the size of the table header and entries, 0 if the table is
+ * not valid.
+ */
+unsigned dev_tree_table_size(const struct dt_table *table)
+{
+	if (memcmp(&table->magic, DEV_TREE_MAGIC, sizeof(table->magic)))
+		return 0;
+	if (table->version != DEV_TREE_VERSION &&
+	    table->version != DEV_TREE_VERSION_V2)
+		return 0;
+	if (table->num_entries > DEV_TREE_MAX_ENTRIES)
+		return 0;
+
+	return DEV_TREE_HEADER_SIZE + table->num_entries * sizeof(struct dt_entry);
+}
+
+static int dt_entry_cmp(const struct dt_entry *e, uint32_t platform,
+			uint32_t variant, uint32_t soc_rev)
+{
+	if (e->platform_id != platform)
+		return e->platform_id < platform ? -1 : 1;
+	if (e->variant_id != variant)
+		return e->variant_id < variant ? -1 : 1;
+	if (e->soc_rev != soc_rev)
+		return e->soc_rev < soc_rev ? -1 : 1;
+	return 0;
+}
+
+/* the entry for platform and variant with the highest soc_rev not newer
+ * than soc_rev; soc_rev 0 entries match any revision */
+static struct dt_entry *dev_tree_match(struct dt_table *table,
+				       uint32_t platform, uint32_t variant,
+				       uint32_t soc_rev)
+{
+	struct dt_entry *entries;
+	struct dt_entry *best = NULL;
+	unsigned lo, hi, mid, i;
+
+	entries = (struct dt_entry *)((char *)table + DEV_TREE_HEADER_SIZE);
+
+	if (table->version >= DEV_TREE_VERSION_V2) {
+		/* first entry not below (platform, variant, 0) */
+		lo = 0;
+		hi = table->num_entries;
+		while (lo < hi) {
+			mid = (lo + hi) / 2;
+			if (dt_entry_cmp(&entries[mid], platform, variant, 0) < 0)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		for (i = lo; i < table->num_entries; i++) {
+			if (entries[i].platform_id != platform ||
+			    entries[i].variant_id != variant ||
+			    entries[i].soc_rev > soc_rev)
+				break;
+			best = &entries[i];
+		}
+		return best;
+	}
+
+	/* version 1 tables are in no particular order */
+	for (i = 0; i < table->num_entries; i++) {
+		if (entries[i].platform_id == platform &&
+		    entries[i].variant_id == variant &&
+		    entries[i].soc_rev <= soc_rev &&
+		    (!best || entries[i].soc_rev > best->soc_rev))
+			best = &entries[i];
+	}
+
+	return best;
+}
+
 struct dt_entry * get_device_tree_ptr(struct dt_table *table)
+{
+	uint32_t platform = board_platform_id();
+	uint32_t variant = board_hardware_id();
+	uint32_t soc_rev = board_soc_version();
+	struct dt_entry *entry;
+
+	entry = dev_tree_match(table, platform, variant, soc_rev);
+
+	/* fall back to a tree for any board of this platform */
+	if (!entry && variant != HW_PLATFORM_UNKNOWN)
+		entry = dev_tree_match(table, platform, HW_PLATFORM_UNKNOWN,
+				       soc_rev);
+
+	if (entry && (entry->variant_id != variant || entry->soc_rev != soc_rev))
+		dprintf(entry->variant_id != variant ? INFO : SPEW,
+			"DTB: no exact match, using variant %u soc rev 0x%x\n",
+			entry->variant_id, entry->soc_rev);
+
+	return entry;
+}
+
+/*
+ * Bootloader edits to the device tree are queued and then applied in one
+ * go: the blob is opened once with room for all of them, the edits run
+ * from the last node in the blob to the first so no queued offset is
+ * moved by an earlier splice, and the result is packed once.
+ */
+#define DT_FIXUP_MAX_NODES	4
+#define DT_FIXUP_MAX_PROPS	8
+
+struct dt_fixup_prop {
+	int node;		/* index into nodes[] */
+	const char *name;
+	const void *val;
+	int len;
+};
+
+struct dt_fixup {
+	void *fdt;
+	struct {
+		const char *path;
+		int offset;
+	} nodes[DT_FIXUP_MAX_NODES];
+	unsigned node_count;
+	struct dt_fixup_prop props[DT_FIXUP_MAX_PROPS];
+	unsigned prop_count;
+	unsigned grow;		/* worst case size increase of the blob */
+};
+
+/* each path is looked up once per fixup, not once per property */
+static int dt_fixup_node(struct dt_fixup *f, const char *path)
 {
 	unsigned i;
-	struct dt_entry *dt_entry_ptr;
 
-	dt_entry_ptr = (char *)table + DEV_TREE_HEADER_SIZE ;
+	for (i = 0; i < f->node_count; i++)
+		if (!strcmp(f->nodes[i].path, path))
+			return i;
 
-	for(i = 0; i < table->num_entries; i++)
-	{
-		if((dt_entry_ptr->platform_id == board_platform_id()) &&
-		   (dt_entry_ptr->variant_id == board_hardware_id()) &&
-		   (dt_entry_ptr->soc_rev == 0)){
-				return dt_entry_ptr;
+	ASSERT(f->node_count < DT_FIXUP_MAX_NODES);
+	f->nodes[i].path = path;
+	f->nodes[i].offset = -FDT_ERR_NOTFOUND;
+	f->node_count++;
+
+	return i;
+}
+
+static void dt_fixup_add(struct dt_fixup *f, const char *path,
+			 const char *name, const void *val, int len)
+{
+	struct dt_fixup_prop *prop;
+
+	ASSERT(f->prop_count < DT_FIXUP_MAX_PROPS);
+	prop = &f->props[f->prop_count++];
+	prop->node = dt_fixup_node(f, path);
+	prop->name = name;
+	prop->val = val;
+	prop->len = len;
+
+	/* a new property: tag, length, name offset, padded value and name */
+	f->grow += 3 * sizeof(uint32_t) + ROUNDUP(len, 4) + strlen(name) + 1;
+}
+
+static int dt_fixup_apply(struct dt_fixup *f)
+{
+	struct dt_fixup_prop tmp;
+	unsigned i, j;
+	int ret;
+
+	ret = fdt_open_into(f->fdt, f->fdt, fdt_totalsize(f->fdt) + f->grow);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < f->node_count; i++) {
+		f->nodes[i].offset = fdt_path_offset(f->fdt, f->nodes[i].path);
+		if (f->nodes[i].offset < 0) {
+			dprintf(CRITICAL, "ERROR: No %s node in the device tree\n",
+				f->nodes[i].path);
+			return f->nodes[i].offset;
+		}
+	}
+
+	/* last node first */
+	for (i = 1; i < f->prop_count; i++) {
+		tmp = f->props[i];
+		for (j = i; j > 0 && f->nodes[f->props[j - 1].node].offset <
+				     f->nodes[tmp.node].offset; j--)
+			f->props[j] = f->props[j - 1];
+		f->props[j] = tmp;
+	}
+
+	for (i = 0; i < f->prop_count; i++) {
+		ret = fdt_setprop(f->fdt, f->nodes[f->props[i].node].offset,
+				  f->props[i].name, f->props[i].val,
+				  f->props[i].len);
+		if (ret) {
+			dprintf(CRITICAL, "ERROR: Cannot update %s [%s]\n",
+				f->nodes[f->props[i].node].path,
+				f->props[i].name);
+			return ret;
 		}
-		dt_entry_ptr++;
 	}
-	return NULL;
+
+	return fdt_pack(f->fdt);
 }
 
 int update_device_tree(const void * fdt, char *cmdline,
 					   void *ramdisk, unsigned ramdisk_size)
 {
 	int ret = 0;
-	int offset;
 	uint32_t *memory_reg;
 	unsigned char *final_cmdline;
 	uint32_t len;
+	uint32_t initrd_start;
+	uint32_t initrd_end;
+	struct dt_fixup fixup;
 
 	/* Check the device tree header */
 	ret = fdt_check_header(fdt);
@@ -2024,48 +2912,35 @@ int update_device_tree(const void * fdt, char *cmdline,
 		return ret;
 	}
 
-	/* Get offset of the memory node */
-	offset = fdt_path_offset(fdt,"/memory");
-
-	memory_reg = target_dev_tree_mem(&len);
+	memset(&fixup, 0, sizeof(fixup));
+	fixup.fdt = (void *) fdt;
 
 	/* Adding the memory values to the reg property */
-	ret = fdt_setprop(fdt, offset, "reg", memory_reg, sizeof(uint32_t) * len * 2);
-	if(ret)
-	{
-		dprintf(CRITICAL, "ERROR: Cannot update memory node\n");
-		return ret;
-	}
-
-	/* Get offset of the chosen node */
-	offset = fdt_path_offset(fdt, "/chosen");
+	memory_reg = target_dev_tree_mem(&len);
+	dt_fixup_add(&fixup, "/memory", "reg", memory_reg,
+		     sizeof(uint32_t) * len * 2);
 
 	/* Adding the cmdline to the chosen node */
 	final_cmdline = update_cmdline(cmdline);
-	ret = fdt_setprop_string(fdt, offset, "bootargs", final_cmdline);
-	if(ret)
-	{
-		dprintf(CRITICAL, "ERROR: Cannot update chosen node [bootargs]\n");
-		return ret;
-	}
-
-	/* Adding the initrd-start to the chosen node */
-	ret = fdt_setprop_cell(fdt, offset, "linux,initrd-start", ramdisk);
-	if(ret)
-	{
-		dprintf(CRITICAL, "ERROR: Cannot update chosen node [linux,initrd-start]\n");
-		return ret;
-	}
-
-	/* Adding the initrd-end to the chosen node */
-	ret = fdt_setprop_cell(fdt, offset, "linux,initrd-end", (ramdisk + ramdisk_size));
-	if(ret)
-	{
-		dprintf(CRITICAL, "ERROR: Cannot update chosen node [linux,initrd-end]\n");
-		return ret;
-	}
-
-	fdt_pack(fdt);
+	dt_fixup_add(&fixup, "/chosen", "bootargs", final_cmdline,
+		     strlen((const char *) final_cmdline) + 1);
+
+	/* Adding the initrd start and end to the chosen node */
+	initrd_start = cpu_to_fdt32((uint32_t) ramdisk);
+	initrd_end = cpu_to_fdt32((uint32_t) ramdisk + ramdisk_size);
+	dt_fixup_add(&fixup, "/chosen", "linux,initrd-start", &initrd_start,
+		     sizeof(initrd_start));
+	dt_fixup_add(&fixup, "/chosen", "linux,initrd-end", &initrd_end,
+		     sizeof(initrd_end));
+
+	/* the serial number the kernel also gets as androidboot.serialno */
+	if (sn_buf[0])
+		dt_fixup_add(&fixup, "/", "serial-number", sn_buf,
+			     strlen(sn_buf) + 1);
+
+	ret = dt_fixup_apply(&fixup);
+	if (ret)
+		dprintf(CRITICAL, "ERROR: Device tree fixup failed (%d)\n", ret);
 
 	return ret;
 }
@@ -0,0 +1,348 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <debug.h>
+#include <err.h>
+#include <string.h>
+#include <stdlib.h>
+#include <target.h>
+#include <platform.h>
+#include <smp.h>
+#include <mmc.h>
+#include <arch/ops.h>
+#include <dev/flash.h>
+#include <lib/decompress.h>
+
+#include "boot_payload.h"
+
+/* compressed input is streamed through the scratch area in chunks of
+ * this size, two of them when the second core decompresses */
+#define BOOT_PAYLOAD_CHUNK	(256 * 1024)
+#define BOOT_PAYLOAD_MAX	(64 * 1024 * 1024)
+
+#define ROUND_TO_PAGE(x, y)	(((x) + (y)) & (~(y)))
+
+struct payload_reader {
+	struct boot_source *src;
+	unsigned offset;
+	unsigned left;		/* payload bytes not read yet */
+	unsigned char *chunk;
+	time_t read_time;
+};
+
+struct payload_job {
+	int type;
+	struct smp_pipe *pipe;
+	void *dst;
+	unsigned dst_max;
+	struct payload_result *result;
+};
+
+struct payload_result {
+	int status;
+	size_t len;
+} __ALIGNED(CACHE_LINE);
+
+static struct payload_result payload_result;
+static unsigned char payload_workspace[DECOMPRESS_WORKSPACE_SIZE] __ALIGNED(CACHE_LINE);
+
+/* reads up to max payload bytes, whole pages from storage */
+static int reader_next(struct payload_reader *r, void *buf, unsigned max)
+{
+	struct boot_source *src = r->src;
+	unsigned n = MIN(r->left, max);
+	unsigned len = ROUND_TO_PAGE(n, src->page_mask);
+	time_t start;
+	int ret;
+
+	if (!n)
+		return 0;
+
+	start = current_time();
+	if (src->flash_ptn)
+		ret = flash_read(src->flash_ptn, r->offset, buf, len);
+	else
+		ret = mmc_read(src->mmc_ptn + r->offset, buf, len);
+	r->read_time += current_time() - start;
+
+	if (ret)
+		return ERR_IO;
+
+	r->offset += len;
+	r->left -= n;
+
+	return n;
+}
+
+static int chunk_fill(struct decompress_stream *s)
+{
+	struct payload_reader *r = s->fill_arg;
+	int n;
+
+	n = reader_next(r, r->chunk, BOOT_PAYLOAD_CHUNK);
+	if (n <= 0)
+		return n;
+
+	s->next_in = r->chunk;
+	s->end_in = r->chunk + n;
+
+	return n;
+}
+
+struct pipe_reader {
+	struct smp_pipe *pipe;
+	bool held;
+	bool ended;
+};
+
+static int pipe_fill(struct decompress_stream *s)
+{
+	struct pipe_reader *p = s->fill_arg;
+	size_t len;
+
+	if (p->ended)
+		return 0;
+	if (p->held)
+		smp_pipe_release(p->pipe);
+
+	s->next_in = smp_pipe_read(p->pipe, &len);
+	s->end_in = s->next_in + len;
+	p->held = true;
+	p->ended = (len == 0);
+
+	return len;
+}
+
+/* runs on the second core */
+static void payload_job(void *arg)
+{
+	struct payload_job *job = arg;
+	struct pipe_reader p = { job->pipe, false, false };
+	struct decompress_stream s;
+
+	memset(&s, 0, sizeof(s));
+	s.fill = pipe_fill;
+	s.fill_arg = &p;
+	s.out = job->dst;
+	s.out_max = job->dst_max;
+	s.workspace = payload_workspace;
+
+	job->result->status = decompress(job->type, &s);
+	job->result->len = s.out_len;
+
+	/* drain whatever is left so CPU0 never waits on a full pipe */
+	while (!p.ended)
+		pipe_fill(&s);
+	smp_pipe_release(p.pipe);
+
+	arch_clean_invalidate_cache_range((addr_t) job->dst, s.out_len);
+	arch_clean_invalidate_cache_range((addr_t) payload_workspace,
+					  sizeof(payload_workspace));
+}
+
+/* keep reading on CPU0 while the second core decompresses what has
+ * arrived so far */
+static int load_offloaded(struct payload_reader *r, struct smp_pipe *pipe,
+			  int type, unsigned first, void *dst, unsigned dst_max,
+			  size_t *out_len)
+{
+	struct payload_job job;
+	size_t size;
+	void *buf;
+	int ticket;
+	int ret = NO_ERROR;
+	int n;
+
+	buf = smp_pipe_get(pipe, &size);
+	if (buf != r->chunk)
+		memcpy(buf, r->chunk, first);
+	smp_pipe_put(pipe, first);
+
+	/* no dirty line of ours may land on top of the output later */
+	arch_clean_invalidate_cache_range((addr_t) dst, dst_max);
+
+	job.type = type;
+	job.pipe = pipe;
+	job.dst = dst;
+	job.dst_max = dst_max;
+	job.result = &payload_result;
+	ticket = smp_job_post(payload_job, &job, sizeof(job),
+			      payload_workspace, sizeof(payload_workspace),
+			      &payload_result, sizeof(payload_result));
+
+	while (r->left) {
+		buf = smp_pipe_get(pipe, &size);
+		n = reader_next(r, buf, size);
+		if (n < 0) {
+			ret = n;
+			break;
+		}
+		smp_pipe_put(pipe, n);
+	}
+
+	smp_pipe_get(pipe, &size);
+	smp_pipe_put(pipe, 0);
+	smp_job_wait(ticket);
+
+	if (ret == NO_ERROR)
+		ret = payload_result.status;
+	*out_len = payload_result.len;
+	if (ret == NO_ERROR)
+		arch_invalidate_cache_range((addr_t) dst, *out_len);
+
+	return ret;
+}
+
+int boot_payload_load(struct boot_source *src, const char *name,
+		      unsigned size, void *dst, unsigned dst_max, unsigned flags)
+{
+	struct payload_reader r;
+	struct decompress_stream s;
+	struct smp_pipe *pipe;
+	time_t start = current_time();
+	size_t len = 0;
+	int type;
+	int ret;
+	int n;
+
+	r.src = src;
+	r.offset = src->offset;
+	r.left = size;
+	r.chunk = target_get_scratch_address();
+	r.read_time = 0;
+
+	src->offset += ROUND_TO_PAGE(size, src->page_mask);
+
+	/* sniff the first page */
+	n = reader_next(&r, r.chunk, src->page_mask + 1);
+	if (n < 0)
+		return n;
+
+	type = decompress_detect(r.chunk, n);
+	if (type == DECOMPRESS_NONE) {
+		memcpy(dst, r.chunk, n);
+		n = reader_next(&r, (unsigned char *) dst + n, r.left);
+		return n < 0 ? n : (int) size;
+	}
+
+	pipe = smp_pipe_create(r.chunk, 2 * BOOT_PAYLOAD_CHUNK);
+	if (pipe) {
+		ret = load_offloaded(&r, pipe, type, n, dst, dst_max, &len);
+		smp_pipe_destroy(pipe);
+	} else {
+		memset(&s, 0, sizeof(s));
+		s.next_in = r.chunk;
+		s.end_in = r.chunk + n;
+		s.fill = chunk_fill;
+		s.fill_arg = &r;
+		s.out = dst;
+		s.out_max = dst_max;
+
+		ret = decompress(type, &s);
+		len = s.out_len;
+	}
+
+	if (ret == ERR_TOO_BIG && (flags & BOOT_PAYLOAD_RAW_FALLBACK)) {
+		dprintf(INFO, "%s: does not fit unpacked, loading it as is\n",
+			name);
+		r.offset = src->offset - ROUND_TO_PAGE(size, src->page_mask);
+		r.left = size;
+		n = reader_next(&r, dst, size);
+		return n < 0 ? n : (int) size;
+	}
+
+	if (ret) {
+		dprintf(CRITICAL, "ERROR: %s: %s payload is corrupt (%d)\n",
+			name, decompress_name(type), ret);
+		return ret;
+	}
+
+	dprintf(INFO, "%s: %s %u -> %u bytes in %u ms, %u ms of it reading%s\n",
+		name, decompress_name(type), size, (unsigned) len,
+		(unsigned) (current_time() - start), (unsigned) r.read_time,
+		pipe ? ", unpacked on cpu1" : "");
+
+	return len;
+}
+
+int boot_payload_unpack(const char *name, const void *payload, unsigned size,
+			void *dst, unsigned dst_max, unsigned flags)
+{
+	struct decompress_stream s;
+	time_t start = current_time();
+	int type;
+	int ret;
+
+	type = decompress_detect(payload, size);
+	if (type == DECOMPRESS_NONE) {
+		memmove(dst, payload, size);
+		return size;
+	}
+
+	memset(&s, 0, sizeof(s));
+	s.next_in = payload;
+	s.end_in = (const unsigned char *) payload + size;
+	s.out = dst;
+	s.out_max = dst_max;
+
+	ret = decompress(type, &s);
+	if (ret == ERR_TOO_BIG && (flags & BOOT_PAYLOAD_RAW_FALLBACK)) {
+		memmove(dst, payload, size);
+		return size;
+	}
+	if (ret) {
+		dprintf(CRITICAL, "ERROR: %s: %s payload is corrupt (%d)\n",
+			name, decompress_name(type), ret);
+		return ret;
+	}
+
+	dprintf(INFO, "%s: %s %u -> %u bytes in %u ms\n", name,
+		decompress_name(type), size, (unsigned) s.out_len,
+		(unsigned) (current_time() - start));
+
+	return s.out_len;
+}
+
+unsigned boot_payload_room(struct boot_img_hdr *hdr, unsigned addr)
+{
+	unsigned limits[4];
+	unsigned end = addr + BOOT_PAYLOAD_MAX;
+	unsigned i;
+
+	limits[0] = hdr->kernel_addr;
+	limits[1] = hdr->ramdisk_addr;
+	limits[2] = hdr->tags_addr;
+	limits[3] = (unsigned) target_get_scratch_address();
+
+	for (i = 0; i < countof(limits); i++)
+		if (limits[i] > addr && limits[i] < end)
+			end = limits[i];
+
+	return end - addr;
+}
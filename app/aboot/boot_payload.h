@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __APP_ABOOT_BOOT_PAYLOAD_H
+#define __APP_ABOOT_BOOT_PAYLOAD_H
+
+#include <sys/types.h>
+#include <lib/ptable.h>
+#include "bootimg.h"
+
+/* where a boot image section is read from: an eMMC partition or, with
+ * flash_ptn set, a NAND partition */
+struct boot_source {
+	unsigned long long mmc_ptn;
+	struct ptentry *flash_ptn;
+	unsigned offset;	/* in the partition, advanced past each section */
+	unsigned page_mask;
+};
+
+/* load flags */
+#define BOOT_PAYLOAD_RAW_FALLBACK	0x1	/* load as is if it does not fit unpacked */
+
+/*
+ * Loads a size byte section of the boot image to dst.  gzip and LZ4
+ * payloads are decompressed while the rest is still being read, at most
+ * dst_max bytes of output.  Returns the size of what ends up at dst, or
+ * < 0 on error.
+ */
+int boot_payload_load(struct boot_source *src, const char *name,
+		      unsigned size, void *dst, unsigned dst_max, unsigned flags);
+
+/* the same for a section already in memory (the signed image path) */
+int boot_payload_unpack(const char *name, const void *payload, unsigned size,
+			void *dst, unsigned dst_max, unsigned flags);
+
+/* room at addr before the next load address in hdr or the scratch area */
+unsigned boot_payload_room(struct boot_img_hdr *hdr, unsigned addr);
+
+#endif
@@ -26,13 +26,18 @@
  * SUCH DAMAGE.
  */
 
+#define DEBUG_MODULE DBG_FASTBOOT
+
 #include <debug.h>
 #include <string.h>
 #include <stdlib.h>
 #include <kernel/thread.h>
 #include <kernel/event.h>
+#include <platform.h>
 #include <dev/udc.h>
 
+#include "fastboot.h"
+
 #define MAX_RSP_SIZE 64
 #define MAX_USBFS_BULK_SIZE (16 * 1024)
 
@@ -70,49 +75,114 @@ struct fastboot_cmd {
 	struct fastboot_cmd *next;
 	const char *prefix;
 	unsigned prefix_len;
+	unsigned key_len;
 	void (*handle)(const char *arg, void *data, unsigned sz);
 };
 
 struct fastboot_var {
-	struct fastboot_var *next;
+	struct fastboot_var *next;	/* hash chain */
+	struct fastboot_var *link;	/* publication order */
 	const char *name;
 	const char *value;
 };
-	
-static struct fastboot_cmd *cmdlist;
+
+/* Commands are hashed on their first token (up to ':', ' ' or the end),
+ * variables on their full name.  Both chains are kept newest first so a
+ * later registration overrides an earlier one, as with the old lists.
+ */
+#define CMD_HASH_SIZE	16
+#define VAR_HASH_SIZE	32
+
+static struct fastboot_cmd *cmd_hash[CMD_HASH_SIZE];
+static struct fastboot_var *var_hash[VAR_HASH_SIZE];
+static struct fastboot_var *varlist, **varlist_tail = &varlist;
+
+static unsigned fastboot_hash(const char *s, unsigned len)
+{
+	unsigned h = 2166136261u;
+
+	while (len--)
+		h = (h ^ (unsigned char) *s++) * 16777619u;
+	return h;
+}
+
+static unsigned cmd_key_len(const char *s)
+{
+	unsigned n = 0;
+
+	while (s[n] && s[n] != ':' && s[n] != ' ')
+		n++;
+	return n;
+}
 
 void fastboot_register(const char *prefix,
 		       void (*handle)(const char *arg, void *data, unsigned sz))
 {
 	struct fastboot_cmd *cmd;
+	unsigned h;
+
 	cmd = malloc(sizeof(*cmd));
 	if (cmd) {
 		cmd->prefix = prefix;
 		cmd->prefix_len = strlen(prefix);
+		cmd->key_len = cmd_key_len(prefix);
 		cmd->handle = handle;
-		cmd->next = cmdlist;
-		cmdlist = cmd;
+		h = fastboot_hash(prefix, cmd->key_len) & (CMD_HASH_SIZE - 1);
+		cmd->next = cmd_hash[h];
+		cmd_hash[h] = cmd;
 	}
 }
 
-static struct fastboot_var *varlist;
+/* longest registered prefix of buf sharing its first token */
+static struct fastboot_cmd *fastboot_find_cmd(const char *buf)
+{
+	struct fastboot_cmd *cmd, *best = NULL;
+	unsigned len = cmd_key_len(buf);
+
+	cmd = cmd_hash[fastboot_hash(buf, len) & (CMD_HASH_SIZE - 1)];
+	for (; cmd; cmd = cmd->next) {
+		if (cmd->key_len != len)
+			continue;
+		if (memcmp(buf, cmd->prefix, cmd->prefix_len))
+			continue;
+		if (!best || cmd->prefix_len > best->prefix_len)
+			best = cmd;
+	}
+	return best;
+}
 
 void fastboot_publish(const char *name, const char *value)
 {
 	struct fastboot_var *var;
+	unsigned h;
+
 	var = malloc(sizeof(*var));
 	if (var) {
 		var->name = name;
 		var->value = value;
-		var->next = varlist;
-		varlist = var;
+		h = fastboot_hash(name, strlen(name)) & (VAR_HASH_SIZE - 1);
+		var->next = var_hash[h];
+		var_hash[h] = var;
+		var->link = NULL;
+		*varlist_tail = var;
+		varlist_tail = &var->link;
 	}
 }
 
+static struct fastboot_var *fastboot_find_var(const char *name)
+{
+	struct fastboot_var *var;
+
+	var = var_hash[fastboot_hash(name, strlen(name)) & (VAR_HASH_SIZE - 1)];
+	for (; var; var = var->next)
+		if (!strcmp(var->name, name))
+			return var;
+	return NULL;
+}
 
 static event_t usb_online;
 static event_t txn_done;
-static unsigned char buffer[4096];
+static unsigned char buffer[4096] __ALIGNED(CACHE_LINE);
 static struct udc_endpoint *in, *out;
 static struct udc_request *req;
 int txn_status;
@@ -177,12 +247,110 @@ oops:
 	return -1;
 }
 
-static int usb_write(void *buf, unsigned len)
+/* Responses are queued in a ring of packet-sized slots and sent on a
+ * second request on the IN endpoint.  Each completion primes the next
+ * slot from interrupt context, so a burst of INFO lines goes out back to
+ * back without the command thread waiting on every round trip.  Anything
+ * else written to the IN endpoint drains the ring first to keep ordering.
+ */
+#define RSP_QUEUE_SLOTS	16
+
+static char rsp_slots[RSP_QUEUE_SLOTS][MAX_RSP_SIZE] __ALIGNED(CACHE_LINE);
+static struct udc_request *rsp_req;
+static volatile unsigned rsp_head, rsp_tail;
+static volatile int rsp_busy, rsp_failed;
+static event_t rsp_space;
+static event_t rsp_idle;
+
+static void rsp_kick(void);
+
+static void rsp_complete(struct udc_request *r, unsigned actual, int status)
+{
+	rsp_busy = 0;
+	if (status < 0) {
+		/* drop what is left, the next write will fail the session */
+		rsp_failed = 1;
+		rsp_tail = rsp_head;
+	} else {
+		rsp_tail++;
+	}
+	event_signal(&rsp_space, false);
+	rsp_kick();
+}
+
+/* called from the completion interrupt or inside a critical section */
+static void rsp_kick(void)
+{
+	char *slot;
+
+	if (rsp_busy)
+		return;
+	if (rsp_tail == rsp_head) {
+		event_signal(&rsp_idle, false);
+		return;
+	}
+
+	slot = rsp_slots[rsp_tail % RSP_QUEUE_SLOTS];
+	rsp_req->buf = slot;
+	rsp_req->length = strlen(slot);
+	rsp_req->complete = rsp_complete;
+	rsp_busy = 1;
+	if (udc_request_queue(in, rsp_req) < 0) {
+		rsp_busy = 0;
+		rsp_failed = 1;
+		rsp_tail = rsp_head;
+		event_signal(&rsp_space, false);
+		event_signal(&rsp_idle, false);
+	}
+}
+
+/* returns a free slot with interrupts disabled; rsp_commit() releases */
+static char *rsp_reserve(void)
+{
+	enter_critical_section();
+	while (rsp_head - rsp_tail >= RSP_QUEUE_SLOTS) {
+		exit_critical_section();
+		event_wait(&rsp_space);
+		enter_critical_section();
+	}
+	return rsp_slots[rsp_head % RSP_QUEUE_SLOTS];
+}
+
+static void rsp_commit(void)
+{
+	rsp_head++;
+	rsp_kick();
+	exit_critical_section();
+}
+
+static int rsp_flush(void)
+{
+	enter_critical_section();
+	while (rsp_busy || rsp_head != rsp_tail) {
+		exit_critical_section();
+		event_wait(&rsp_idle);
+		enter_critical_section();
+	}
+	exit_critical_section();
+
+	if (rsp_failed) {
+		rsp_failed = 0;
+		dprintf(INFO, "fastboot: response transaction failed\n");
+		fastboot_state = STATE_ERROR;
+		return -1;
+	}
+	return 0;
+}
+
+static int usb_write_start(void *buf, unsigned len)
 {
 	int r;
 
 	if (fastboot_state == STATE_ERROR)
-		goto oops;
+		return -1;
+
+	if (rsp_flush() < 0)
+		return -1;
 
 	req->buf = buf;
 	req->length = len;
@@ -190,23 +358,33 @@ static int usb_write(void *buf, unsigned len)
 	r = udc_request_queue(in, req);
 	if (r < 0) {
 		dprintf(INFO, "usb_write() queue failed\n");
-		goto oops;
+		fastboot_state = STATE_ERROR;
+		return -1;
 	}
+	return 0;
+}
+
+static int usb_write_wait(void)
+{
 	event_wait(&txn_done);
 	if (txn_status < 0) {
 		dprintf(INFO, "usb_write() transaction failed\n");
-		goto oops;
+		fastboot_state = STATE_ERROR;
+		return -1;
 	}
 	return req->length;
+}
 
-oops:
-	fastboot_state = STATE_ERROR;
-	return -1;
+static int usb_write(void *buf, unsigned len)
+{
+	if (usb_write_start(buf, len) < 0)
+		return -1;
+	return usb_write_wait();
 }
 
 void fastboot_ack(const char *code, const char *reason)
 {
-	char response[MAX_RSP_SIZE];
+	char *response;
 
 	if (fastboot_state != STATE_COMMAND)
 		return;
@@ -214,16 +392,20 @@ void fastboot_ack(const char *code, const char *reason)
 	if (reason == 0)
 		reason = "";
 
-	snprintf(response, MAX_RSP_SIZE, "%s%s", code, reason);
 	fastboot_state = STATE_COMPLETE;
 
-	usb_write(response, strlen(response));
-
+	/* the final response is formatted straight into the queue and
+	 * drained, so the handler may reboot or leave fastboot after us
+	 */
+	response = rsp_reserve();
+	snprintf(response, MAX_RSP_SIZE, "%s%s", code, reason);
+	rsp_commit();
+	rsp_flush();
 }
 
 void fastboot_info(const char *reason)
 {
-	char response[MAX_RSP_SIZE];
+	char *response;
 
 	if (fastboot_state != STATE_COMMAND)
 		return;
@@ -231,9 +413,9 @@ void fastboot_info(const char *reason)
 	if (reason == 0)
 		return;
 
+	response = rsp_reserve();
 	snprintf(response, MAX_RSP_SIZE, "INFO%s", reason);
-
-	usb_write(response, strlen(response));
+	rsp_commit();
 }
 
 void fastboot_fail(const char *reason)
@@ -250,11 +432,24 @@ static void cmd_getvar(const char *arg, void *data, unsigned sz)
 {
 	struct fastboot_var *var;
 
-	for (var = varlist; var; var = var->next) {
-		if (!strcmp(var->name, arg)) {
-			fastboot_okay(var->value);
-			return;
-		}
+	var = fastboot_find_var(arg);
+	fastboot_okay(var ? var->value : "");
+}
+
+/* every published variable as "name: value" INFO lines in one burst */
+static void cmd_getvar_all(const char *arg, void *data, unsigned sz)
+{
+	struct fastboot_var *var;
+	char *response;
+
+	for (var = varlist; var; var = var->link) {
+		/* skip entries shadowed by a later publish */
+		if (fastboot_find_var(var->name) != var)
+			continue;
+		response = rsp_reserve();
+		snprintf(response, MAX_RSP_SIZE, "INFO%s: %s",
+			 var->name, var->value);
+		rsp_commit();
 	}
 	fastboot_okay("");
 }
@@ -263,6 +458,7 @@ static void cmd_download(const char *arg, void *data, unsigned sz)
 {
 	char response[MAX_RSP_SIZE];
 	unsigned len = hex2unsigned(arg);
+	bigtime_t start, elapsed;
 	int r;
 
 	download_size = 0;
@@ -275,15 +471,104 @@ static void cmd_download(const char *arg, void *data, unsigned sz)
 	if (usb_write(response, strlen(response)) < 0)
 		return;
 
+	start = current_time_hires();
 	r = usb_read(download_base, len);
 	if ((r < 0) || ((unsigned) r != len)) {
 		fastboot_state = STATE_ERROR;
 		return;
 	}
+	elapsed = current_time_hires() - start;
+	if (elapsed) {
+		/* bytes per microsecond is MB/s */
+		unsigned rate = (unsigned) (((unsigned long long) len * 100) / elapsed);
+		dprintf(INFO, "fastboot: received %u bytes in %u ms (%u.%02u MB/s)\n",
+			len, (unsigned) (elapsed / 1000), rate / 100, rate % 100);
+	}
 	download_size = len;
 	fastboot_okay("");
 }
 
+/* Source of the next "upload" data phase.  With no read callback the
+ * data is sent straight from memory at arg.
+ */
+static unsigned upload_size;
+static fastboot_read_fn upload_read;
+static void *upload_arg;
+
+void fastboot_stage_upload(unsigned size, fastboot_read_fn read, void *arg)
+{
+	upload_size = size;
+	upload_read = read;
+	upload_arg = arg;
+}
+
+static void cmd_upload(const char *arg, void *data, unsigned sz)
+{
+	char response[MAX_RSP_SIZE];
+	unsigned size = upload_size;
+	unsigned char *bufs = NULL;
+	unsigned char *buf;
+	unsigned offset, n;
+	int pending = 0;
+	bigtime_t start, elapsed;
+
+	if (!size) {
+		fastboot_fail("nothing staged for upload");
+		return;
+	}
+	upload_size = 0;
+
+	if (upload_read) {
+		bufs = memalign(CACHE_LINE, 2 * FASTBOOT_UPLOAD_CHUNK);
+		if (!bufs) {
+			fastboot_fail("out of memory");
+			return;
+		}
+	}
+
+	snprintf(response, MAX_RSP_SIZE, "DATA%08x", size);
+	if (usb_write(response, strlen(response)) < 0)
+		goto out;
+
+	/* with a read callback, fill one buffer while the other is on the
+	 * wire; otherwise send from memory one transfer at a time */
+	start = current_time_hires();
+	for (offset = 0; offset < size; offset += n) {
+		n = MIN(size - offset, FASTBOOT_UPLOAD_CHUNK);
+		if (upload_read) {
+			buf = bufs + (pending & 1) * FASTBOOT_UPLOAD_CHUNK;
+			if (upload_read(upload_arg, offset, buf, n) < 0) {
+				dprintf(CRITICAL, "fastboot: upload read failed at 0x%x\n",
+					offset);
+				if (pending)
+					usb_write_wait();
+				fastboot_state = STATE_ERROR;
+				goto out;
+			}
+		} else {
+			buf = (unsigned char *) upload_arg + offset;
+		}
+
+		if (pending && usb_write_wait() < 0)
+			goto out;
+		if (usb_write_start(buf, n) < 0)
+			goto out;
+		pending++;
+	}
+	if (pending && usb_write_wait() < 0)
+		goto out;
+
+	elapsed = current_time_hires() - start;
+	if (elapsed) {
+		unsigned rate = (unsigned) (((unsigned long long) size * 100) / elapsed);
+		dprintf(INFO, "fastboot: sent %u bytes in %u ms (%u.%02u MB/s)\n",
+			size, (unsigned) (elapsed / 1000), rate / 100, rate % 100);
+	}
+	fastboot_okay("");
+out:
+	free(bufs);
+}
+
 static void fastboot_command_loop(void)
 {
 	struct fastboot_cmd *cmd;
@@ -297,9 +582,8 @@ again:
 		buffer[r] = 0;
 		dprintf(INFO,"fastboot: %s\n", buffer);
 
-		for (cmd = cmdlist; cmd; cmd = cmd->next) {
-			if (memcmp(buffer, cmd->prefix, cmd->prefix_len))
-				continue;
+		cmd = fastboot_find_cmd((const char*) buffer);
+		if (cmd) {
 			fastboot_state = STATE_COMMAND;
 			cmd->handle((const char*) buffer + cmd->prefix_len,
 				    (void*) download_base, download_size);
@@ -353,6 +637,8 @@ int fastboot_init(void *base, unsigned size)
 
 	event_init(&usb_online, 0, EVENT_FLAG_AUTOUNSIGNAL);
 	event_init(&txn_done, 0, EVENT_FLAG_AUTOUNSIGNAL);
+	event_init(&rsp_space, 0, EVENT_FLAG_AUTOUNSIGNAL);
+	event_init(&rsp_idle, 0, EVENT_FLAG_AUTOUNSIGNAL);
 
 	in = udc_endpoint_alloc(UDC_TYPE_BULK_IN, 512);
 	if (!in)
@@ -367,12 +653,17 @@ int fastboot_init(void *base, unsigned size)
 	req = udc_request_alloc();
 	if (!req)
 		goto fail_alloc_req;
+	rsp_req = udc_request_alloc();
+	if (!rsp_req)
+		goto fail_alloc_rsp;
 
 	if (udc_register_gadget(&fastboot_gadget))
 		goto fail_udc_register;
 
 	fastboot_register("getvar:", cmd_getvar);
+	fastboot_register("getvar:all", cmd_getvar_all);
 	fastboot_register("download:", cmd_download);
+	fastboot_register("upload", cmd_upload);
 	fastboot_publish("version", "0.5");
 
 	thr = thread_create("fastboot", fastboot_handler, 0, DEFAULT_PRIORITY, 4096);
@@ -384,6 +675,8 @@ int fastboot_init(void *base, unsigned size)
 	return 0;
 
 fail_udc_register:
+	udc_request_free(rsp_req);
+fail_alloc_rsp:
 	udc_request_free(req);
 fail_alloc_req:
 	udc_endpoint_free(out);	
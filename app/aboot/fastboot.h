@@ -47,5 +47,17 @@ void fastboot_okay(const char *result);
 void fastboot_fail(const char *reason);
 void fastboot_info(const char *reason);
 
+/* Stage size bytes for the next "upload" command.  read is called with
+ * increasing offsets for at most FASTBOOT_UPLOAD_CHUNK bytes at a time
+ * and must return < 0 on error; the buffer has room for len rounded up
+ * to a 4K page.  With read NULL the data is sent from memory at arg.
+ */
+#define FASTBOOT_UPLOAD_CHUNK	(16 * 1024)
+
+typedef int (*fastboot_read_fn)(void *arg, unsigned offset, void *buf,
+				unsigned len);
+
+void fastboot_stage_upload(unsigned size, fastboot_read_fn read, void *arg);
+
 
 #endif
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __APP_ABOOT_NAND_TAG_FORMAT_H
+#define __APP_ABOOT_NAND_TAG_FORMAT_H
+
+#include <sys/types.h>
+
+/*
+ * NAND filesystem image without interleaved spare bytes:
+ *
+ *   header | pages * page_size bytes of data | pages * tag_size OOB tags
+ *
+ * The bootloader places each page's tags in the free spare bytes itself,
+ * so host tools only need to know the page size, not the ECC layout.
+ * "getvar nand-tag-size" reports how many tag bytes a page can hold.
+ */
+typedef struct nand_tag_header {
+	uint32_t magic;		/* NAND_TAG_MAGIC */
+	uint32_t hdr_sz;	/* page data offset, a multiple of 32 */
+	uint32_t page_size;	/* must match the flash page size */
+	uint32_t tag_size;	/* OOB tag bytes per page */
+	uint32_t pages;		/* pages of data, and of tags */
+	uint32_t reserved[3];
+} nand_tag_header_t;
+
+#define NAND_TAG_MAGIC		0x4754414e	/* "NATG" */
+
+/* UBI erase counter header magic, "UBI#" */
+#define UBI_EC_HDR_MAGIC	"UBI#"
+#define UBI_EC_HDR_MAGIC_SIZE	4
+
+#endif
@@ -31,7 +31,11 @@
 #include <arch/arm.h>
 #include <dev/udc.h>
 #include <string.h>
+#include <stdlib.h>
+#include <malloc.h>
 #include <kernel/thread.h>
+#include <kernel/mutex.h>
+#include <kernel/event.h>
 #include <arch/ops.h>
 
 #include <dev/flash.h>
@@ -93,85 +97,210 @@ int get_recovery_message(struct recovery_message *out)
 	memcpy(out, buf, sizeof(*out));
 	return 0;
 }
-int save_debug_message(void)
+#if WITH_DEBUG_GLOBAL_RAM
+#define SAVE_LOG_MAGIC_0	0x6e616670
+#define SAVE_LOG_MAGIC_1	0x676f6c67
+
+/* print_idx covered by the last completed save */
+static unsigned log_saved_idx;
+static unsigned char log_save_requested;
+static mutex_t log_save_lock;
+static event_t log_save_event;
+static thread_t *log_save_thread;
+
+/*
+ * On eMMC the log lives in misc at MISC_SKIP_BYTE: a sector holding the
+ * save_log_message cookie, then print_buf byte for byte. A save only
+ * rewrites the sectors print_idx moved through since the last one.
+ */
+static unsigned long long log_ptn_offset;
+static unsigned char log_cookie[512] __ALIGNED(CACHE_LINE);
+
+static int save_log_range(unsigned start, unsigned end)
 {
+	unsigned long long base = log_ptn_offset + MISC_SKIP_BYTE + 512;
 
-#if WITH_DEBUG_GLOBAL_RAM
-	unsigned n = 0;
-	struct save_log_message save_log_cookie;
+	start &= ~511;
+	end = ROUND_TO_PAGE(end, 511);
+	if (start >= end)
+		return 0;
 
-	if (target_is_emmc_boot()) {
-		char *ptn_name = "misc";
-		unsigned long long ptn_offset = 0;
-		unsigned int index;
+	arch_clean_cache_range((addr_t) print_buf + start, end - start);
+	return mmc_write(base + start, end - start,
+			 (unsigned int *) (print_buf + start));
+}
 
-		index = partition_get_index((unsigned char *) ptn_name);
+static int save_log_mmc(void)
+{
+	struct save_log_message *cookie = (void *) log_cookie;
+	unsigned idx = print_idx;
+	int index;
+	int ret = 0;
 
-		if(INVALID_PTN == index) {
+	if (log_ptn_offset == 0) {
+		index = partition_get_index((unsigned char *) "misc");
+		if (INVALID_PTN == index) {
 			dprintf(CRITICAL, "ERROR: Partition index not found\n");
 			return -1;
 		}
+		log_ptn_offset = partition_get_offset(index);
+	}
 
-		ptn_offset = partition_get_offset(index); 
+	if (idx == log_saved_idx)
+		return 0;
 
-		dprintf(INFO, "INFO: save the lk log to misc\n");
-		save_log_cookie.flags[0] = 0x6e616670;
-		save_log_cookie.flags[1] = 0x676f6c67;
-		save_log_cookie.length = print_idx;
+	/* print_buf wrapped: finish the old tail, then start over */
+	if (idx < log_saved_idx) {
+		ret = save_log_range(log_saved_idx, PRINT_BUFF_SIZE);
+		log_saved_idx = 0;
+	}
+	/* the first sector carries the ring header with print_idx */
+	if (!ret && log_saved_idx >= 512)
+		ret = save_log_range(0, 12);
+	if (!ret)
+		ret = save_log_range(log_saved_idx, idx);
+	if (!ret) {
+		cookie->flags[0] = SAVE_LOG_MAGIC_0;
+		cookie->flags[1] = SAVE_LOG_MAGIC_1;
+		cookie->length = idx;
+		arch_clean_cache_range((addr_t) log_cookie, sizeof(log_cookie));
+		ret = mmc_write(log_ptn_offset + MISC_SKIP_BYTE,
+				sizeof(log_cookie), (unsigned int *) log_cookie);
+	}
+	if (ret) {
+		dprintf(CRITICAL, "ERROR: flash write fail!\n");
+		return -1;
+	}
 
-		memset((void*)SCRATCH_ADDR, 0, 512);
-		memcpy((void*)SCRATCH_ADDR,(void*)&save_log_cookie, sizeof(struct save_log_message));
+	log_saved_idx = idx;
+	return 0;
+}
 
-		/*Save cookie*/
-		if (mmc_write(ptn_offset + MISC_SKIP_BYTE, 512, (void *)SCRATCH_ADDR)) {
-			dprintf(CRITICAL, "ERROR: flash write fail!\n");
-			return -1;
-		}
-		memcpy((void*)SCRATCH_ADDR ,(void *)print_buf, save_log_cookie.length);
-		arch_disable_cache(UCACHE);
-		n = ( save_log_cookie.length / 512 + 1) * 512; 
+/*
+ * On NAND the cookie and print_buf go to the start of FOTA. flash_write()
+ * erases and rewrites the partition, so this is always a full save.
+ */
+static int save_log_flash(void)
+{
+	static unsigned char *log_page_buf;
+	struct save_log_message *cookie;
+	struct ptentry *ptn;
+	struct ptable *ptable;
+	unsigned pagesize = flash_page_size();
+	unsigned idx = print_idx;
+	unsigned n;
 
-		if (mmc_write(ptn_offset + MISC_SKIP_BYTE + 512, n, (void *)SCRATCH_ADDR)) {
-			dprintf(CRITICAL, "ERROR: flash write fail!\n");
-			return -1;
-		}
-	}else{
-		struct ptentry *ptn;
-		struct ptable *ptable;
-		unsigned offset = 0;
-		unsigned pagesize = flash_page_size();
-		unsigned pagemask = pagesize -1;
+	if (idx == log_saved_idx)
+		return 0;
 
-		ptable = flash_get_ptable();
+	ptable = flash_get_ptable();
+	if (ptable == NULL) {
+		dprintf(CRITICAL, "ERROR: Partition table not found\n");
+		return -1;
+	}
+	ptn = ptable_find(ptable, "FOTA");
+	if (ptn == NULL) {
+		dprintf(CRITICAL, "ERROR: No FOTA partition found\n");
+		return -1;
+	}
 
-		if (ptable == NULL) {
-			dprintf(CRITICAL, "ERROR: Partition table not found\n");
-			return -1;
-		}
-		ptn = ptable_find(ptable, "FOTA");
+	n = ROUNDUP(sizeof(struct save_log_message) + PRINT_BUFF_SIZE, pagesize);
+	if (log_page_buf == NULL)
+		log_page_buf = memalign(CACHE_LINE, n);
+	if (log_page_buf == NULL) {
+		dprintf(CRITICAL, "ERROR: No memory to save the log\n");
+		return -1;
+	}
 
-		if (ptn == NULL) {
-			dprintf(CRITICAL, "ERROR: No misc partition found\n");
-			return -1;
-		}
-		dprintf(INFO, "INFO: save the lk log to misc\n");
-		save_log_cookie.flags[0] = 0x6e616670;
-		save_log_cookie.flags[1] = 0x676f6c67;
-		save_log_cookie.length = print_idx;
-
-		memcpy((void*)SCRATCH_ADDR,(void*)&save_log_cookie, sizeof(struct save_log_message));
-		memcpy((void*)SCRATCH_ADDR + sizeof(struct save_log_message),(void *)print_buf, save_log_cookie.length);
-		arch_disable_cache(UCACHE);
-		n = ((sizeof(struct save_log_message) + save_log_cookie.length )/pagesize + 1) * pagesize; 
-		if (flash_write(ptn, 0, (void *)SCRATCH_ADDR, n)) {
-			dprintf(CRITICAL, "ERROR: flash write fail!\n");
-			return -1;
-		}
+	cookie = (void *) log_page_buf;
+	cookie->flags[0] = SAVE_LOG_MAGIC_0;
+	cookie->flags[1] = SAVE_LOG_MAGIC_1;
+	cookie->length = idx;
+	memcpy(log_page_buf + sizeof(*cookie), print_buf, idx);
+
+	n = ROUNDUP(sizeof(*cookie) + idx, pagesize);
+	arch_clean_cache_range((addr_t) log_page_buf, n);
+	if (flash_write(ptn, 0, log_page_buf, n)) {
+		dprintf(CRITICAL, "ERROR: flash write fail!\n");
+		return -1;
+	}
+
+	log_saved_idx = idx;
+	return 0;
+}
+
+static void save_log_init(void)
+{
+	if (log_save_requested)
+		return;
+
+	mutex_init(&log_save_lock);
+	event_init(&log_save_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+	log_save_requested = 1;
+}
+
+static int save_log_thread_entry(void *arg)
+{
+	for (;;) {
+		event_wait(&log_save_event);
+		mutex_acquire(&log_save_lock);
+		save_log_mmc();
+		mutex_release(&log_save_lock);
+	}
+	return 0;
+}
+#endif
+
+/*
+ * Queues a save of the LK log. On eMMC a low priority thread writes the
+ * new part of print_buf in the background; on NAND the save is left to
+ * save_debug_message_flush(), a NAND save being a full partition rewrite.
+ */
+int save_debug_message(void)
+{
+#if WITH_DEBUG_GLOBAL_RAM
+	save_log_init();
+
+	if (!target_is_emmc_boot())
+		return 0;
+
+	if (log_save_thread == NULL) {
+		log_save_thread = thread_create("log_save",
+						save_log_thread_entry, NULL,
+						LOW_PRIORITY,
+						DEFAULT_STACK_SIZE);
+		if (log_save_thread == NULL)
+			return save_debug_message_flush();
+		thread_resume(log_save_thread);
 	}
+	event_signal(&log_save_event, false);
 #endif
 	return 0;
 }
 
+/*
+ * Synchronously writes whatever part of the log is not saved yet. Called
+ * before leaving LK, where only the tail since the last save is left.
+ */
+int save_debug_message_flush(void)
+{
+	int ret = 0;
+
+#if WITH_DEBUG_GLOBAL_RAM
+	save_log_init();
+	/* pending dlog() records belong in the saved log */
+	dlog_flush();
+
+	mutex_acquire(&log_save_lock);
+	if (target_is_emmc_boot())
+		ret = save_log_mmc();
+	else
+		ret = save_log_flash();
+	mutex_release(&log_save_lock);
+#endif
+	return ret;
+}
+
 int set_recovery_message(const struct recovery_message *in)
 {
 	struct ptentry *ptn;
@@ -466,67 +595,35 @@ SEND_RECOVERY_MSG:
 
 static int emmc_set_recovery_msg(struct recovery_message *out)
 {
-	char *ptn_name = "misc";
-	unsigned long long ptn = 0;
-	unsigned int size = ROUND_TO_PAGE(sizeof(*out),511);
-	unsigned char data[size];
-	int index = INVALID_PTN;
-
-	index = partition_get_index((unsigned char *) ptn_name);
-	ptn = partition_get_offset(index);
-	if(ptn == 0) {
-		dprintf(CRITICAL,"partition %s doesn't exist\n",ptn_name);
-		return -1;
-	}
-	memcpy(data, out, sizeof(*out));
-	if (mmc_write(ptn , size, (unsigned int*)data)) {
-		dprintf(CRITICAL,"mmc write failure %s %d\n",ptn_name, sizeof(*out));
+	void *msg = boot_state_get(BOOT_STATE_MISC_MSG);
+
+	if (msg == NULL)
 		return -1;
-	}
+
+	memcpy(msg, out, sizeof(*out));
+	boot_state_dirty(BOOT_STATE_MISC_MSG);
 	return 0;
 }
 
 static int emmc_get_recovery_msg(struct recovery_message *in)
 {
-	char *ptn_name = "misc";
-	unsigned long long ptn = 0;
-	unsigned int size = ROUND_TO_PAGE(sizeof(*in),511);
-	unsigned char data[size];
-	int index = INVALID_PTN;
-
-	index = partition_get_index((unsigned char *) ptn_name);
-	ptn = partition_get_offset(index);
-	if(ptn == 0) {
-		dprintf(CRITICAL,"partition %s doesn't exist\n",ptn_name);
-		return -1;
-	}
-	if (mmc_read(ptn , (unsigned int*)data, size)) {
-		dprintf(CRITICAL,"mmc read failure %s %d\n",ptn_name, size);
+	void *msg = boot_state_get(BOOT_STATE_MISC_MSG);
+
+	if (msg == NULL)
 		return -1;
-	}
-	memcpy(in, data, sizeof(*in));
+
+	memcpy(in, msg, sizeof(*in));
 	return 0;
 }
 
 int emmc_get_fastmmi_msg(struct boot_mode_message *in)
 {
-	char *ptn_name = "misc";
-	unsigned long long ptn = 0;
-	unsigned int size = ROUND_TO_PAGE(sizeof(*in),511);
-	unsigned char data[size];
-	int index = INVALID_PTN;
-
-    index = partition_get_index((char *) ptn_name);
-    ptn = partition_get_offset(index);
-    if(ptn == 0) {
-		dprintf(CRITICAL,"partition %s doesn't exist\n",ptn_name);
-		return -1;
-	}
-	if (mmc_read(ptn + FASTMMI_MSG_OFFSET, (unsigned int*)data, size)) {
-		dprintf(CRITICAL,"mmc read failure %s %d\n",ptn_name, size);
+	unsigned char *msg = boot_state_get(BOOT_STATE_MISC_MSG);
+
+	if (msg == NULL)
 		return -1;
-	}
-	memcpy(in, data, sizeof(*in));
+
+	memcpy(in, msg + FASTMMI_MSG_OFFSET, sizeof(*in));
 	return 0;
 }
 
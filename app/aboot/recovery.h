@@ -101,6 +101,19 @@ int recovery_init (void);
 
 int save_debug_message(void);
 
+/* eMMC bootloader state records, see boot_state_get() */
+enum boot_state_id {
+	BOOT_STATE_MISC_MSG = 0,	/* recovery and fastmmi messages */
+	BOOT_STATE_CPR,
+	BOOT_STATE_DEVINFO,
+	BOOT_STATE_MAX
+};
+
+void *boot_state_get(enum boot_state_id id);
+void boot_state_dirty(enum boot_state_id id);
+int boot_state_flush(void);
+int save_debug_message_flush(void);
+
 extern unsigned boot_into_recovery;
 
 #endif
@@ -2,8 +2,12 @@ LOCAL_DIR := $(GET_LOCAL_DIR)
 
 INCLUDES += -I$(LK_TOP_DIR)/platform/msm_shared/include
 
+MODULES += \
+	lib/profile \
+	lib/decompress
+
 OBJS += \
 	$(LOCAL_DIR)/aboot.o \
 	$(LOCAL_DIR)/fastboot.o \
+	$(LOCAL_DIR)/boot_payload.o \
 	$(LOCAL_DIR)/recovery.o
-
@@ -25,6 +25,8 @@
 
 int thread_tests(void);
 void printf_tests(void);
+int smp_tests(void);
+int sha256_tests(void);
 
 #endif
 
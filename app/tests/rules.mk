@@ -5,4 +5,6 @@ INCLUDES += -I$(LOCAL_DIR)/include
 OBJS += \
 	$(LOCAL_DIR)/tests.o \
 	$(LOCAL_DIR)/thread_tests.o \
-	$(LOCAL_DIR)/printf_tests.o
+	$(LOCAL_DIR)/printf_tests.o \
+	$(LOCAL_DIR)/smp_tests.o \
+	$(LOCAL_DIR)/sha256_tests.o
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <app/tests.h>
+#include <debug.h>
+#include <stdlib.h>
+#include <string.h>
+#include <platform.h>
+#include <sha.h>
+
+#define SHA256_PATTERN_LEN	4099	/* not a multiple of the block size */
+#define SHA256_BENCH_LEN	(1024 * 1024)
+
+struct sha256_kat {
+	const char *msg;
+	unsigned repeat;
+	const char *digest;
+};
+
+/* FIPS 180-2 examples */
+static const struct sha256_kat sha256_kats[] = {
+	{ "", 1,
+	  "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+	{ "abc", 1,
+	  "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+	{ "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+	  "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+	{ "a", 1000000,
+	  "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" },
+};
+
+/* the SHA256_PATTERN_LEN bytes of sha256_pattern() */
+static const char sha256_pattern_digest[] =
+	"f4e7f8911224d255d5f71e3c565cb1e74bd3fcdeec4cd3e2c84fd7c7ee0d35a9";
+
+static void sha256_pattern(unsigned char *buf, unsigned len)
+{
+	unsigned i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = i * 7 + (i >> 8);
+}
+
+static int sha256_check(const char *name, const unsigned char *digest,
+			const char *expect)
+{
+	char hex[SHA256_DIGEST_LENGTH * 2 + 1];
+	unsigned i;
+
+	for (i = 0; i < SHA256_DIGEST_LENGTH; i++)
+		snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+
+	if (strcmp(hex, expect)) {
+		printf("sha256 %s: FAIL\n  got    %s\n  expect %s\n", name, hex, expect);
+		return 1;
+	}
+	return 0;
+}
+
+int sha256_tests(void)
+{
+	unsigned char digest[SHA256_DIGEST_LENGTH];
+	unsigned char *buf;
+	SHA256_CTX ctx;
+	bigtime_t start, elapsed;
+	unsigned i, j, len, off, rate;
+	int errors = 0;
+
+	printf("sha256 known answer tests\n");
+	for (i = 0; i < countof(sha256_kats); i++) {
+		len = strlen(sha256_kats[i].msg);
+		SHA256_Init(&ctx);
+		for (j = 0; j < sha256_kats[i].repeat; j++)
+			SHA256_Update(&ctx, sha256_kats[i].msg, len);
+		SHA256_Final(digest, &ctx);
+		errors += sha256_check(sha256_kats[i].msg[0] ? sha256_kats[i].msg : "\"\"",
+				       digest, sha256_kats[i].digest);
+	}
+
+	buf = memalign(CACHE_LINE, SHA256_BENCH_LEN + 4);
+	if (!buf) {
+		printf("sha256_tests: out of memory\n");
+		return -1;
+	}
+
+	/* unaligned input and odd update sizes, the block function sees
+	 * every alignment of the data */
+	for (off = 0; off < 4; off++) {
+		sha256_pattern(buf + off, SHA256_PATTERN_LEN);
+		SHA256(buf + off, SHA256_PATTERN_LEN, digest);
+		errors += sha256_check("pattern", digest, sha256_pattern_digest);
+
+		SHA256_Init(&ctx);
+		for (i = 0; i < SHA256_PATTERN_LEN; i += len) {
+			len = MIN(SHA256_PATTERN_LEN - i, 1 + (i % 131));
+			SHA256_Update(&ctx, buf + off + i, len);
+		}
+		SHA256_Final(digest, &ctx);
+		errors += sha256_check("pattern chunked", digest,
+				       sha256_pattern_digest);
+	}
+
+	sha256_pattern(buf, SHA256_BENCH_LEN);
+	start = current_time_hires();
+	SHA256(buf, SHA256_BENCH_LEN, digest);
+	elapsed = current_time_hires() - start;
+	rate = elapsed ? (unsigned) (((unsigned long long) SHA256_BENCH_LEN * 100) / elapsed) : 0;
+	printf("sha256: %u bytes in %u us, %u.%02u MB/s\n", SHA256_BENCH_LEN,
+	       (unsigned) elapsed, rate / 100, rate % 100);
+
+	free(buf);
+
+	printf("sha256_tests: %s\n", errors ? "FAILED" : "passed");
+	return errors;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <app/tests.h>
+#include <debug.h>
+#include <stdlib.h>
+#include <string.h>
+#include <smp.h>
+
+#define SMP_TEST_LEN	(64 * 1024)
+#define SMP_TEST_JOBS	16	/* more than the queue holds */
+
+struct checksum_args {
+	const uint8_t *buf;
+	size_t len;
+	uint32_t seed;
+	uint32_t *result;
+};
+
+/* job output gets invalidated on completion, give it whole cache lines */
+struct checksum_result {
+	uint32_t sum;
+} __ALIGNED(CACHE_LINE);
+
+static struct checksum_result results[SMP_TEST_JOBS];
+
+static void checksum_job(void *arg)
+{
+	struct checksum_args *args = arg;
+	uint32_t sum = args->seed;
+	size_t i;
+
+	for (i = 0; i < args->len; i++)
+		sum = (sum << 5) + sum + args->buf[i];
+
+	*args->result = sum;
+}
+
+int smp_tests(void)
+{
+	struct checksum_args args;
+	uint32_t expect;
+	int tickets[SMP_TEST_JOBS];
+	uint8_t *buf;
+	int failed = 0;
+	int i;
+
+	printf("smp tests: secondary core %s\n",
+	       smp_secondary_online() ? "online" : "offline, jobs run inline");
+
+	buf = malloc(SMP_TEST_LEN);
+	if (!buf)
+		return -1;
+	for (i = 0; i < SMP_TEST_LEN; i++)
+		buf[i] = i * 7 + (i >> 8);
+
+	args.buf = buf;
+	args.len = SMP_TEST_LEN;
+
+	for (i = 0; i < SMP_TEST_JOBS; i++) {
+		args.seed = i;
+		args.result = &results[i].sum;
+		tickets[i] = smp_job_post(checksum_job, &args, sizeof(args),
+					  buf, SMP_TEST_LEN,
+					  &results[i], sizeof(results[i]));
+	}
+
+	for (i = 0; i < SMP_TEST_JOBS; i++) {
+		smp_job_wait(tickets[i]);
+
+		args.seed = i;
+		args.result = &expect;
+		checksum_job(&args);
+		if (results[i].sum != expect) {
+			printf("job %d: got 0x%x expected 0x%x\n",
+			       i, results[i].sum, expect);
+			failed++;
+		}
+	}
+
+	free(buf);
+
+	printf("smp tests: %d of %d jobs failed\n", failed, SMP_TEST_JOBS);
+	return failed ? -1 : 0;
+}
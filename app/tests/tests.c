@@ -31,6 +31,8 @@
 STATIC_COMMAND_START
 STATIC_COMMAND("printf_tests", NULL, (console_cmd)&printf_tests)
 STATIC_COMMAND("thread_tests", NULL, (console_cmd)&thread_tests)
+STATIC_COMMAND("smp_tests", NULL, (console_cmd)&smp_tests)
+STATIC_COMMAND("sha256_tests", NULL, (console_cmd)&sha256_tests)
 STATIC_COMMAND_END(tests);
 
 #endif
@@ -132,6 +132,7 @@ int mutex_test(void)
 	printf("done with mutex tests\n");
 
 	mutex_destroy(&timeout_mutex);
+	mutex_destroy(&m);
 
 	return 0;
 }
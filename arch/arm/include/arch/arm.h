@@ -83,10 +83,15 @@ uint32_t arm_read_cr1(void);
 void arm_write_cr1(uint32_t val);
 uint32_t arm_read_cr1_aux(void);
 void arm_write_cr1_aux(uint32_t val);
+uint32_t arm_read_ttbr(void);
 void arm_write_ttbr(uint32_t val);
 void arm_write_dacr(uint32_t val);
 void arm_invalidate_tlb(void);
 
+void dmb(void);
+void dsb(void);
+void isb(void);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -44,6 +44,9 @@ uint32_t arm_mmu_virt2phy(uint32_t virt_addr);
 #define MMU_MEMORY_TYPE_NORMAL_WRITE_BACK_NO_ALLOCATE ((0x0 << 12) | (0x3 << 2))
 #define MMU_MEMORY_TYPE_NORMAL_WRITE_BACK_ALLOCATE    ((0x1 << 12) | (0x3 << 2))
 
+/* normal memory, uncached but bufferable: for buffers the CPU only streams to */
+#define MMU_MEMORY_TYPE_WRITE_COMBINE                 MMU_MEMORY_TYPE_NORMAL
+
 #define MMU_MEMORY_AP_NO_ACCESS     (0x0 << 10)
 #define MMU_MEMORY_AP_READ_ONLY     (0x7 << 10)
 #define MMU_MEMORY_AP_READ_WRITE    (0x3 << 10)
@@ -57,6 +60,20 @@ uint32_t arm_mmu_virt2phy(uint32_t virt_addr);
 #endif
 
 void arm_mmu_map_section(addr_t paddr, addr_t vaddr, uint flags);
+void arm_mmu_map_page(addr_t paddr, addr_t vaddr, uint flags);
+
+/* A physically contiguous range mapped with one set of attributes.
+ * flags take the same MMU_MEMORY_* bits as arm_mmu_map_section; ranges
+ * that are not 1MB aligned are mapped with 4KB pages.
+ */
+struct mmu_region {
+	addr_t paddr;
+	addr_t vaddr;
+	size_t size;
+	uint flags;
+};
+
+int arm_mmu_map_regions(const struct mmu_region *regions, uint count);
 
 
 #if defined(__cplusplus)
@@ -21,9 +21,13 @@
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 #include <debug.h>
+#include <err.h>
+#include <string.h>
+#include <stdlib.h>
 #include <sys/types.h>
 #include <compiler.h>
 #include <arch.h>
+#include <arch/ops.h>
 #include <arch/arm.h>
 #include <arch/arm/mmu.h>
 
@@ -42,26 +46,168 @@ static uint32_t *tt = (void *)MMU_TRANSLATION_TABLE_ADDR;
 static uint32_t tt[4096] __ALIGNED(16384);
 #endif
 
-void arm_mmu_map_section(addr_t paddr, addr_t vaddr, uint flags)
-{
-	int index;
+/* second level (coarse) tables for regions that need 4KB granularity */
+#ifndef MMU_L2_TABLE_COUNT
+#define MMU_L2_TABLE_COUNT 8
+#endif
+static uint32_t l2_tables[MMU_L2_TABLE_COUNT][256] __ALIGNED(1024);
+static uint l2_tables_used;
 
-	/* Get the index into the translation table */
-	index = vaddr / MB;
+#define MMU_L1_TYPE_MASK	(0x3)
+#define MMU_L1_TYPE_COARSE	(0x1)
+#define MMU_L1_TYPE_SECTION	(0x2)
+#define MMU_L2_TYPE_SMALL	(0x2)
 
+static void arm_mmu_set_section(addr_t paddr, addr_t vaddr, uint flags)
+{
 	/* Set the entry value:
 	 * (2<<0): Section entry
 	 * (0<<5): Domain = 0
 	 *  flags: TEX, CB and AP bit settings provided by the caller.
 	 */
-	tt[index] = (paddr & ~(MB-1)) | (0<<5) | (2<<0) | flags;
+	tt[vaddr / MB] = (paddr & ~(MB-1)) | (0<<5) | (2<<0) | flags;
+}
+
+/* Move the section attribute bits to where a small page descriptor has them */
+static uint32_t arm_mmu_page_flags(uint flags)
+{
+	uint32_t page = flags & (0x3 << 2);	/* C, B */
+
+	page |= ((flags >> 12) & 0x7) << 6;	/* TEX */
+	page |= ((flags >> 10) & 0x3) << 4;	/* AP[1:0] */
+	page |= ((flags >> 15) & 0x1) << 9;	/* APX */
+	page |= ((flags >> 16) & 0x1) << 10;	/* S */
+	page |= ((flags >> 4) & 0x1);		/* XN */
+
+	return page;
+}
+
+/* Return the coarse table covering vaddr, splitting a section mapping
+ * into pages with the same attributes if needed.
+ */
+static uint32_t *arm_mmu_get_l2(addr_t vaddr)
+{
+	uint index = vaddr / MB;
+	uint32_t entry = tt[index];
+	uint32_t *l2;
+	uint i;
+
+	/* LK is identity mapped, so the table address is its own physical one */
+	if ((entry & MMU_L1_TYPE_MASK) == MMU_L1_TYPE_COARSE)
+		return (uint32_t *)(entry & ~0x3ff);
+
+	if (l2_tables_used == MMU_L2_TABLE_COUNT)
+		return NULL;
+	l2 = l2_tables[l2_tables_used++];
+
+	if ((entry & MMU_L1_TYPE_MASK) == MMU_L1_TYPE_SECTION) {
+		uint32_t flags = arm_mmu_page_flags(entry);
+
+		for (i = 0; i < 256; i++)
+			l2[i] = ((entry & ~(MB-1)) + i * PAGE_SIZE) | flags | MMU_L2_TYPE_SMALL;
+	} else {
+		memset(l2, 0, sizeof(l2_tables[0]));
+	}
+
+	tt[index] = (uint32_t)l2 | (0<<5) | MMU_L1_TYPE_COARSE;
+
+	return l2;
+}
+
+static int arm_mmu_set_page(addr_t paddr, addr_t vaddr, uint flags)
+{
+	uint32_t *l2 = arm_mmu_get_l2(vaddr);
+
+	if (!l2)
+		return ERR_NO_MEMORY;
+
+	l2[(vaddr % MB) / PAGE_SIZE] = (paddr & ~(PAGE_SIZE-1)) |
+		arm_mmu_page_flags(flags) | MMU_L2_TYPE_SMALL;
+
+	return NO_ERROR;
+}
+
+/* Make table updates visible to the table walker and drop stale entries */
+static void arm_mmu_sync(void)
+{
+	arch_clean_cache_range((addr_t)tt, 4096 * sizeof(uint32_t));
+	if (l2_tables_used)
+		arch_clean_cache_range((addr_t)l2_tables, l2_tables_used * sizeof(l2_tables[0]));
+
+	dsb();
+	arm_invalidate_tlb();
+	dsb();
+	isb();
+}
+
+void arm_mmu_map_section(addr_t paddr, addr_t vaddr, uint flags)
+{
+	arm_mmu_set_section(paddr, vaddr, flags);
 
 	arm_invalidate_tlb();
 }
 
+void arm_mmu_map_page(addr_t paddr, addr_t vaddr, uint flags)
+{
+	if (arm_mmu_set_page(paddr, vaddr, flags))
+		dprintf(CRITICAL, "mmu: out of page tables mapping 0x%x\n",
+			(unsigned)vaddr);
+
+	arm_mmu_sync();
+}
+
+/* Map a set of regions, using sections where alignment allows, and do
+ * the cache and TLB maintenance once for the whole batch.
+ */
+int arm_mmu_map_regions(const struct mmu_region *regions, uint count)
+{
+	int ret = NO_ERROR;
+	uint i;
+
+	for (i = 0; i < count && ret == NO_ERROR; i++) {
+		addr_t paddr = regions[i].paddr;
+		addr_t vaddr = regions[i].vaddr;
+		size_t size = ROUNDUP(regions[i].size, PAGE_SIZE);
+
+		while (size) {
+			if (((paddr | vaddr) & (MB-1)) == 0 && size >= MB) {
+				arm_mmu_set_section(paddr, vaddr, regions[i].flags);
+				paddr += MB;
+				vaddr += MB;
+				size -= MB;
+				continue;
+			}
+
+			ret = arm_mmu_set_page(paddr, vaddr, regions[i].flags);
+			if (ret) {
+				dprintf(CRITICAL,
+					"mmu: out of page tables mapping 0x%x\n",
+					(unsigned)vaddr);
+				break;
+			}
+			paddr += PAGE_SIZE;
+			vaddr += PAGE_SIZE;
+			size -= PAGE_SIZE;
+		}
+	}
+
+	arm_mmu_sync();
+
+	return ret;
+}
+
 uint32_t arm_mmu_virt2phy(uint32_t virt_addr)
 {
-	return (tt[virt_addr >> 20] & 0xfff00000) + (virt_addr & 0xfffff);
+	uint32_t entry = tt[virt_addr >> 20];
+
+	if ((entry & MMU_L1_TYPE_MASK) == MMU_L1_TYPE_COARSE) {
+		uint32_t *l2 = (uint32_t *)(entry & ~0x3ff);
+		uint32_t page = l2[(virt_addr % MB) / PAGE_SIZE];
+
+		return (page & ~(PAGE_SIZE-1)) + (virt_addr & (PAGE_SIZE-1));
+	}
+
+	return (entry & 0xfff00000) + (virt_addr & 0xfffff);
 }
 
 void arm_mmu_init(void)
@@ -77,12 +223,15 @@ void arm_mmu_init(void)
 	 * strongly ordered memory type and read/write access.
 	 */
 	for (i=0; i < 4096; i++) {
-		arm_mmu_map_section(i * MB,
+		arm_mmu_set_section(i * MB,
 				    i * MB,
 				    MMU_MEMORY_TYPE_STRONGLY_ORDERED |
 				    MMU_MEMORY_AP_READ_WRITE);
 	}
 
+	/* the mmu is off, one flush covers the whole table */
+	arm_invalidate_tlb();
+
 	/* set up the translation table base */
 	arm_write_ttbr((uint32_t)tt);
 
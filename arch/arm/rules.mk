@@ -96,7 +96,16 @@ OBJS += \
 	$(LOCAL_DIR)/faults.o \
 	$(LOCAL_DIR)/mmu.o \
 	$(LOCAL_DIR)/thread.o \
-	$(LOCAL_DIR)/dcc.o
+	$(LOCAL_DIR)/dcc.o \
+	$(LOCAL_DIR)/smp.o
+
+# bring up the second core as a job worker, set in the target's local.mk
+ENABLE_SMP ?= 0
+ifeq ($(ENABLE_SMP),1)
+DEFINES += WITH_SMP=1
+OBJS += \
+	$(LOCAL_DIR)/smp_entry.o
+endif
 
 # set the default toolchain to arm eabi and set a #define
 TOOLCHAIN_PREFIX ?= arm-eabi-
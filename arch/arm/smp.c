@@ -0,0 +1,447 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <debug.h>
+#include <err.h>
+#include <string.h>
+#include <stdlib.h>
+#include <smp.h>
+#include <platform.h>
+#include <arch/ops.h>
+#include <arch/arm.h>
+#include <arch/arm/mmu.h>
+
+#if WITH_SMP
+
+#if !ARM_WITH_MMU
+#error the smp job queue needs the mmu to map its shared page uncached
+#endif
+
+/*
+ * The queue lives in one page mapped strongly ordered on both cores, so
+ * the indices and job slots never need cache maintenance.  CPU0 is the
+ * only writer of head, the secondary the only writer of done.
+ */
+#define SMP_JOB_SLOTS		8
+#define SMP_STACK_SIZE		4096
+#define SMP_ONLINE_TIMEOUT	100	/* ms */
+#define SMP_PARK_TIMEOUT	100	/* ms */
+#define SMP_PIPES		2
+
+struct smp_job {
+	smp_job_func func;
+	const void *in;
+	size_t in_len;
+	void *out;
+	size_t out_len;
+	uint32_t args[SMP_JOB_ARGS_SIZE / sizeof(uint32_t)];
+};
+
+struct smp_pipe {
+	volatile uint32_t put;
+	volatile uint32_t get;
+	volatile uint32_t len[2];
+	unsigned char *buf[2];
+	size_t size;
+	bool in_use;
+};
+
+struct smp_queue {
+	volatile uint32_t head;
+	volatile uint32_t done;
+	volatile uint32_t online;
+	volatile uint32_t park;
+	volatile uint32_t parked;
+	struct smp_job jobs[SMP_JOB_SLOTS];
+	struct smp_pipe pipes[SMP_PIPES];
+};
+
+/* read by arm_secondary_entry with the mmu and caches off */
+uint32_t smp_boot_ttbr;
+addr_t smp_boot_stack;
+
+static struct smp_queue *queue;
+static bool secondary_online;
+
+/* CPU0 side record of results still to be invalidated, per slot */
+static struct {
+	uint32_t ticket;
+	void *out;
+	size_t out_len;
+	bool pending;
+} results[SMP_JOB_SLOTS];
+
+extern int _start;
+extern int _end;
+
+void arm_secondary_entry(void);
+void arm_secondary_park(volatile uint32_t *parked);
+void arm_secondary_main(void) __NO_RETURN;
+void arm_sev(void);
+void arm_wfe(void);
+
+/* runs on the secondary core with its own stack and the shared table */
+void arm_secondary_main(void)
+{
+	struct smp_job *job;
+	uint32_t args[SMP_JOB_ARGS_SIZE / sizeof(uint32_t)];
+	unsigned i;
+
+	queue->online = 1;
+	arm_sev();
+
+	for (;;) {
+		while (queue->done == queue->head) {
+			if (queue->park)
+				arm_secondary_park(&queue->parked);
+			arm_wfe();
+		}
+
+		job = &queue->jobs[queue->done % SMP_JOB_SLOTS];
+
+		/* copy the arguments out of the strongly ordered slot so the
+		 * job can take unaligned or byte sized accesses to them.
+		 */
+		for (i = 0; i < countof(args); i++)
+			args[i] = job->args[i];
+
+		if (job->in_len)
+			arch_invalidate_cache_range((addr_t) job->in, job->in_len);
+
+		job->func(args);
+
+		/* drop the lines too: a later job reusing this buffer must
+		 * not merge its writes into data CPU0 has replaced since.
+		 */
+		if (job->out_len)
+			arch_clean_invalidate_cache_range((addr_t) job->out,
+							  job->out_len);
+
+		queue->done++;
+		arm_sev();
+	}
+}
+
+static void smp_result_sync(unsigned slot)
+{
+	if (results[slot].pending) {
+		arch_invalidate_cache_range((addr_t) results[slot].out,
+					    results[slot].out_len);
+		results[slot].pending = false;
+	}
+}
+
+status_t smp_init(void)
+{
+	status_t ret;
+	void *stack;
+	time_t start;
+
+	queue = memalign(PAGE_SIZE, PAGE_SIZE);
+	stack = memalign(8, SMP_STACK_SIZE);
+	if (!queue || !stack)
+		return ERR_NO_MEMORY;
+
+	memset(queue, 0, PAGE_SIZE);
+	arch_clean_invalidate_cache_range((addr_t) queue, PAGE_SIZE);
+	arm_mmu_map_page(arm_mmu_virt2phy((uint32_t) queue), (addr_t) queue,
+			 MMU_MEMORY_TYPE_STRONGLY_ORDERED |
+			 MMU_MEMORY_AP_READ_WRITE | MMU_MEMORY_XN);
+
+	/* the stack is only ever touched by the secondary from now on */
+	arch_clean_invalidate_cache_range((addr_t) stack, SMP_STACK_SIZE);
+	smp_boot_stack = (addr_t) stack + SMP_STACK_SIZE;
+	smp_boot_ttbr = arm_read_ttbr();
+
+	/* the secondary fetches code, rodata, the translation table and the
+	 * boot variables above from memory, push all of it out.
+	 */
+	arch_clean_cache_range((addr_t) &_start,
+			       (addr_t) &_end - (addr_t) &_start);
+
+	ret = platform_cpu_start(1, (addr_t) arm_secondary_entry);
+	if (ret != NO_ERROR) {
+		dprintf(INFO, "smp: no secondary core (%d), running jobs inline\n",
+			ret);
+		return ret;
+	}
+
+	start = current_time();
+	while (!queue->online) {
+		if (current_time() - start > SMP_ONLINE_TIMEOUT) {
+			dprintf(CRITICAL, "smp: secondary core did not come up\n");
+			return ERR_TIMED_OUT;
+		}
+	}
+
+	secondary_online = true;
+	dprintf(INFO, "smp: secondary core online\n");
+
+	return NO_ERROR;
+}
+
+bool smp_secondary_online(void)
+{
+	return secondary_online;
+}
+
+int smp_job_post(smp_job_func func, const void *args, size_t args_len,
+		 const void *in, size_t in_len, void *out, size_t out_len)
+{
+	uint32_t buf[SMP_JOB_ARGS_SIZE / sizeof(uint32_t)];
+	struct smp_job *job;
+	uint32_t ticket;
+	unsigned slot;
+	unsigned i;
+
+	ASSERT(args_len <= SMP_JOB_ARGS_SIZE);
+	/* the result is invalidated on completion, so it must not share a
+	 * cache line with anything CPU0 writes meanwhile */
+	ASSERT((((addr_t) out | out_len) & (CACHE_LINE - 1)) == 0);
+
+	if (!secondary_online) {
+		memset(buf, 0, sizeof(buf));
+		memcpy(buf, args, args_len);
+		func(buf);
+		return -1;
+	}
+
+	/* wait for a free slot */
+	while (queue->head - queue->done >= SMP_JOB_SLOTS)
+		arm_wfe();
+
+	if (in_len)
+		arch_clean_cache_range((addr_t) in, in_len);
+	/* no dirty line of ours may be evicted on top of the result */
+	if (out_len)
+		arch_clean_invalidate_cache_range((addr_t) out, out_len);
+
+	memset(buf, 0, sizeof(buf));
+	memcpy(buf, args, args_len);
+
+	ticket = queue->head;
+	slot = ticket % SMP_JOB_SLOTS;
+	job = &queue->jobs[slot];
+
+	/* the previous job in this slot has finished but nobody waited */
+	smp_result_sync(slot);
+	results[slot].ticket = ticket;
+	results[slot].out = out;
+	results[slot].out_len = out_len;
+	results[slot].pending = (out_len != 0);
+	job->func = func;
+	job->in = in;
+	job->in_len = in_len;
+	job->out = out;
+	job->out_len = out_len;
+	for (i = 0; i < countof(buf); i++)
+		job->args[i] = buf[i];
+
+	queue->head = ticket + 1;
+	arm_sev();
+
+	return ticket;
+}
+
+void smp_job_wait(int ticket)
+{
+	unsigned slot;
+
+	/* inline jobs are complete by the time smp_job_post returns */
+	if (ticket < 0)
+		return;
+
+	while ((int)(queue->done - (uint32_t) ticket) <= 0)
+		arm_wfe();
+
+	slot = ticket % SMP_JOB_SLOTS;
+	if (results[slot].ticket == (uint32_t) ticket)
+		smp_result_sync(slot);
+}
+
+struct smp_pipe *smp_pipe_create(void *buf, size_t size)
+{
+	struct smp_pipe *pipe;
+	unsigned i;
+
+	if (!secondary_online)
+		return NULL;
+
+	for (i = 0; i < SMP_PIPES; i++) {
+		pipe = &queue->pipes[i];
+		if (pipe->in_use)
+			continue;
+
+		pipe->in_use = true;
+		pipe->put = 0;
+		pipe->get = 0;
+		pipe->size = size / 2;
+		pipe->buf[0] = buf;
+		pipe->buf[1] = (unsigned char *) buf + pipe->size;
+		return pipe;
+	}
+
+	return NULL;
+}
+
+void smp_pipe_destroy(struct smp_pipe *pipe)
+{
+	pipe->in_use = false;
+}
+
+void *smp_pipe_get(struct smp_pipe *pipe, size_t *size)
+{
+	while (pipe->put - pipe->get >= 2)
+		arm_wfe();
+
+	*size = pipe->size;
+	return pipe->buf[pipe->put % 2];
+}
+
+void smp_pipe_put(struct smp_pipe *pipe, size_t len)
+{
+	unsigned n = pipe->put % 2;
+
+	if (len)
+		arch_clean_cache_range((addr_t) pipe->buf[n], len);
+	pipe->len[n] = len;
+	pipe->put++;
+	arm_sev();
+}
+
+const void *smp_pipe_read(struct smp_pipe *pipe, size_t *len)
+{
+	unsigned n;
+
+	while (pipe->get == pipe->put)
+		arm_wfe();
+
+	n = pipe->get % 2;
+	*len = pipe->len[n];
+	if (*len)
+		arch_invalidate_cache_range((addr_t) pipe->buf[n], *len);
+
+	return pipe->buf[n];
+}
+
+void smp_pipe_release(struct smp_pipe *pipe)
+{
+	pipe->get++;
+	arm_sev();
+}
+
+void smp_park(void)
+{
+	time_t start;
+
+	if (!secondary_online)
+		return;
+
+	queue->park = 1;
+	arm_sev();
+
+	/* a wedged secondary is put back into reset all the same */
+	start = current_time();
+	while (!queue->parked) {
+		if (current_time() - start > SMP_PARK_TIMEOUT) {
+			dprintf(CRITICAL, "smp: secondary core did not park\n");
+			break;
+		}
+	}
+
+	platform_cpu_park(1);
+	secondary_online = false;
+}
+
+#else
+
+status_t smp_init(void)
+{
+	return ERR_NOT_SUPPORTED;
+}
+
+bool smp_secondary_online(void)
+{
+	return false;
+}
+
+int smp_job_post(smp_job_func func, const void *args, size_t args_len,
+		 const void *in, size_t in_len, void *out, size_t out_len)
+{
+	uint32_t buf[SMP_JOB_ARGS_SIZE / sizeof(uint32_t)];
+
+	ASSERT(args_len <= SMP_JOB_ARGS_SIZE);
+	/* the result is invalidated on completion, so it must not share a
+	 * cache line with anything CPU0 writes meanwhile */
+	ASSERT((((addr_t) out | out_len) & (CACHE_LINE - 1)) == 0);
+
+	memset(buf, 0, sizeof(buf));
+	memcpy(buf, args, args_len);
+	func(buf);
+
+	return -1;
+}
+
+void smp_job_wait(int ticket)
+{
+}
+
+struct smp_pipe *smp_pipe_create(void *buf, size_t size)
+{
+	return NULL;
+}
+
+void smp_pipe_destroy(struct smp_pipe *pipe)
+{
+}
+
+void *smp_pipe_get(struct smp_pipe *pipe, size_t *size)
+{
+	return NULL;
+}
+
+void smp_pipe_put(struct smp_pipe *pipe, size_t len)
+{
+}
+
+const void *smp_pipe_read(struct smp_pipe *pipe, size_t *len)
+{
+	*len = 0;
+	return NULL;
+}
+
+void smp_pipe_release(struct smp_pipe *pipe)
+{
+}
+
+void smp_park(void)
+{
+}
+
+#endif
@@ -89,38 +89,92 @@ static void fbcon_drawglyph(uint16_t *pixels, uint16_t paint, unsigned stride,
 	}
 }
 
+/* Lines [dirty_top, dirty_bottom) have changed since the last flush */
+static unsigned			dirty_top;
+static unsigned			dirty_bottom;
+
+static void fbcon_mark_dirty(unsigned y, unsigned height)
+{
+	if (dirty_top >= dirty_bottom) {
+		dirty_top = y;
+		dirty_bottom = y + height;
+		return;
+	}
+
+	if (y < dirty_top)
+		dirty_top = y;
+	if (y + height > dirty_bottom)
+		dirty_bottom = y + height;
+}
+
 static void fbcon_flush(void)
 {
-	if (config->update_start)
+	if (dirty_top >= dirty_bottom)
+		return;
+
+	if (dirty_bottom > config->height)
+		dirty_bottom = config->height;
+
+	if (config->update_region)
+		config->update_region(dirty_top, dirty_bottom - dirty_top);
+	else if (config->update_start)
 		config->update_start();
 	if (config->update_done)
 		while (!config->update_done());
+
+	dirty_top = dirty_bottom = 0;
 }
 
-/* TODO: Take stride into account */
-static void fbcon_scroll_up(void)
+/* Fill count lines starting at line y with the background color */
+static void fbcon_fill_lines(unsigned y, unsigned count)
 {
-	unsigned short *dst = config->base;
-	unsigned short *src = dst + (config->width * FONT_HEIGHT);
-	unsigned count = config->width * (config->height - FONT_HEIGHT);
+	unsigned bytes_per_pixel = config->bpp / 8;
+	unsigned line_bytes = config->stride * bytes_per_pixel;
+	unsigned row_bytes = config->width * bytes_per_pixel;
+	unsigned char *dst = (unsigned char *)config->base + y * line_bytes;
+
+	if (line_bytes == row_bytes) {
+		memset(dst, BGCOLOR, count * row_bytes);
+		return;
+	}
 
-	while(count--) {
-		*dst++ = *src++;
+	while (count--) {
+		memset(dst, BGCOLOR, row_bytes);
+		dst += line_bytes;
 	}
+}
 
-	count = config->width * FONT_HEIGHT;
-	while(count--) {
-		*dst++ = BGCOLOR;
+static void fbcon_scroll_up(void)
+{
+	unsigned bytes_per_pixel = config->bpp / 8;
+	unsigned line_bytes = config->stride * bytes_per_pixel;
+	unsigned row_bytes = config->width * bytes_per_pixel;
+	unsigned count = config->height - FONT_HEIGHT;
+	unsigned char *dst = config->base;
+	unsigned char *src = dst + (line_bytes * FONT_HEIGHT);
+
+	if (line_bytes == row_bytes) {
+		/* no padding between lines, move the whole text area at once */
+		memmove(dst, src, count * row_bytes);
+	} else {
+		/* rows are FONT_HEIGHT lines apart, so they never overlap */
+		while (count--) {
+			memcpy(dst, src, row_bytes);
+			dst += line_bytes;
+			src += line_bytes;
+		}
 	}
 
+	fbcon_fill_lines(config->height - FONT_HEIGHT, FONT_HEIGHT);
+
+	fbcon_mark_dirty(0, config->height);
 	fbcon_flush();
 }
 
-/* TODO: take stride into account */
 void fbcon_clear(void)
 {
-	unsigned count = config->width * config->height;
-	memset(config->base, BGCOLOR, count * ((config->bpp) / 8));
+	fbcon_fill_lines(0, config->height);
+	fbcon_mark_dirty(0, config->height);
 }
 
 
@@ -149,10 +203,11 @@ void fbcon_putc(char c)
 	}
 
 	pixels = config->base;
-	pixels += cur_pos.y * FONT_HEIGHT * config->width;
+	pixels += cur_pos.y * FONT_HEIGHT * config->stride;
 	pixels += cur_pos.x * (FONT_WIDTH + 1);
 	fbcon_drawglyph(pixels, FGCOLOR, config->stride,
 			font5x12 + (c - 32) * 2);
+	fbcon_mark_dirty(cur_pos.y * FONT_HEIGHT, FONT_HEIGHT);
 
 	cur_pos.x++;
 	if (cur_pos.x < max_pos.x)
@@ -196,6 +251,7 @@ void fbcon_setup(struct fbcon_config *_config)
 
 	cur_pos.x = 0;
 	cur_pos.y = 0;
+	dirty_top = dirty_bottom = 0;
 	max_pos.x = config->width / (FONT_WIDTH+1);
 	max_pos.y = (config->height - 1) / FONT_HEIGHT;
 #if !DISPLAY_SPLASH_SCREEN
@@ -246,6 +302,7 @@ void display_image_on_screen(void)
 		    SPLASH_IMAGE_HEIGHT_HDPI * bytes_per_bpp);
 	}
     }
+    fbcon_mark_dirty(0, config->height);
     fbcon_flush();
 #if DISPLAY_MIPI_PANEL_NOVATEK_BLUE
     if(is_cmd_mode_enabled())
@@ -266,6 +323,7 @@ void display_image_on_screen(void)
 		    SPLASH_IMAGE_HEIGHT_MDPI * bytes_per_bpp);
 	}
     }
+    fbcon_mark_dirty(0, config->height);
     fbcon_flush();
 #endif
 }
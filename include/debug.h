@@ -48,6 +48,76 @@ extern "C" {
 #define INFO 1
 #define SPEW 2
 
+/* debug modules
+ *
+ * A source file selects its module by defining DEBUG_MODULE before any
+ * include.  Each module has a compile time level, DEBUGLEVEL_<module>, that
+ * can be lowered from the project DEFINES so its messages are not built in
+ * at all, and a runtime level that can only filter further.
+ */
+#define DBG_CORE 0
+#define DBG_APP 1
+#define DBG_FASTBOOT 2
+#define DBG_MMC 3
+#define DBG_NAND 4
+#define DBG_USB 5
+#define DBG_DISPLAY 6
+#define DBG_MODULE_COUNT 7
+
+/* DEBUG from the project makefile sets the default for the modules */
+#ifndef DEBUGLEVEL_MODULES
+#define DEBUGLEVEL_MODULES DEBUGLEVEL
+#endif
+
+#ifndef DEBUGLEVEL_CORE
+#define DEBUGLEVEL_CORE DEBUGLEVEL
+#endif
+#ifndef DEBUGLEVEL_APP
+#define DEBUGLEVEL_APP DEBUGLEVEL_MODULES
+#endif
+#ifndef DEBUGLEVEL_FASTBOOT
+#define DEBUGLEVEL_FASTBOOT DEBUGLEVEL_MODULES
+#endif
+#ifndef DEBUGLEVEL_MMC
+#define DEBUGLEVEL_MMC DEBUGLEVEL_MODULES
+#endif
+#ifndef DEBUGLEVEL_NAND
+#define DEBUGLEVEL_NAND DEBUGLEVEL_MODULES
+#endif
+#ifndef DEBUGLEVEL_USB
+#define DEBUGLEVEL_USB DEBUGLEVEL_MODULES
+#endif
+#ifndef DEBUGLEVEL_DISPLAY
+#define DEBUGLEVEL_DISPLAY DEBUGLEVEL_MODULES
+#endif
+
+#ifndef DEBUG_MODULE
+#define DEBUG_MODULE DBG_CORE
+#endif
+
+#if DEBUG_MODULE == DBG_APP
+#define MODULE_DEBUGLEVEL DEBUGLEVEL_APP
+#elif DEBUG_MODULE == DBG_FASTBOOT
+#define MODULE_DEBUGLEVEL DEBUGLEVEL_FASTBOOT
+#elif DEBUG_MODULE == DBG_MMC
+#define MODULE_DEBUGLEVEL DEBUGLEVEL_MMC
+#elif DEBUG_MODULE == DBG_NAND
+#define MODULE_DEBUGLEVEL DEBUGLEVEL_NAND
+#elif DEBUG_MODULE == DBG_USB
+#define MODULE_DEBUGLEVEL DEBUGLEVEL_USB
+#elif DEBUG_MODULE == DBG_DISPLAY
+#define MODULE_DEBUGLEVEL DEBUGLEVEL_DISPLAY
+#else
+#define MODULE_DEBUGLEVEL DEBUGLEVEL_CORE
+#endif
+
+/* runtime levels, indexed by DBG_* */
+extern int debug_module_level[DBG_MODULE_COUNT];
+extern const char *debug_module_name[DBG_MODULE_COUNT];
+
+#define DEBUG_ENABLED(level) \
+	((level) <= MODULE_DEBUGLEVEL && (level) <= debug_module_level[DEBUG_MODULE])
+
 #define PRINT_BUFF_SIZE (64 * 1024)
 /* output */
 void _dputc(char c); // XXX for now, platform implements
@@ -55,10 +125,27 @@ int _dputs(const char *str);
 int _dprintf(const char *fmt, ...) __PRINTFLIKE(1, 2);
 int _dvprintf(const char *fmt, va_list ap);
 
-#define dputc(level, str) do { if ((level) <= DEBUGLEVEL) { _dputc(str); } } while (0)
-#define dputs(level, str) do { if ((level) <= DEBUGLEVEL) { _dputs(str); } } while (0)
-#define dprintf(level, x...) do { if ((level) <= DEBUGLEVEL) { _dprintf(x); } } while (0)
-#define dvprintf(level, x...) do { if ((level) <= DEBUGLEVEL) { _dvprintf(x); } } while (0)
+#define dputc(level, str) do { if (DEBUG_ENABLED(level)) { _dputc(str); } } while (0)
+#define dputs(level, str) do { if (DEBUG_ENABLED(level)) { _dputs(str); } } while (0)
+#define dprintf(level, x...) do { if (DEBUG_ENABLED(level)) { _dprintf(x); } } while (0)
+#define dvprintf(level, x...) do { if (DEBUG_ENABLED(level)) { _dvprintf(x); } } while (0)
+
+/* deferred output
+ *
+ * dlog() stores the format pointer, a timestamp and the raw arguments in a
+ * ring; the text is only produced when the ring is drained by the dlog
+ * thread, the "dlog" console command, boot_linux() or a panic.  The dlog
+ * thread wakes when a record lands in an empty ring.  The format must be a
+ * literal, %s arguments must outlive the record and at most DLOG_MAX_ARGS
+ * 32 bit arguments are kept (no 64 bit or floating point conversions).
+ */
+#define DLOG_MAX_ARGS 6
+
+void _dlog(const char *fmt, ...) __PRINTFLIKE(1, 2);
+void dlog_flush(void);
+void dlog_init(void);
+
+#define dlog(level, x...) do { if (DEBUG_ENABLED(level)) { _dlog(x); } } while (0)
 
 /* input */
 int dgetc(char *c, bool wait);
@@ -44,6 +44,8 @@ struct fbcon_config {
 
 	void		(*update_start)(void);
 	int		(*update_done)(void);
+	/* optional: push only lines [y, y + height) to a command mode panel */
+	void		(*update_region)(unsigned y, unsigned height);
 };
 
 void fbcon_setup(struct fbcon_config *cfg);
@@ -56,6 +56,52 @@ int flash_read_ext(struct ptentry *ptn, unsigned extra_per_page,
 int flash_write(struct ptentry *ptn, unsigned extra_per_page, const void *data,
 		unsigned bytes);
 
+/* flash_write_ext() flags */
+#define FLASH_WRITE_SKIP_ERASED	(1 << 0)	/* don't program all-0xff pages */
+
+/* tail_blocks value that erases the rest of the partition */
+#define FLASH_ERASE_TAIL_ALL	(~0U)
+
+struct flash_write_stats {
+	unsigned erased_blocks;
+	unsigned erase_us;
+	unsigned programmed_pages;
+	unsigned skipped_pages;
+	unsigned program_us;
+};
+
+/* Like flash_write(), but only erases the blocks the image covers plus
+ * tail_blocks blocks after it. */
+int flash_write_ext(struct ptentry *ptn, unsigned extra_per_page,
+		    const void *data, unsigned bytes, unsigned tail_blocks,
+		    unsigned flags, struct flash_write_stats *stats);
+
+/* Write npages pages of plain data followed by a stream of tag_size OOB
+ * bytes per page, which are laid out in the spare area here. */
+int flash_write_tags(struct ptentry *ptn, const void *pages, const void *tags,
+		     unsigned tag_size, unsigned npages, unsigned tail_blocks,
+		     unsigned flags, struct flash_write_stats *stats);
+/* OOB bytes per page that survive in the spare area */
+unsigned flash_tag_size(void);
+
+struct flash_ecc_stats {
+	unsigned corrected;	/* bitflips corrected by ECC reads */
+	unsigned max_cw;	/* most bitflips in one codeword */
+	unsigned uncorrectable;	/* codewords ECC could not correct */
+};
+
+/* Bits the ECC engine corrects per codeword */
+unsigned flash_ecc_strength(void);
+#ifndef NAND_SCRUB_THRESHOLD
+/* bitflips per codeword at which a NAND block is rewritten */
+#define NAND_SCRUB_THRESHOLD	(flash_ecc_strength() * 3 / 4)
+#endif
+int flash_ecc_get_stats(unsigned block, struct flash_ecc_stats *stats);
+/* Rewrite the blocks of ptn that had max_cw >= threshold bitflips
+ * corrected; blocks that do not read back cleanly are skipped. Returns
+ * the number of blocks rewritten, or -1 if a rewrite failed. */
+int flash_scrub(struct ptentry *ptn, unsigned threshold);
+
 static inline int flash_read(struct ptentry *ptn, unsigned offset, void *data,
 			     unsigned bytes)
 {
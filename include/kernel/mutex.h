@@ -32,11 +32,25 @@ typedef struct mutex {
 	int count;
 	thread_t *holder;
 	wait_queue_t wait;
+
+#if THREAD_STATS
+	/* contention statistics */
+	struct list_node node;
+	uint32_t acquires;
+	uint32_t contended;
+	bigtime_t hold_start;
+	bigtime_t max_hold_time;	/* us */
+#endif
 } mutex_t;
 
 /* Rules for Mutexes:
  * - Mutexes are only safe to use from thread context.
  * - Mutexes are non-recursive.
+ * - A thread that blocks on a mutex lends its priority to the holder until
+ *   the holder releases it. Only the direct holder is boosted, and the
+ *   release drops the holder back to its base priority.
+ * - With THREAD_STATS, a mutex must be destroyed before its memory is
+ *   reused, since it is kept on the list mutex_dump_stats() walks.
 */
 
 void mutex_init(mutex_t *);
@@ -45,5 +59,9 @@ status_t mutex_acquire(mutex_t *);
 status_t mutex_acquire_timeout(mutex_t *, time_t); /* try to acquire the mutex with a timeout value */
 status_t mutex_release(mutex_t *);
 
+#if THREAD_STATS
+void mutex_dump_stats(void);
+#endif
+
 #endif
 
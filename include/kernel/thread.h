@@ -28,6 +28,14 @@
 #include <compiler.h>
 #include <arch/ops.h>
 #include <arch/thread.h>
+#include <debug.h>
+
+/* thread level statistics */
+#if DEBUGLEVEL > 1
+#define THREAD_STATS 1
+#else
+#define THREAD_STATS 0
+#endif
 
 enum thread_state {
 	THREAD_SUSPENDED = 0,
@@ -54,6 +62,7 @@ typedef struct thread {
 	/* active bits */
 	struct list_node queue_node;
 	int priority;
+	int base_priority;	/* priority without any inherited boost */
 	enum thread_state state;	
 	int saved_critical_section_count;
 	int remaining_quantum;
@@ -62,6 +71,10 @@ typedef struct thread {
 	struct wait_queue *blocking_wait_queue;
 	status_t wait_queue_block_ret;
 
+	/* if blocked with a timeout, when to give up */
+	struct list_node deadline_node;
+	time_t wait_deadline;
+
 	/* architecture stuff */
 	struct arch_thread arch;
 
@@ -79,6 +92,15 @@ typedef struct thread {
 	/* thread local storage */
 	uint32_t tls[MAX_TLS_ENTRY];
 
+#if THREAD_STATS
+	/* accounting, times are in microseconds */
+	bigtime_t run_time;		/* total time spent running */
+	bigtime_t ready_time;		/* total time runnable but not running */
+	bigtime_t max_ready_latency;	/* longest single wait in the run queue */
+	bigtime_t last_timestamp;	/* when it last started running or became ready */
+	uint32_t switch_count;		/* times it was switched in */
+#endif
+
 	char name[32];
 } thread_t;
 
@@ -95,12 +117,17 @@ typedef struct thread {
 /* stack size */
 #define DEFAULT_STACK_SIZE 8192
 
+/* new stacks are filled with this to find the high-water mark */
+#define THREAD_STACK_PAINT 0x99999999
+
 /* functions */
 void thread_init_early(void);
 void thread_init(void);
 void thread_become_idle(void) __NO_RETURN;
 void thread_set_name(const char *name);
 void thread_set_priority(int priority);
+void thread_boost_priority(thread_t *t, int priority);
+void thread_restore_priority(void);
 thread_t *thread_create(const char *name, thread_start_routine entry, void *arg, int priority, size_t stack_size);
 status_t thread_resume(thread_t *);
 void thread_exit(int retcode) __NO_RETURN;
@@ -204,12 +231,6 @@ int wait_queue_wake_all(wait_queue_t *, bool reschedule, status_t wait_queue_err
  */
 status_t thread_unblock_from_wait_queue(thread_t *t, bool reschedule, status_t wait_queue_error);
 
-/* thread level statistics */
-#if DEBUGLEVEL > 1
-#define THREAD_STATS 1
-#else
-#define THREAD_STATS 0
-#endif
 #if THREAD_STATS
 struct thread_stats {
 	bigtime_t idle_time;
@@ -225,6 +246,21 @@ struct thread_stats {
 
 extern struct thread_stats thread_stats;
 
+/* per-thread accounting copied out of the thread list */
+struct thread_stats_entry {
+	char name[32];
+	int priority;
+	enum thread_state state;
+	bigtime_t run_time;
+	bigtime_t ready_time;
+	bigtime_t max_ready_latency;
+	uint32_t switch_count;
+	size_t stack_size;	/* 0 if the stack is not known */
+	size_t stack_used;
+};
+
+int thread_stats_snapshot(struct thread_stats_entry *entries, int count);
+
 #endif
 
 #endif
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LIB_DECOMPRESS_H
+#define __LIB_DECOMPRESS_H
+
+#include <sys/types.h>
+
+enum {
+	DECOMPRESS_NONE = 0,
+	DECOMPRESS_GZIP,
+	DECOMPRESS_LZ4,		/* lz4 frame format */
+	DECOMPRESS_LZ4_LEGACY,	/* lz4 legacy format, as used for Image.lz4 */
+};
+
+/*
+ * Input is pulled through next_in/end_in.  When they meet, fill() is
+ * called to point them at the next chunk; it returns the number of bytes
+ * made available, 0 at the end of the input or < 0 on error.  A NULL
+ * fill means everything is already in memory.  Output goes to a flat
+ * buffer, so back references are resolved straight out of it and no
+ * window copy is needed.
+ *
+ * gzip needs DECOMPRESS_WORKSPACE_SIZE bytes of state; it comes from the
+ * heap unless the caller passes a workspace, which it must when the
+ * decoder runs somewhere the heap cannot be used (the second core).
+ */
+#define DECOMPRESS_WORKSPACE_SIZE	4096
+
+struct decompress_stream {
+	const unsigned char *next_in;
+	const unsigned char *end_in;
+	int (*fill)(struct decompress_stream *s);
+	void *fill_arg;
+
+	unsigned char *out;
+	size_t out_max;
+	size_t out_len;
+
+	void *workspace;
+};
+
+/* returns one of the DECOMPRESS_ types from the first bytes of a payload */
+int decompress_detect(const void *buf, size_t len);
+const char *decompress_name(int type);
+
+/* returns NO_ERROR, ERR_TOO_BIG if out_max is exceeded or ERR_NOT_VALID */
+int decompress(int type, struct decompress_stream *s);
+
+int gunzip(struct decompress_stream *s);
+int unlz4(struct decompress_stream *s, bool legacy);
+
+/* input helpers for the decoders */
+static inline int decompress_getc(struct decompress_stream *s)
+{
+	if (s->next_in == s->end_in && (!s->fill || s->fill(s) <= 0))
+		return -1;
+	return *s->next_in++;
+}
+
+int decompress_read(struct decompress_stream *s, void *buf, size_t len);
+
+#endif
@@ -10,6 +10,7 @@ typedef enum {
 	GFX_FORMAT_RGB_565,
 	GFX_FORMAT_ARGB_8888,
 	GFX_FORMAT_RGB_x888,
+	GFX_FORMAT_RGB_888,	// packed 24 bit, B G R byte order
 
 	GFX_FORMAT_MAX
 } gfx_format;
@@ -64,6 +65,24 @@ static inline void gfx_clear(gfx_surface *surface, uint color)
 // blend between two surfaces
 void gfx_surface_blend(struct gfx_surface *target, struct gfx_surface *source, uint destx, uint desty);
 
+// bytes per pixel of a format
+static inline uint gfx_format_pixelsize(gfx_format format)
+{
+	switch (format) {
+		case GFX_FORMAT_RGB_565:
+			return 2;
+		case GFX_FORMAT_RGB_888:
+			return 3;
+		default:
+			return 4;
+	}
+}
+
+// row kernels, count is in pixels and colors are ARGB 8888
+void gfx_convert_row(void *dest, gfx_format dest_format, const void *src, gfx_format src_format, uint count);
+void gfx_blend_row(void *dest, gfx_format dest_format, const uint32_t *src, uint count);
+void gfx_fill_row(void *dest, gfx_format format, uint32_t color, uint count);
+
 void gfx_flush(struct gfx_surface *surface);
 
 void gfx_flush_rows(struct gfx_surface *surface, uint start, uint end);
@@ -82,5 +101,8 @@ void gfx_surface_destroy(struct gfx_surface *surface);
 // utility routine to fill the display with a little moire pattern
 void gfx_draw_pattern(void);
 
+// print the throughput of the drawing routines
+int gfx_bench(void);
+
 #endif
 
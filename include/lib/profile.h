@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __LIB_PROFILE_H
+#define __LIB_PROFILE_H
+
+#include <sys/types.h>
+
+#define PROFILE_MAX_SAMPLES	2048
+#define PROFILE_MAX_THREADS	16
+#define PROFILE_DEFAULT_PERIOD	10	/* ms, one timer tick */
+
+struct profile_sample {
+	addr_t pc;
+	uint8_t thread;		/* index into the profile thread table */
+};
+
+/* PC the current interrupt was taken at, stored by platform_irq */
+extern volatile addr_t profile_irq_pc;
+
+int profile_start(time_t period);
+void profile_stop(void);
+bool profile_running(void);
+
+/* raw access for exporting the samples */
+unsigned profile_sample_count(void);
+const struct profile_sample *profile_get_samples(void);
+const char *profile_thread_name(unsigned index);
+
+/* print a histogram of the hottest PCs and the per-thread split */
+void profile_dump(unsigned top);
+
+#endif
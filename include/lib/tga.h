@@ -5,6 +5,7 @@
 #include <sys/types.h>
 
 gfx_surface *tga_decode(const void *ptr, size_t len, gfx_format format);
+int tga_decode_to_surface(const void *ptr, size_t len, gfx_surface *surface, uint x, uint y);
 
 #endif
 
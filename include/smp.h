@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __SMP_H
+#define __SMP_H
+
+#include <sys/types.h>
+
+/*
+ * SMP-lite: the second core runs a worker loop that takes jobs from a
+ * single producer queue filled by CPU0.  The caches of the two cores are
+ * not assumed to be coherent, so a job may only read the input range and
+ * write the output range it was posted with (plus read-only data); the
+ * queue does the cache maintenance on both sides.  Without a secondary
+ * core, smp_job_post() runs the job in place and the API behaves the same.
+ */
+
+#define SMP_JOB_ARGS_SIZE	32
+
+typedef void (*smp_job_func)(void *args);
+
+/* bring the second core up, returns NO_ERROR or ERR_NOT_SUPPORTED */
+status_t smp_init(void);
+bool smp_secondary_online(void);
+
+/* queue func(args) on the second core; args are copied (at most
+ * SMP_JOB_ARGS_SIZE bytes).  out and out_len must be CACHE_LINE
+ * aligned.  Returns a ticket for smp_job_wait(). */
+int smp_job_post(smp_job_func func, const void *args, size_t args_len,
+		 const void *in, size_t in_len, void *out, size_t out_len);
+void smp_job_wait(int ticket);
+
+/*
+ * A pipe hands a stream of buffers from CPU0 to a job running on the
+ * second core, for jobs that consume input as it is being read instead
+ * of one range up front.  buf is split in two halves so CPU0 can fill
+ * one while the job works on the other.  Only available while the
+ * second core is online; smp_pipe_create() returns NULL otherwise.
+ */
+struct smp_pipe;
+
+struct smp_pipe *smp_pipe_create(void *buf, size_t size);
+void smp_pipe_destroy(struct smp_pipe *pipe);
+
+/* CPU0 side: wait for a free half, then publish len bytes of it;
+ * publishing 0 bytes ends the stream */
+void *smp_pipe_get(struct smp_pipe *pipe, size_t *size);
+void smp_pipe_put(struct smp_pipe *pipe, size_t len);
+
+/* job side: wait for the next half, release it once consumed */
+const void *smp_pipe_read(struct smp_pipe *pipe, size_t *len);
+void smp_pipe_release(struct smp_pipe *pipe);
+
+/* stop the second core and hand it back to the platform, which returns
+ * it to the reset state the kernel expects to release it from */
+void smp_park(void);
+
+/* platform hooks; platform_cpu_park() is called once the core sits in
+ * WFI with mmu and caches off (or failed to get there in time) */
+status_t platform_cpu_start(unsigned cpu, addr_t entry);
+void platform_cpu_park(unsigned cpu);
+
+#endif
@@ -34,6 +34,7 @@
 #include <debug.h>
 #include <kernel/thread.h>
 #include <kernel/timer.h>
+#include <kernel/mutex.h>
 #include <platform.h>
 
 #if WITH_LIB_CONSOLE
@@ -42,6 +43,7 @@
 static int cmd_threads(int argc, const cmd_args *argv);
 static int cmd_threadstats(int argc, const cmd_args *argv);
 static int cmd_threadload(int argc, const cmd_args *argv);
+static int cmd_mutexstats(int argc, const cmd_args *argv);
 
 STATIC_COMMAND_START
 #if DEBUGLEVEL > 1
@@ -50,6 +52,7 @@ STATIC_COMMAND("threads", "list kernel threads", &cmd_threads)
 #if THREAD_STATS
 STATIC_COMMAND("threadstats", "thread level statistics", &cmd_threadstats)
 STATIC_COMMAND("threadload", "toggle thread load display", &cmd_threadload)
+STATIC_COMMAND("mutexstats", "mutex contention statistics", &cmd_mutexstats)
 #endif
 STATIC_COMMAND_END(kernel);
 
@@ -77,6 +80,23 @@ static int cmd_threadstats(int argc, const cmd_args *argv)
 	printf("\ttimer interrupts: %d\n", thread_stats.timer_ints);
 	printf("\ttimers: %d\n", thread_stats.timers);
 
+	struct thread_stats_entry entries[16];
+	int count = thread_stats_snapshot(entries, 16);
+	int i;
+
+	printf("\n%-16s pri state   run ms ready ms max lat us switches  stack used\n", "name");
+	for (i = 0; i < count; i++) {
+		struct thread_stats_entry *e = &entries[i];
+
+		printf("%-16.16s %3d %5d %8u %8u %10u %8u ", e->name, e->priority,
+		       e->state, (uint)(e->run_time / 1000), (uint)(e->ready_time / 1000),
+		       (uint)e->max_ready_latency, e->switch_count);
+		if (e->stack_size)
+			printf("%5u/%u\n", (uint)e->stack_used, (uint)e->stack_size);
+		else
+			printf("    n/a\n");
+	}
+
 	return 0;
 }
 
@@ -106,6 +126,13 @@ static enum handler_return threadload(struct timer *t, time_t now, void *arg)
 	return INT_NO_RESCHEDULE;
 }
 
+static int cmd_mutexstats(int argc, const cmd_args *argv)
+{
+	mutex_dump_stats();
+
+	return 0;
+}
+
 static int cmd_threadload(int argc, const cmd_args *argv)
 {
 	static bool showthreadload = false;
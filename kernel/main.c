@@ -33,6 +33,7 @@
 #include <kernel/thread.h>
 #include <kernel/timer.h>
 #include <kernel/dpc.h>
+#include <smp.h>
 
 extern void *__ctor_list;
 extern void *__ctor_end;
@@ -120,6 +121,9 @@ static int bootstrap2(void *arg)
 {
 	dprintf(SPEW, "top of bootstrap2()\n");
 
+	// start draining the deferred log
+	dlog_init();
+
 	arch_init();
 
 	// XXX put this somewhere else
@@ -138,6 +142,11 @@ static int bootstrap2(void *arg)
 	dprintf(SPEW, "initializing target\n");
 	target_init();
 
+#if WITH_SMP
+	// start the job worker on the second core
+	smp_init();
+#endif
+
 	dprintf(SPEW, "calling apps_init()\n");
 	apps_init();
 
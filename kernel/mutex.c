@@ -38,11 +38,22 @@
 #define MUTEX_CHECK 1
 #endif
 
+#if THREAD_STATS
+#include <platform.h>
+#include <printf.h>
+
+static struct list_node mutex_list = LIST_INITIAL_VALUE(mutex_list);
+#endif
+
 /**
  * @brief  Initialize a mutex_t
  */
 void mutex_init(mutex_t *m)
 {
+#if THREAD_STATS
+	/* a live mutex initialized again is already on mutex_list */
+	bool listed = m->magic == MUTEX_MAGIC && list_in_list(&m->node);
+#endif
 #if MUTEX_CHECK
 //	ASSERT(m->magic != MUTEX_MAGIC);
 #endif
@@ -51,6 +62,19 @@ void mutex_init(mutex_t *m)
 	m->count = 0;
 	m->holder = 0;
 	wait_queue_init(&m->wait);
+
+#if THREAD_STATS
+	m->acquires = 0;
+	m->contended = 0;
+	m->hold_start = 0;
+	m->max_hold_time = 0;
+
+	if (!listed) {
+		enter_critical_section();
+		list_add_tail(&mutex_list, &m->node);
+		exit_critical_section();
+	}
+#endif
 }
 
 /**
@@ -73,6 +97,9 @@ void mutex_destroy(mutex_t *m)
 
 	m->magic = 0;
 	m->count = 0;
+#if THREAD_STATS
+	list_delete(&m->node);
+#endif
 	wait_queue_destroy(&m->wait, true);
 	exit_critical_section();
 }
@@ -103,6 +130,13 @@ status_t mutex_acquire(mutex_t *m)
 
 	m->count++;
 	if (unlikely(m->count > 1)) {
+#if THREAD_STATS
+		m->contended++;
+#endif
+		/* don't let the holder be held up behind threads below us */
+		if (m->holder)
+			thread_boost_priority(m->holder, current_thread->priority);
+
 		/* 
 		 * block on the wait queue. If it returns an error, it was likely destroyed
 		 * out from underneath us, so make sure we dont scribble thread ownership 
@@ -113,6 +147,10 @@ status_t mutex_acquire(mutex_t *m)
 			goto err;
 	}
 	m->holder = current_thread;	
+#if THREAD_STATS
+	m->acquires++;
+	m->hold_start = current_time_hires();
+#endif
 
 err:
 	exit_critical_section();
@@ -151,6 +189,12 @@ status_t mutex_acquire_timeout(mutex_t *m, time_t timeout)
 
 	m->count++;
 	if (unlikely(m->count > 1)) {
+#if THREAD_STATS
+		m->contended++;
+#endif
+		if (m->holder && timeout != 0)
+			thread_boost_priority(m->holder, current_thread->priority);
+
 		ret = wait_queue_block(&m->wait, timeout);
 		if (ret < NO_ERROR) {
 			/* if the acquisition timed out, back out the acquire and exit */
@@ -169,6 +213,10 @@ status_t mutex_acquire_timeout(mutex_t *m, time_t timeout)
 		}	
 	}
 	m->holder = current_thread;	
+#if THREAD_STATS
+	m->acquires++;
+	m->hold_start = current_time_hires();
+#endif
 
 err:
 	exit_critical_section();
@@ -193,7 +241,15 @@ status_t mutex_release(mutex_t *m)
 
 //	dprintf("mutex_release: m %p, count %d, holder %p, curr %p\n", m, m->count, m->holder, current_thread);
 
+#if THREAD_STATS
+	bigtime_t held = current_time_hires() - m->hold_start;
+	if (held > m->max_hold_time)
+		m->max_hold_time = held;
+#endif
+
 	m->holder = 0;
+	/* give back any priority the waiters lent us */
+	thread_restore_priority();
 	m->count--;
 	if (unlikely(m->count >= 1)) {
 		/* release a thread */
@@ -206,3 +262,23 @@ status_t mutex_release(mutex_t *m)
 	return NO_ERROR;
 }
 
+#if THREAD_STATS
+/**
+ * @brief  Print the contention statistics of every live mutex
+ */
+void mutex_dump_stats(void)
+{
+	mutex_t *m;
+
+	printf("%-10s %-16s %10s %10s %12s\n", "mutex", "holder", "acquires",
+	       "contended", "max hold us");
+
+	enter_critical_section();
+	list_for_every_entry(&mutex_list, m, mutex_t, node) {
+		printf("%p %-16.16s %10u %10u %12llu\n", m,
+		       m->holder ? m->holder->name : "-", m->acquires,
+		       m->contended, m->max_hold_time);
+	}
+	exit_critical_section();
+}
+#endif
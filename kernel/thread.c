@@ -61,6 +61,11 @@ int critical_section_count = 1;
 static struct list_node run_queue[NUM_PRIORITIES];
 static uint32_t run_queue_bitmap;
 
+#if !PLATFORM_HAS_DYNAMIC_TIMER
+/* threads blocked with a timeout, soonest deadline first */
+static struct list_node deadline_list;
+#endif
+
 /* the bootstrap thread (statically allocated) */
 static thread_t bootstrap_thread;
 
@@ -76,6 +81,50 @@ static void idle_thread_routine(void) __NO_RETURN;
 static timer_t preempt_timer;
 #endif
 
+#if THREAD_STATS
+/* account the running time of a thread that is giving up the cpu and
+ * start timing its wait in the run queue */
+static void thread_stats_ready(thread_t *t)
+{
+	bigtime_t now = current_time_hires();
+
+	if (t == current_thread)
+		t->run_time += now - t->last_timestamp;
+	t->last_timestamp = now;
+}
+
+/* the scheduler picked a ready thread, close its run queue wait */
+static void thread_stats_switch_in(thread_t *t, bigtime_t now)
+{
+	bigtime_t waited = now - t->last_timestamp;
+
+	t->ready_time += waited;
+	if (waited > t->max_ready_latency)
+		t->max_ready_latency = waited;
+	t->switch_count++;
+	t->last_timestamp = now;
+}
+
+/* account a running thread that blocks, sleeps or exits */
+static void thread_stats_switch_out(thread_t *t, bigtime_t now)
+{
+	if (t->state != THREAD_READY)
+		t->run_time += now - t->last_timestamp;
+}
+
+static size_t thread_stack_used(thread_t *t)
+{
+	const uint32_t *p = t->stack;
+	const uint32_t *end = (const uint32_t *)((uint8_t *)t->stack + t->stack_size);
+
+	/* the stack grows down, untouched words are left at the bottom */
+	while (p < end && *p == THREAD_STACK_PAINT)
+		p++;
+
+	return (uint8_t *)end - (uint8_t *)p;
+}
+#endif
+
 /* run queue manipulation */
 static void insert_in_run_queue_head(thread_t *t)
 {
@@ -86,6 +135,10 @@ static void insert_in_run_queue_head(thread_t *t)
 	ASSERT(in_critical_section());
 #endif
 
+#if THREAD_STATS
+	thread_stats_ready(t);
+#endif
+
 	list_add_head(&run_queue[t->priority], &t->queue_node);
 	run_queue_bitmap |= (1<<t->priority);
 }
@@ -99,6 +152,10 @@ static void insert_in_run_queue_tail(thread_t *t)
 	ASSERT(in_critical_section());
 #endif
 
+#if THREAD_STATS
+	thread_stats_ready(t);
+#endif
+
 	list_add_tail(&run_queue[t->priority], &t->queue_node);
 	run_queue_bitmap |= (1<<t->priority);
 }
@@ -150,6 +207,7 @@ thread_t *thread_create(const char *name, thread_start_routine entry, void *arg,
 	t->entry = entry;
 	t->arg = arg;
 	t->priority = priority;
+	t->base_priority = priority;
 	t->saved_critical_section_count = 1; /* we always start inside a critical section */
 	t->state = THREAD_SUSPENDED;
 	t->blocking_wait_queue = NULL;
@@ -164,6 +222,10 @@ thread_t *thread_create(const char *name, thread_start_routine entry, void *arg,
 
 	t->stack_size = stack_size;
 
+#if THREAD_STATS
+	memset(t->stack, THREAD_STACK_PAINT & 0xff, stack_size);
+#endif
+
 	/* inheirit thread local storage from the parent */
 	int i;
 	for (i=0; i < MAX_TLS_ENTRY; i++)
@@ -342,15 +404,19 @@ void thread_resched(void)
 	}
 
 #if THREAD_STATS
+	bigtime_t now = current_time_hires();
+
 	thread_stats.context_switches++;
 
 	if (oldthread == idle_thread) {
-		bigtime_t now = current_time_hires();
 		thread_stats.idle_time += now - thread_stats.last_idle_timestamp;
 	}
 	if (newthread == idle_thread) {
-		thread_stats.last_idle_timestamp = current_time_hires();
+		thread_stats.last_idle_timestamp = now;
 	}
+
+	thread_stats_switch_out(oldthread, now);
+	thread_stats_switch_in(newthread, now);
 #endif
 
 #if THREAD_CHECKS
@@ -472,16 +538,43 @@ void thread_block(void)
 	exit_critical_section();
 }
 
+#if !PLATFORM_HAS_DYNAMIC_TIMER
+/* time out the waits whose deadline has passed */
+static enum handler_return thread_deadline_tick(void)
+{
+	enum handler_return ret = INT_NO_RESCHEDULE;
+	time_t now = current_time();
+	thread_t *t;
+
+	while ((t = list_peek_head_type(&deadline_list, thread_t, deadline_node))) {
+		if (TIME_LT(now, t->wait_deadline))
+			break;
+
+		list_delete(&t->deadline_node);
+		if (thread_unblock_from_wait_queue(t, false, ERR_TIMED_OUT) >= NO_ERROR)
+			ret = INT_RESCHEDULE;
+	}
+
+	return ret;
+}
+#endif
+
 enum handler_return thread_timer_tick(void)
 {
+	enum handler_return ret = INT_NO_RESCHEDULE;
+
+#if !PLATFORM_HAS_DYNAMIC_TIMER
+	ret = thread_deadline_tick();
+#endif
+
 	if (current_thread == idle_thread)
-		return INT_NO_RESCHEDULE;
+		return ret;
 
 	current_thread->remaining_quantum--;
 	if (current_thread->remaining_quantum <= 0)
 		return INT_RESCHEDULE;
 	else
-		return INT_NO_RESCHEDULE;
+		return ret;
 }
 
 /* timer callback to wake up a sleeping thread */
@@ -544,12 +637,17 @@ void thread_init_early(void)
 	/* initialize the thread list */
 	list_initialize(&thread_list);
 
+#if !PLATFORM_HAS_DYNAMIC_TIMER
+	list_initialize(&deadline_list);
+#endif
+
 	/* create a thread to cover the current running state */
 	thread_t *t = &bootstrap_thread;
 	init_thread_struct(t, "bootstrap");
 
 	/* half construct this thread, since we're already running */
 	t->priority = HIGHEST_PRIORITY;
+	t->base_priority = HIGHEST_PRIORITY;
 	t->state = THREAD_RUNNING;
 	t->saved_critical_section_count = 1;
 	list_add_head(&thread_list, &t->thread_list_node);
@@ -588,6 +686,45 @@ void thread_set_priority(int priority)
 	if (priority > HIGHEST_PRIORITY)
 		priority = HIGHEST_PRIORITY;
 	current_thread->priority = priority;
+	current_thread->base_priority = priority;
+}
+
+/**
+ * @brief  Lend a thread a higher priority
+ *
+ * Used for priority inheritance: a thread that blocks on a resource held
+ * by \a t raises \a t to its own priority until the resource is released.
+ * Does nothing if \a t already runs at \a priority or higher.
+ */
+void thread_boost_priority(thread_t *t, int priority)
+{
+	enter_critical_section();
+
+	if (priority > t->priority) {
+		if (t->state == THREAD_READY && list_in_list(&t->queue_node)) {
+			/* move it to the run queue of its new priority */
+			list_delete(&t->queue_node);
+			if (list_is_empty(&run_queue[t->priority]))
+				run_queue_bitmap &= ~(1<<t->priority);
+
+			t->priority = priority;
+			list_add_tail(&run_queue[priority], &t->queue_node);
+			run_queue_bitmap |= (1<<priority);
+		} else {
+			/* picked up when it is next put on a run queue */
+			t->priority = priority;
+		}
+	}
+
+	exit_critical_section();
+}
+
+/**
+ * @brief  Drop any priority lent to the current thread
+ */
+void thread_restore_priority(void)
+{
+	current_thread->priority = current_thread->base_priority;
 }
 
 /**
@@ -637,6 +774,57 @@ void dump_all_threads(void)
 	exit_critical_section();
 }
 
+#if THREAD_STATS
+/**
+ * @brief  Copy the accounting of every thread
+ *
+ * @param entries  Array to fill
+ * @param count    Number of entries in the array
+ *
+ * @return  Number of entries filled in
+ */
+int thread_stats_snapshot(struct thread_stats_entry *entries, int count)
+{
+	thread_t *t;
+	bigtime_t now;
+	int n = 0;
+
+	enter_critical_section();
+
+	now = current_time_hires();
+	list_for_every_entry(&thread_list, t, thread_t, thread_list_node) {
+		struct thread_stats_entry *e = &entries[n];
+
+		if (n == count)
+			break;
+
+		strlcpy(e->name, t->name, sizeof(e->name));
+		e->priority = t->priority;
+		e->state = t->state;
+		e->run_time = t->run_time;
+		e->ready_time = t->ready_time;
+		e->max_ready_latency = t->max_ready_latency;
+		e->switch_count = t->switch_count;
+
+		/* include the slice or wait that is in progress */
+		if (t == current_thread)
+			e->run_time += now - t->last_timestamp;
+		else if (t->state == THREAD_READY)
+			e->ready_time += now - t->last_timestamp;
+
+		/* the bootstrap thread runs on the stack set up by the arch code */
+		e->stack_size = t->stack ? t->stack_size : 0;
+		e->stack_used = t->stack ? thread_stack_used(t) : 0;
+
+		n++;
+	}
+
+	exit_critical_section();
+
+	return n;
+}
+#endif
+
 /** @} */
 
 
@@ -655,6 +843,7 @@ void wait_queue_init(wait_queue_t *wait)
 	wait->count = 0;
 }
 
+#if PLATFORM_HAS_DYNAMIC_TIMER
 static enum handler_return wait_queue_timeout_handler(timer_t *timer, time_t now, void *arg)
 {
 	thread_t *thread = (thread_t *)arg;
@@ -668,6 +857,26 @@ static enum handler_return wait_queue_timeout_handler(timer_t *timer, time_t now
 
 	return INT_NO_RESCHEDULE;
 }
+#else
+/* queue the current thread on the deadline list, which the scheduler tick
+ * checks from the head, instead of arming a timer for every wait */
+static void wait_queue_set_deadline(time_t timeout)
+{
+	thread_t *entry;
+	thread_t *t = current_thread;
+
+	t->wait_deadline = current_time() + timeout;
+
+	list_for_every_entry(&deadline_list, entry, thread_t, deadline_node) {
+		if (TIME_GT(entry->wait_deadline, t->wait_deadline)) {
+			list_add_before(&entry->deadline_node, &t->deadline_node);
+			return;
+		}
+	}
+
+	list_add_tail(&deadline_list, &t->deadline_node);
+}
+#endif
 
 /**
  * @brief  Block until a wait queue is notified.
@@ -689,7 +898,9 @@ static enum handler_return wait_queue_timeout_handler(timer_t *timer, time_t now
  */
 status_t wait_queue_block(wait_queue_t *wait, time_t timeout)
 {
+#if PLATFORM_HAS_DYNAMIC_TIMER
 	timer_t timer;
+#endif
 
 #if THREAD_CHECKS
 	ASSERT(wait->magic == WAIT_QUEUE_MAGIC);
@@ -706,17 +917,26 @@ status_t wait_queue_block(wait_queue_t *wait, time_t timeout)
 	current_thread->blocking_wait_queue = wait;
 	current_thread->wait_queue_block_ret = NO_ERROR;
 
-	/* if the timeout is nonzero or noninfinite, set a callback to yank us out of the queue */
+	/* if the timeout is nonzero or noninfinite, arrange to be yanked out of the queue */
 	if (timeout != INFINITE_TIME) {
+#if PLATFORM_HAS_DYNAMIC_TIMER
 		timer_initialize(&timer);
 		timer_set_oneshot(&timer, timeout, wait_queue_timeout_handler, (void *)current_thread);
+#else
+		wait_queue_set_deadline(timeout);
+#endif
 	}
 
 	thread_block();
 
-	/* we don't really know if the timer fired or not, so it's better safe to try to cancel it */
+	/* we don't really know if the timeout fired or not, so it's better safe to try to cancel it */
 	if (timeout != INFINITE_TIME) {
+#if PLATFORM_HAS_DYNAMIC_TIMER
 		timer_cancel(&timer);
+#else
+		if (list_in_list(&current_thread->deadline_node))
+			list_delete(&current_thread->deadline_node);
+#endif
 	}
 
 	return current_thread->wait_queue_block_ret;
@@ -867,8 +1087,10 @@ status_t thread_unblock_from_wait_queue(thread_t *t, bool reschedule, status_t w
 	ASSERT(t->magic == THREAD_MAGIC);
 #endif
 
-	if (t->state != THREAD_BLOCKED)
+	if (t->state != THREAD_BLOCKED) {
+		exit_critical_section();
 		return ERR_NOT_BLOCKED;
+	}
 
 #if THREAD_CHECKS
 	ASSERT(t->blocking_wait_queue != NULL);
@@ -32,6 +32,44 @@
 #include <platform/debug.h>
 #include <kernel/thread.h>
 #include <kernel/timer.h>
+#include <kernel/event.h>
+
+int debug_module_level[DBG_MODULE_COUNT] = {
+	[DBG_CORE] = DEBUGLEVEL_CORE,
+	[DBG_APP] = DEBUGLEVEL_APP,
+	[DBG_FASTBOOT] = DEBUGLEVEL_FASTBOOT,
+	[DBG_MMC] = DEBUGLEVEL_MMC,
+	[DBG_NAND] = DEBUGLEVEL_NAND,
+	[DBG_USB] = DEBUGLEVEL_USB,
+	[DBG_DISPLAY] = DEBUGLEVEL_DISPLAY,
+};
+
+const char *debug_module_name[DBG_MODULE_COUNT] = {
+	[DBG_CORE] = "core",
+	[DBG_APP] = "app",
+	[DBG_FASTBOOT] = "fastboot",
+	[DBG_MMC] = "mmc",
+	[DBG_NAND] = "nand",
+	[DBG_USB] = "usb",
+	[DBG_DISPLAY] = "display",
+};
+
+/* deferred log records */
+#define DLOG_RECORDS 128
+
+struct dlog_record {
+	const char *fmt;
+	time_t time;
+	uint32_t args[DLOG_MAX_ARGS];
+};
+
+static struct dlog_record dlog_ring[DLOG_RECORDS];
+static unsigned dlog_head;
+static unsigned dlog_tail;
+static unsigned dlog_dropped;
+/* signalled when a record lands in an empty ring */
+static event_t dlog_event;
+static bool dlog_thread_ready;
 
 void spin(uint32_t usecs)
 {
@@ -49,6 +87,8 @@ void halt(void)
 
 void _panic(void *caller, const char *fmt, ...)
 {
+	dlog_flush();
+
 	dprintf(ALWAYS, "panic (caller %p): ", caller);
 
 	va_list ap;
@@ -99,6 +139,121 @@ int _dvprintf(const char *fmt, va_list ap)
 	return err;
 }
 
+/* Count the conversions in a format so only that many arguments are
+ * pulled off the va_list.
+ */
+static unsigned dlog_count_args(const char *fmt)
+{
+	unsigned count = 0;
+
+	while (*fmt) {
+		if (*fmt++ != '%')
+			continue;
+		if (*fmt == '%') {
+			fmt++;
+			continue;
+		}
+		count++;
+	}
+
+	return count < DLOG_MAX_ARGS ? count : DLOG_MAX_ARGS;
+}
+
+void _dlog(const char *fmt, ...)
+{
+	struct dlog_record *rec;
+	unsigned nargs = dlog_count_args(fmt);
+	bool was_empty;
+	unsigned i;
+	va_list ap;
+
+	enter_critical_section();
+
+	if (dlog_head - dlog_tail == DLOG_RECORDS) {
+		dlog_dropped++;
+		exit_critical_section();
+		return;
+	}
+
+	rec = &dlog_ring[dlog_head % DLOG_RECORDS];
+	rec->fmt = fmt;
+	rec->time = current_time();
+
+	va_start(ap, fmt);
+	for (i = 0; i < nargs; i++)
+		rec->args[i] = va_arg(ap, uint32_t);
+	va_end(ap);
+
+	was_empty = (dlog_head == dlog_tail);
+	dlog_head++;
+
+	/* no reschedule, dlog() may be called from interrupt context */
+	if (was_empty && dlog_thread_ready)
+		event_signal(&dlog_event, false);
+
+	exit_critical_section();
+}
+
+void dlog_flush(void)
+{
+	struct dlog_record rec;
+	unsigned dropped;
+	char buf[256];
+	char ts_buf[13];
+
+	for (;;) {
+		enter_critical_section();
+		if (dlog_tail == dlog_head) {
+			dropped = dlog_dropped;
+			dlog_dropped = 0;
+			exit_critical_section();
+			break;
+		}
+		rec = dlog_ring[dlog_tail % DLOG_RECORDS];
+		dlog_tail++;
+		exit_critical_section();
+
+		snprintf(ts_buf, sizeof(ts_buf), "[%u] ", rec.time);
+		_dputs(ts_buf);
+
+		/* unused trailing arguments are ignored by the formatter */
+		snprintf(buf, sizeof(buf), rec.fmt, rec.args[0], rec.args[1],
+			 rec.args[2], rec.args[3], rec.args[4], rec.args[5]);
+		_dputs(buf);
+	}
+
+	if (dropped)
+		dprintf(ALWAYS, "dlog: %u records dropped\n", dropped);
+}
+
+static int dlog_thread(void *arg)
+{
+	for (;;) {
+		event_wait(&dlog_event);
+		dlog_flush();
+	}
+
+	return 0;
+}
+
+void dlog_init(void)
+{
+	thread_t *thr;
+
+	event_init(&dlog_event, false, EVENT_FLAG_AUTOUNSIGNAL);
+	thr = thread_create("dlog", &dlog_thread, NULL, LOW_PRIORITY,
+			    DEFAULT_STACK_SIZE);
+	if (thr) {
+		enter_critical_section();
+		dlog_thread_ready = true;
+		/* records logged before the thread existed */
+		if (dlog_head != dlog_tail)
+			event_signal(&dlog_event, false);
+		exit_critical_section();
+		thread_resume(thr);
+	}
+}
+
 void hexdump(const void *ptr, size_t len)
 {
 	addr_t address = (addr_t)ptr;
@@ -146,6 +301,8 @@ static int cmd_fill_mem(int argc, const cmd_args *argv);
 static int cmd_reset(int argc, const cmd_args *argv);
 static int cmd_memtest(int argc, const cmd_args *argv);
 static int cmd_copy_mem(int argc, const cmd_args *argv);
+static int cmd_dlog(int argc, const cmd_args *argv);
+static int cmd_dlevel(int argc, const cmd_args *argv);
 
 STATIC_COMMAND_START
 #if DEBUGLEVEL > 0
@@ -163,8 +320,44 @@ STATIC_COMMAND_START
 #if DEBUGLEVEL > 1
 	{ "mtest", "simple memory test", &cmd_memtest },
 #endif
+	{ "dlog", "print pending deferred log records", &cmd_dlog },
+	{ "dlevel", "show or set runtime debug levels", &cmd_dlevel },
 STATIC_COMMAND_END(mem);
 
+static int cmd_dlog(int argc, const cmd_args *argv)
+{
+	dlog_flush();
+	return 0;
+}
+
+static int cmd_dlevel(int argc, const cmd_args *argv)
+{
+	int i;
+
+	if (argc == 1) {
+		for (i = 0; i < DBG_MODULE_COUNT; i++)
+			printf("%-10s %d\n", debug_module_name[i],
+			       debug_module_level[i]);
+		return 0;
+	}
+
+	if (argc < 3) {
+		printf("not enough arguments\n");
+		printf("%s [<module> <level>]\n", argv[0].str);
+		return -1;
+	}
+
+	for (i = 0; i < DBG_MODULE_COUNT; i++) {
+		if (!strcmp(argv[1].str, debug_module_name[i])) {
+			debug_module_level[i] = argv[2].i;
+			return 0;
+		}
+	}
+
+	printf("unknown module %s\n", argv[1].str);
+	return -1;
+}
+
 static int cmd_display_mem(int argc, const cmd_args *argv)
 {
 	int size;
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <debug.h>
+#include <err.h>
+#include <string.h>
+#include <lib/decompress.h>
+
+#define LZ4_MAGIC		0x184D2204
+#define LZ4_LEGACY_MAGIC	0x184C2102
+
+static uint32_t get_le32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+int decompress_detect(const void *buf, size_t len)
+{
+	const unsigned char *p = buf;
+
+	if (len >= 3 && p[0] == 0x1f && p[1] == 0x8b && p[2] == 8)
+		return DECOMPRESS_GZIP;
+
+	if (len >= 4) {
+		if (get_le32(p) == LZ4_MAGIC)
+			return DECOMPRESS_LZ4;
+		if (get_le32(p) == LZ4_LEGACY_MAGIC)
+			return DECOMPRESS_LZ4_LEGACY;
+	}
+
+	return DECOMPRESS_NONE;
+}
+
+const char *decompress_name(int type)
+{
+	switch (type) {
+	case DECOMPRESS_GZIP:
+		return "gzip";
+	case DECOMPRESS_LZ4:
+		return "lz4";
+	case DECOMPRESS_LZ4_LEGACY:
+		return "lz4-legacy";
+	default:
+		return "none";
+	}
+}
+
+int decompress(int type, struct decompress_stream *s)
+{
+	s->out_len = 0;
+
+	switch (type) {
+	case DECOMPRESS_GZIP:
+		return gunzip(s);
+	case DECOMPRESS_LZ4:
+		return unlz4(s, false);
+	case DECOMPRESS_LZ4_LEGACY:
+		return unlz4(s, true);
+	default:
+		return ERR_NOT_SUPPORTED;
+	}
+}
+
+/* copy len bytes of input to buf, in as few pieces as the chunks allow */
+int decompress_read(struct decompress_stream *s, void *buf, size_t len)
+{
+	unsigned char *dst = buf;
+	size_t n;
+
+	while (len) {
+		if (s->next_in == s->end_in && (!s->fill || s->fill(s) <= 0))
+			return ERR_NOT_VALID;
+
+		n = s->end_in - s->next_in;
+		if (n > len)
+			n = len;
+		memcpy(dst, s->next_in, n);
+		s->next_in += n;
+		dst += n;
+		len -= n;
+	}
+
+	return NO_ERROR;
+}
@@ -0,0 +1,529 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Deflate decoder (RFC 1951) with a gzip (RFC 1952) wrapper, written for
+ * a flat output buffer: matches are copied straight out of what has
+ * already been written, so there is no sliding window.  Huffman codes up
+ * to FAST_BITS long are decoded with a single table lookup, longer ones
+ * fall back to walking the canonical code one bit at a time.
+ */
+
+#include <debug.h>
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+#include <lib/decompress.h>
+
+#define MAXBITS		15
+#define MAXLCODES	286
+#define MAXDCODES	30
+#define MAXCODES	(MAXLCODES + MAXDCODES)
+#define FIXLCODES	288
+
+#define FAST_BITS	9
+#define FAST_MASK	((1 << FAST_BITS) - 1)
+
+/* gzip header flags */
+#define GZ_FHCRC	0x02
+#define GZ_FEXTRA	0x04
+#define GZ_FNAME	0x08
+#define GZ_FCOMMENT	0x10
+
+struct huffman {
+	uint16_t fast[1 << FAST_BITS];	/* (length << 9) | symbol, 0 if longer */
+	uint16_t count[MAXBITS + 1];
+	uint16_t symbol[FIXLCODES];
+};
+
+struct inflate_state {
+	struct decompress_stream *s;
+	uint32_t bitbuf;
+	unsigned bitcnt;
+	unsigned overrun;	/* zero bytes made up past the end of input */
+	struct huffman lencode;
+	struct huffman distcode;
+};
+
+/* callers size their workspace with DECOMPRESS_WORKSPACE_SIZE */
+typedef char inflate_state_fits[(sizeof(struct inflate_state) <=
+				 DECOMPRESS_WORKSPACE_SIZE) ? 1 : -1];
+
+static const uint16_t len_base[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t len_extra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t dist_base[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+	8193, 12289, 16385, 24577 };
+static const uint8_t dist_extra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+/* make sure at least n bits are buffered, padding with zeros at the end
+ * of the input so the final code can be looked up; running further past
+ * the end than that means the stream is truncated.
+ */
+static int need(struct inflate_state *st, unsigned n)
+{
+	int c;
+
+	while (st->bitcnt < n) {
+		c = decompress_getc(st->s);
+		if (c < 0) {
+			if (++st->overrun > 4)
+				return ERR_NOT_VALID;
+			c = 0;
+		}
+		st->bitbuf |= (uint32_t) c << st->bitcnt;
+		st->bitcnt += 8;
+	}
+
+	return NO_ERROR;
+}
+
+static inline void drop(struct inflate_state *st, unsigned n)
+{
+	st->bitbuf >>= n;
+	st->bitcnt -= n;
+}
+
+static int bits(struct inflate_state *st, unsigned n)
+{
+	int val;
+
+	if (need(st, n))
+		return ERR_NOT_VALID;
+
+	val = st->bitbuf & ((1 << n) - 1);
+	drop(st, n);
+
+	return val;
+}
+
+static unsigned reverse(unsigned code, unsigned len)
+{
+	unsigned rev = 0;
+
+	while (len--) {
+		rev = (rev << 1) | (code & 1);
+		code >>= 1;
+	}
+
+	return rev;
+}
+
+/* build a decoding table from a list of code lengths; incomplete codes
+ * are allowed (a single distance code is), over-subscribed ones are not.
+ */
+static int huffman_build(struct huffman *h, const uint8_t *length, unsigned n)
+{
+	uint16_t offs[MAXBITS + 1];
+	unsigned sym, len, code, index, i, j;
+	int left;
+
+	memset(h->count, 0, sizeof(h->count));
+	for (sym = 0; sym < n; sym++)
+		h->count[length[sym]]++;
+	if (h->count[0] == n)
+		return ERR_NOT_VALID;
+
+	left = 1;
+	for (len = 1; len <= MAXBITS; len++) {
+		left <<= 1;
+		left -= h->count[len];
+		if (left < 0)
+			return ERR_NOT_VALID;
+	}
+
+	offs[1] = 0;
+	for (len = 1; len < MAXBITS; len++)
+		offs[len + 1] = offs[len] + h->count[len];
+	for (sym = 0; sym < n; sym++)
+		if (length[sym])
+			h->symbol[offs[length[sym]]++] = sym;
+
+	/* codes short enough for the lookup table, in canonical order */
+	memset(h->fast, 0, sizeof(h->fast));
+	code = 0;
+	index = 0;
+	for (len = 1; len <= FAST_BITS; len++) {
+		for (i = 0; i < h->count[len]; i++) {
+			sym = h->symbol[index++];
+			for (j = reverse(code, len); j <= FAST_MASK; j += 1 << len)
+				h->fast[j] = (len << 9) | sym;
+			code++;
+		}
+		code <<= 1;
+	}
+
+	return NO_ERROR;
+}
+
+static int decode(struct inflate_state *st, const struct huffman *h)
+{
+	unsigned len, code, first, index, count, entry;
+
+	if (need(st, MAXBITS))
+		return ERR_NOT_VALID;
+
+	entry = h->fast[st->bitbuf & FAST_MASK];
+	if (entry) {
+		drop(st, entry >> 9);
+		return entry & 0x1ff;
+	}
+
+	code = first = index = 0;
+	for (len = 1; len <= MAXBITS; len++) {
+		code |= (st->bitbuf >> (len - 1)) & 1;
+		count = h->count[len];
+		if (code - first < count) {
+			drop(st, len);
+			return h->symbol[index + (code - first)];
+		}
+		index += count;
+		first += count;
+		first <<= 1;
+		code <<= 1;
+	}
+
+	return ERR_NOT_VALID;
+}
+
+static int stored(struct inflate_state *st)
+{
+	struct decompress_stream *s = st->s;
+	int len, nlen;
+
+	/* back to a byte boundary, whole bytes stay in the bit buffer */
+	drop(st, st->bitcnt & 7);
+
+	len = bits(st, 16);
+	nlen = bits(st, 16);
+	if (len < 0 || nlen < 0 || len != (~nlen & 0xffff))
+		return ERR_NOT_VALID;
+
+	if (s->out_len + len > s->out_max)
+		return ERR_TOO_BIG;
+
+	while (len && st->bitcnt) {
+		s->out[s->out_len++] = st->bitbuf & 0xff;
+		drop(st, 8);
+		len--;
+	}
+
+	if (decompress_read(s, s->out + s->out_len, len))
+		return ERR_NOT_VALID;
+	s->out_len += len;
+
+	return NO_ERROR;
+}
+
+static int codes(struct inflate_state *st)
+{
+	struct decompress_stream *s = st->s;
+	unsigned char *out = s->out;
+	size_t pos = s->out_len;
+	int sym, extra;
+	unsigned len, dist;
+
+	for (;;) {
+		sym = decode(st, &st->lencode);
+		if (sym < 0)
+			return sym;
+
+		if (sym < 256) {
+			if (pos == s->out_max)
+				return ERR_TOO_BIG;
+			out[pos++] = sym;
+			continue;
+		}
+
+		if (sym == 256)
+			break;
+
+		sym -= 257;
+		if (sym >= 29)
+			return ERR_NOT_VALID;
+		extra = bits(st, len_extra[sym]);
+		if (extra < 0)
+			return extra;
+		len = len_base[sym] + extra;
+
+		sym = decode(st, &st->distcode);
+		if (sym < 0)
+			return sym;
+		if (sym >= 30)
+			return ERR_NOT_VALID;
+		extra = bits(st, dist_extra[sym]);
+		if (extra < 0)
+			return extra;
+		dist = dist_base[sym] + extra;
+
+		if (dist > pos)
+			return ERR_NOT_VALID;
+		if (len > s->out_max - pos)
+			return ERR_TOO_BIG;
+
+		if (dist >= len) {
+			memcpy(out + pos, out + pos - dist, len);
+			pos += len;
+		} else {
+			/* overlapping copy repeats the pattern */
+			while (len--) {
+				out[pos] = out[pos - dist];
+				pos++;
+			}
+		}
+	}
+
+	s->out_len = pos;
+
+	return NO_ERROR;
+}
+
+static int fixed(struct inflate_state *st)
+{
+	uint8_t lengths[FIXLCODES];
+	unsigned sym;
+
+	for (sym = 0; sym < 144; sym++)
+		lengths[sym] = 8;
+	for (; sym < 256; sym++)
+		lengths[sym] = 9;
+	for (; sym < 280; sym++)
+		lengths[sym] = 7;
+	for (; sym < FIXLCODES; sym++)
+		lengths[sym] = 8;
+	huffman_build(&st->lencode, lengths, FIXLCODES);
+
+	for (sym = 0; sym < MAXDCODES; sym++)
+		lengths[sym] = 5;
+	huffman_build(&st->distcode, lengths, MAXDCODES);
+
+	return codes(st);
+}
+
+static int dynamic(struct inflate_state *st)
+{
+	static const uint8_t order[19] = {
+		16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+	uint8_t lengths[MAXCODES];
+	int nlen, ndist, ncode;
+	int index, sym, len, rep;
+
+	nlen = bits(st, 5);
+	ndist = bits(st, 5);
+	ncode = bits(st, 4);
+	if (nlen < 0 || ndist < 0 || ncode < 0)
+		return ERR_NOT_VALID;
+	nlen += 257;
+	ndist += 1;
+	ncode += 4;
+	if (nlen > MAXLCODES || ndist > MAXDCODES)
+		return ERR_NOT_VALID;
+
+	memset(lengths, 0, sizeof(lengths));
+	for (index = 0; index < ncode; index++) {
+		len = bits(st, 3);
+		if (len < 0)
+			return ERR_NOT_VALID;
+		lengths[order[index]] = len;
+	}
+	if (huffman_build(&st->lencode, lengths, 19))
+		return ERR_NOT_VALID;
+
+	index = 0;
+	while (index < nlen + ndist) {
+		sym = decode(st, &st->lencode);
+		if (sym < 0)
+			return sym;
+
+		if (sym < 16) {
+			lengths[index++] = sym;
+			continue;
+		}
+
+		len = 0;
+		if (sym == 16) {
+			if (index == 0)
+				return ERR_NOT_VALID;
+			len = lengths[index - 1];
+			rep = bits(st, 2);
+			rep = rep < 0 ? rep : 3 + rep;
+		} else if (sym == 17) {
+			rep = bits(st, 3);
+			rep = rep < 0 ? rep : 3 + rep;
+		} else {
+			rep = bits(st, 7);
+			rep = rep < 0 ? rep : 11 + rep;
+		}
+		if (rep < 0 || index + rep > nlen + ndist)
+			return ERR_NOT_VALID;
+		while (rep--)
+			lengths[index++] = len;
+	}
+
+	/* without an end-of-block code the block cannot terminate */
+	if (lengths[256] == 0)
+		return ERR_NOT_VALID;
+
+	if (huffman_build(&st->lencode, lengths, nlen))
+		return ERR_NOT_VALID;
+	if (huffman_build(&st->distcode, lengths + nlen, ndist))
+		return ERR_NOT_VALID;
+
+	return codes(st);
+}
+
+static int inflate(struct inflate_state *st)
+{
+	int last, type, ret;
+
+	do {
+		last = bits(st, 1);
+		type = bits(st, 2);
+		if (last < 0 || type < 0)
+			return ERR_NOT_VALID;
+
+		switch (type) {
+		case 0:
+			ret = stored(st);
+			break;
+		case 1:
+			ret = fixed(st);
+			break;
+		case 2:
+			ret = dynamic(st);
+			break;
+		default:
+			ret = ERR_NOT_VALID;
+			break;
+		}
+		if (ret)
+			return ret;
+	} while (!last);
+
+	return NO_ERROR;
+}
+
+static int skip_string(struct decompress_stream *s)
+{
+	int c;
+
+	do {
+		c = decompress_getc(s);
+		if (c < 0)
+			return ERR_NOT_VALID;
+	} while (c);
+
+	return NO_ERROR;
+}
+
+static int gzip_header(struct decompress_stream *s)
+{
+	unsigned char hdr[10];
+	unsigned char extra[2];
+	unsigned len;
+
+	if (decompress_read(s, hdr, sizeof(hdr)))
+		return ERR_NOT_VALID;
+	if (hdr[0] != 0x1f || hdr[1] != 0x8b || hdr[2] != 8)
+		return ERR_NOT_VALID;
+
+	if (hdr[3] & GZ_FEXTRA) {
+		if (decompress_read(s, extra, sizeof(extra)))
+			return ERR_NOT_VALID;
+		len = extra[0] | (extra[1] << 8);
+		while (len--)
+			if (decompress_getc(s) < 0)
+				return ERR_NOT_VALID;
+	}
+	if ((hdr[3] & GZ_FNAME) && skip_string(s))
+		return ERR_NOT_VALID;
+	if ((hdr[3] & GZ_FCOMMENT) && skip_string(s))
+		return ERR_NOT_VALID;
+	if ((hdr[3] & GZ_FHCRC) && decompress_read(s, extra, sizeof(extra)))
+		return ERR_NOT_VALID;
+
+	return NO_ERROR;
+}
+
+/* The trailer's ISIZE is checked; the CRC is not, it would cost a second
+ * pass over the output and the boot image has its own signature check.
+ * With a workspace given nothing here allocates or prints, so it can
+ * run as a job on the second core.
+ */
+int gunzip(struct decompress_stream *s)
+{
+	struct inflate_state *st;
+	uint32_t isize = 0;
+	int ret, i, c;
+
+	ret = gzip_header(s);
+	if (ret)
+		return ret;
+
+	if (s->workspace) {
+		st = s->workspace;
+	} else {
+		st = malloc(sizeof(*st));
+		if (!st)
+			return ERR_NO_MEMORY;
+	}
+	memset(st, 0, sizeof(*st));
+	st->s = s;
+
+	ret = inflate(st);
+	if (ret)
+		goto out;
+
+	/* crc32 and isize follow on the next byte boundary */
+	drop(st, st->bitcnt & 7);
+	for (i = 0; i < 8; i++) {
+		c = bits(st, 8);
+		if (c < 0 || st->overrun) {
+			ret = ERR_NOT_VALID;
+			goto out;
+		}
+		if (i >= 4)
+			isize |= (uint32_t) c << ((i - 4) * 8);
+	}
+
+	if (isize != (uint32_t) s->out_len)
+		ret = ERR_NOT_VALID;
+
+out:
+	if (!s->workspace)
+		free(st);
+	return ret;
+}
@@ -0,0 +1,6 @@
+LOCAL_DIR := $(GET_LOCAL_DIR)
+
+OBJS += \
+	$(LOCAL_DIR)/decompress.o \
+	$(LOCAL_DIR)/inflate.o \
+	$(LOCAL_DIR)/unlz4.o
@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * LZ4 decoder for the frame format and the legacy format the kernel
+ * build produces for Image.lz4.  Blocks are decoded sequence by sequence
+ * straight from the input stream, so a block may straddle input chunks.
+ * Block and content checksums are skipped, not verified.
+ */
+
+#include <debug.h>
+#include <err.h>
+#include <string.h>
+#include <lib/decompress.h>
+
+#define LZ4_MAGIC		0x184D2204
+#define LZ4_LEGACY_MAGIC	0x184C2102
+#define LZ4_LEGACY_BLOCK	(8 * 1024 * 1024)
+
+/* frame descriptor flags */
+#define LZ4_FLG_VERSION_MASK	0xc0
+#define LZ4_FLG_VERSION		0x40
+#define LZ4_FLG_BLOCK_CHECKSUM	0x10
+#define LZ4_FLG_CONTENT_SIZE	0x08
+#define LZ4_FLG_CONTENT_CHECKSUM 0x04
+#define LZ4_FLG_DICT_ID		0x01
+
+#define LZ4_BLOCK_UNCOMPRESSED	0x80000000
+
+static int get_le32(struct decompress_stream *s, uint32_t *val)
+{
+	unsigned char b[4];
+
+	if (decompress_read(s, b, sizeof(b)))
+		return ERR_NOT_VALID;
+
+	*val = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t) b[3] << 24);
+	return NO_ERROR;
+}
+
+static int skip(struct decompress_stream *s, unsigned len)
+{
+	while (len--)
+		if (decompress_getc(s) < 0)
+			return ERR_NOT_VALID;
+
+	return NO_ERROR;
+}
+
+/* decode one compressed block of size bytes */
+static int lz4_block(struct decompress_stream *s, uint32_t size)
+{
+	unsigned char *out = s->out;
+	size_t pos = s->out_len;
+	uint32_t left = size;
+	unsigned token, len, off;
+	int c;
+
+#define NEXT_BYTE(v) do { \
+		if (!left || (c = decompress_getc(s)) < 0) \
+			return ERR_NOT_VALID; \
+		left--; \
+		(v) = c; \
+	} while (0)
+
+	while (left) {
+		NEXT_BYTE(token);
+
+		/* literals */
+		len = token >> 4;
+		if (len == 15) {
+			do {
+				NEXT_BYTE(c);
+				len += c;
+			} while (c == 255);
+		}
+		if (len > left)
+			return ERR_NOT_VALID;
+		if (len > s->out_max - pos)
+			return ERR_TOO_BIG;
+		if (decompress_read(s, out + pos, len))
+			return ERR_NOT_VALID;
+		pos += len;
+		left -= len;
+
+		/* the last sequence of a block has no match */
+		if (!left)
+			break;
+
+		NEXT_BYTE(off);
+		NEXT_BYTE(c);
+		off |= c << 8;
+		if (off == 0 || off > pos)
+			return ERR_NOT_VALID;
+
+		len = token & 15;
+		if (len == 15) {
+			do {
+				NEXT_BYTE(c);
+				len += c;
+			} while (c == 255);
+		}
+		len += 4;
+		if (len > s->out_max - pos)
+			return ERR_TOO_BIG;
+
+		if (off >= len) {
+			memcpy(out + pos, out + pos - off, len);
+			pos += len;
+		} else {
+			while (len--) {
+				out[pos] = out[pos - off];
+				pos++;
+			}
+		}
+	}
+
+#undef NEXT_BYTE
+
+	s->out_len = pos;
+	return NO_ERROR;
+}
+
+static int lz4_stored(struct decompress_stream *s, uint32_t size)
+{
+	if (size > s->out_max - s->out_len)
+		return ERR_TOO_BIG;
+	if (decompress_read(s, s->out + s->out_len, size))
+		return ERR_NOT_VALID;
+
+	s->out_len += size;
+	return NO_ERROR;
+}
+
+static int unlz4_frame(struct decompress_stream *s)
+{
+	uint32_t size;
+	int flg, bd, ret;
+
+	flg = decompress_getc(s);
+	bd = decompress_getc(s);
+	if (flg < 0 || bd < 0)
+		return ERR_NOT_VALID;
+	if ((flg & LZ4_FLG_VERSION_MASK) != LZ4_FLG_VERSION)
+		return ERR_NOT_VALID;
+
+	/* content size, dictionary id and the header checksum */
+	if (skip(s, ((flg & LZ4_FLG_CONTENT_SIZE) ? 8 : 0) +
+		    ((flg & LZ4_FLG_DICT_ID) ? 4 : 0) + 1))
+		return ERR_NOT_VALID;
+
+	for (;;) {
+		if (get_le32(s, &size))
+			return ERR_NOT_VALID;
+		if (size == 0)
+			break;
+
+		if (size & LZ4_BLOCK_UNCOMPRESSED)
+			ret = lz4_stored(s, size & ~LZ4_BLOCK_UNCOMPRESSED);
+		else
+			ret = lz4_block(s, size);
+		if (ret)
+			return ret;
+
+		if ((flg & LZ4_FLG_BLOCK_CHECKSUM) && skip(s, 4))
+			return ERR_NOT_VALID;
+	}
+
+	if ((flg & LZ4_FLG_CONTENT_CHECKSUM) && skip(s, 4))
+		return ERR_NOT_VALID;
+
+	return NO_ERROR;
+}
+
+static int unlz4_legacy(struct decompress_stream *s)
+{
+	uint32_t size;
+	int ret;
+
+	for (;;) {
+		if (get_le32(s, &size))
+			break;
+
+		/* concatenated streams repeat the magic */
+		if (size == LZ4_LEGACY_MAGIC)
+			continue;
+
+		/* the kernel appends the uncompressed size after the last
+		 * block, recognise it by the input ending right behind it.
+		 */
+		if (decompress_getc(s) < 0)
+			break;
+		s->next_in--;
+
+		if (size > LZ4_LEGACY_BLOCK * 2)
+			return ERR_NOT_VALID;
+
+		ret = lz4_block(s, size);
+		if (ret)
+			return ret;
+	}
+
+	return s->out_len ? NO_ERROR : ERR_NOT_VALID;
+}
+
+int unlz4(struct decompress_stream *s, bool legacy)
+{
+	uint32_t magic;
+
+	if (get_le32(s, &magic))
+		return ERR_NOT_VALID;
+
+	if (legacy) {
+		if (magic != LZ4_LEGACY_MAGIC)
+			return ERR_NOT_VALID;
+		return unlz4_legacy(s);
+	}
+
+	if (magic != LZ4_MAGIC)
+		return ERR_NOT_VALID;
+	return unlz4_frame(s);
+}
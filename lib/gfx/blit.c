@@ -0,0 +1,459 @@
+/*
+ * Copyright (c) 2008-2010 Travis Geiselbrecht
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * @file
+ * @brief  Row based pixel conversion and blending kernels
+ *
+ * Every kernel works on a single row of count pixels.  The surface level
+ * routines in gfx.c walk the rows and pick the kernel for the format pair.
+ *
+ * @ingroup graphics
+ */
+
+#include <debug.h>
+#include <string.h>
+#include <stdlib.h>
+#include <printf.h>
+#include <platform.h>
+#include <sys/types.h>
+#include <lib/gfx.h>
+
+#if ARM_WITH_NEON
+/* blit_neon.S, process count & ~7 pixels */
+void gfx_blend_argb8888_rgb565_neon(uint16_t *dest, const uint32_t *src, uint count);
+void gfx_blend_argb8888_rgb888_neon(uint8_t *dest, const uint32_t *src, uint count);
+#endif
+
+/* x / 255 rounded, for x <= 255 * 255 */
+static inline uint div255(uint x)
+{
+	return (x + ((x + 128) >> 8) + 128) >> 8;
+}
+
+static inline uint16_t argb8888_to_rgb565(uint32_t in)
+{
+	return ((in >> 8) & 0xf800) | ((in >> 5) & 0x07e0) | ((in >> 3) & 0x001f);
+}
+
+static inline uint32_t rgb565_to_argb8888(uint16_t in)
+{
+	uint r = (in >> 11) & 0x1f;
+	uint g = (in >> 5) & 0x3f;
+	uint b = in & 0x1f;
+
+	r = (r << 3) | (r >> 2);
+	g = (g << 2) | (g >> 4);
+	b = (b << 3) | (b >> 2);
+
+	return 0xff000000 | (r << 16) | (g << 8) | b;
+}
+
+/* RGB 888 is stored as packed bytes in B, G, R order */
+static inline uint32_t rgb888_to_argb8888(const uint8_t *in)
+{
+	return 0xff000000 | (in[2] << 16) | (in[1] << 8) | in[0];
+}
+
+static inline void argb8888_to_rgb888(uint8_t *out, uint32_t in)
+{
+	out[0] = in;
+	out[1] = in >> 8;
+	out[2] = in >> 16;
+}
+
+/* blend one channel of src over an opaque destination */
+static inline uint blend_channel(uint s, uint d, uint a)
+{
+	return div255(s * a + d * (255 - a));
+}
+
+static inline uint32_t blend_opaque(uint32_t dest, uint32_t src)
+{
+	uint a = src >> 24;
+	uint r, g, b;
+
+	if (a == 0)
+		return dest;
+	if (a == 255)
+		return src;
+
+	r = blend_channel((src >> 16) & 0xff, (dest >> 16) & 0xff, a);
+	g = blend_channel((src >> 8) & 0xff, (dest >> 8) & 0xff, a);
+	b = blend_channel(src & 0xff, dest & 0xff, a);
+
+	return 0xff000000 | (r << 16) | (g << 8) | b;
+}
+
+/* Porter-Duff src over dest, honouring the destination alpha */
+static inline uint32_t blend_argb8888(uint32_t dest, uint32_t src)
+{
+	uint sa = src >> 24;
+	uint da = dest >> 24;
+	uint dw, oa;
+	uint r, g, b;
+
+	if (sa == 255 || da == 0)
+		return src;
+	if (sa == 0)
+		return dest;
+
+	/* weight of the destination color after src covers it */
+	dw = div255(da * (255 - sa));
+	oa = sa + dw;
+
+	r = (((src >> 16) & 0xff) * sa + ((dest >> 16) & 0xff) * dw + oa / 2) / oa;
+	g = (((src >> 8) & 0xff) * sa + ((dest >> 8) & 0xff) * dw + oa / 2) / oa;
+	b = ((src & 0xff) * sa + (dest & 0xff) * dw + oa / 2) / oa;
+
+	return (oa << 24) | (r << 16) | (g << 8) | b;
+}
+
+static void blend_row_565(uint16_t *dest, const uint32_t *src, uint count)
+{
+#if ARM_WITH_NEON
+	gfx_blend_argb8888_rgb565_neon(dest, src, count);
+	dest += count & ~7;
+	src += count & ~7;
+	count &= 7;
+#endif
+	while (count--) {
+		uint32_t s = *src++;
+		uint a = s >> 24;
+
+		if (a == 255)
+			*dest = argb8888_to_rgb565(s);
+		else if (a)
+			*dest = argb8888_to_rgb565(blend_opaque(rgb565_to_argb8888(*dest), s));
+		dest++;
+	}
+}
+
+static void blend_row_888(uint8_t *dest, const uint32_t *src, uint count)
+{
+#if ARM_WITH_NEON
+	gfx_blend_argb8888_rgb888_neon(dest, src, count);
+	dest += (count & ~7) * 3;
+	src += count & ~7;
+	count &= 7;
+#endif
+	while (count--) {
+		uint32_t s = *src++;
+
+		if (s >> 24)
+			argb8888_to_rgb888(dest, blend_opaque(rgb888_to_argb8888(dest), s));
+		dest += 3;
+	}
+}
+
+static void blend_row_x888(uint32_t *dest, const uint32_t *src, uint count)
+{
+	while (count--) {
+		*dest = blend_opaque(*dest, *src++);
+		dest++;
+	}
+}
+
+static void blend_row_8888(uint32_t *dest, const uint32_t *src, uint count)
+{
+	while (count--) {
+		*dest = blend_argb8888(*dest, *src++);
+		dest++;
+	}
+}
+
+/**
+ * @brief  Blend a row of ARGB 8888 pixels over a row of another format.
+ */
+void gfx_blend_row(void *dest, gfx_format dest_format, const uint32_t *src, uint count)
+{
+	switch (dest_format) {
+		case GFX_FORMAT_RGB_565:
+			blend_row_565(dest, src, count);
+			break;
+		case GFX_FORMAT_RGB_888:
+			blend_row_888(dest, src, count);
+			break;
+		case GFX_FORMAT_RGB_x888:
+			blend_row_x888(dest, src, count);
+			break;
+		case GFX_FORMAT_ARGB_8888:
+			blend_row_8888(dest, src, count);
+			break;
+		default:
+			panic("gfx_blend_row: bad format %d\n", dest_format);
+	}
+}
+
+/* read count pixels of any format as ARGB 8888 */
+static void load_row(uint32_t *dest, const void *src, gfx_format format, uint count)
+{
+	const uint16_t *src16 = src;
+	const uint8_t *src8 = src;
+	const uint32_t *src32 = src;
+
+	switch (format) {
+		case GFX_FORMAT_RGB_565:
+			while (count--)
+				*dest++ = rgb565_to_argb8888(*src16++);
+			break;
+		case GFX_FORMAT_RGB_888:
+			while (count--) {
+				*dest++ = rgb888_to_argb8888(src8);
+				src8 += 3;
+			}
+			break;
+		case GFX_FORMAT_RGB_x888:
+			while (count--)
+				*dest++ = 0xff000000 | *src32++;
+			break;
+		case GFX_FORMAT_ARGB_8888:
+			memcpy(dest, src, count * 4);
+			break;
+		default:
+			panic("gfx_convert_row: bad format %d\n", format);
+	}
+}
+
+/* write count ARGB 8888 pixels in any format */
+static void store_row(void *dest, gfx_format format, const uint32_t *src, uint count)
+{
+	uint16_t *dest16 = dest;
+	uint8_t *dest8 = dest;
+
+	switch (format) {
+		case GFX_FORMAT_RGB_565:
+			while (count--)
+				*dest16++ = argb8888_to_rgb565(*src++);
+			break;
+		case GFX_FORMAT_RGB_888:
+			while (count--) {
+				argb8888_to_rgb888(dest8, *src++);
+				dest8 += 3;
+			}
+			break;
+		case GFX_FORMAT_RGB_x888:
+		case GFX_FORMAT_ARGB_8888:
+			memcpy(dest, src, count * 4);
+			break;
+		default:
+			panic("gfx_convert_row: bad format %d\n", format);
+	}
+}
+
+#define CONVERT_CHUNK 64
+
+/**
+ * @brief  Convert a row of pixels from one format to another.
+ *
+ * Alpha is dropped when converting to a format without it and set to
+ * opaque when converting from one.
+ */
+void gfx_convert_row(void *dest, gfx_format dest_format, const void *src, gfx_format src_format, uint count)
+{
+	uint32_t tmp[CONVERT_CHUNK];
+	uint dest_size = gfx_format_pixelsize(dest_format);
+	uint src_size = gfx_format_pixelsize(src_format);
+
+	if (dest_format == src_format) {
+		memcpy(dest, src, count * src_size);
+		return;
+	}
+
+	/* the common cases go straight through, everything else via ARGB 8888 */
+	if (src_format == GFX_FORMAT_ARGB_8888 || src_format == GFX_FORMAT_RGB_x888) {
+		if (dest_format == GFX_FORMAT_ARGB_8888) {
+			load_row(dest, src, src_format, count);
+			return;
+		}
+		store_row(dest, dest_format, src, count);
+		return;
+	}
+
+	while (count) {
+		uint n = MIN(count, CONVERT_CHUNK);
+
+		load_row(tmp, src, src_format, n);
+		store_row(dest, dest_format, tmp, n);
+
+		dest = (uint8_t *)dest + n * dest_size;
+		src = (const uint8_t *)src + n * src_size;
+		count -= n;
+	}
+}
+
+/**
+ * @brief  Fill a row of pixels with an ARGB 8888 color.
+ */
+void gfx_fill_row(void *dest, gfx_format format, uint32_t color, uint count)
+{
+	uint8_t *dest8 = dest;
+	uint16_t *dest16 = dest;
+	uint32_t *dest32 = dest;
+
+	switch (format) {
+		case GFX_FORMAT_RGB_565: {
+			uint16_t color16 = argb8888_to_rgb565(color);
+
+			if (count && ((addr_t)dest16 & 2)) {
+				*dest16++ = color16;
+				count--;
+			}
+			/* two pixels per word store */
+			dest32 = (uint32_t *)dest16;
+			color = (color16 << 16) | color16;
+			while (count >= 2) {
+				*dest32++ = color;
+				count -= 2;
+			}
+			if (count)
+				*(uint16_t *)dest32 = color16;
+			break;
+		}
+		case GFX_FORMAT_RGB_888:
+			if (count == 0)
+				break;
+			argb8888_to_rgb888(dest8, color);
+			/* double the already written span until the row is full */
+			for (uint done = 1; done < count; done *= 2)
+				memcpy(dest8 + done * 3, dest8, MIN(done, count - done) * 3);
+			break;
+		case GFX_FORMAT_RGB_x888:
+		case GFX_FORMAT_ARGB_8888:
+			while (count >= 4) {
+				dest32[0] = color;
+				dest32[1] = color;
+				dest32[2] = color;
+				dest32[3] = color;
+				dest32 += 4;
+				count -= 4;
+			}
+			while (count--)
+				*dest32++ = color;
+			break;
+		default:
+			panic("gfx_fill_row: bad format %d\n", format);
+	}
+}
+
+#if defined(WITH_LIB_CONSOLE) && DEBUGLEVEL > 1
+
+#define BENCH_SIZE	256
+#define BENCH_LOOPS	16
+
+static void gfx_bench_report(const char *name, bigtime_t start)
+{
+	bigtime_t elapsed = current_time_hires() - start;
+	uint64_t pixels = (uint64_t)BENCH_SIZE * BENCH_SIZE * BENCH_LOOPS;
+	uint rate;
+
+	if (elapsed == 0)
+		elapsed = 1;
+
+	// pixels per microsecond is Mpixel/s, keep two decimals
+	rate = pixels * 100 / elapsed;
+	printf("%-24s %u.%02u Mpixel/s\n", name, rate / 100, rate % 100);
+}
+
+/**
+ * @brief  Report fill, copy, blend and convert throughput per format.
+ */
+int gfx_bench(void)
+{
+	static const struct {
+		const char *name;
+		gfx_format format;
+	} formats[] = {
+		{ "rgb565", GFX_FORMAT_RGB_565 },
+		{ "rgb888", GFX_FORMAT_RGB_888 },
+		{ "argb8888", GFX_FORMAT_ARGB_8888 },
+	};
+	gfx_surface *surface[countof(formats)];
+	gfx_surface *source;
+	char name[32];
+	bigtime_t start;
+	uint i, j, loop;
+	int ret = 0;
+
+	memset(surface, 0, sizeof(surface));
+
+	source = gfx_create_surface(NULL, BENCH_SIZE, BENCH_SIZE, BENCH_SIZE, GFX_FORMAT_ARGB_8888);
+	if (!source)
+		return -1;
+
+	// half transparent gradient so the blend paths do real work
+	for (j = 0; j < BENCH_SIZE; j++)
+		for (i = 0; i < BENCH_SIZE; i++)
+			gfx_putpixel(source, i, j, (i << 24) | (j << 16) | (i << 8) | j);
+
+	for (i = 0; i < countof(formats); i++) {
+		surface[i] = gfx_create_surface(NULL, BENCH_SIZE, BENCH_SIZE, BENCH_SIZE, formats[i].format);
+		if (!surface[i]) {
+			ret = -1;
+			goto out;
+		}
+	}
+
+	for (i = 0; i < countof(formats); i++) {
+		gfx_surface *s = surface[i];
+
+		snprintf(name, sizeof(name), "fill %s", formats[i].name);
+		start = current_time_hires();
+		for (loop = 0; loop < BENCH_LOOPS; loop++)
+			s->fillrect(s, 0, 0, BENCH_SIZE, BENCH_SIZE, 0xff204080 + loop);
+		gfx_bench_report(name, start);
+
+		snprintf(name, sizeof(name), "copy %s", formats[i].name);
+		start = current_time_hires();
+		for (loop = 0; loop < BENCH_LOOPS; loop++)
+			s->copyrect(s, 0, 1, BENCH_SIZE, BENCH_SIZE - 1, 0, 0);
+		gfx_bench_report(name, start);
+
+		snprintf(name, sizeof(name), "blend argb8888->%s", formats[i].name);
+		start = current_time_hires();
+		for (loop = 0; loop < BENCH_LOOPS; loop++)
+			gfx_surface_blend(s, source, 0, 0);
+		gfx_bench_report(name, start);
+
+		for (j = 0; j < countof(formats); j++) {
+			if (i == j || formats[j].format == GFX_FORMAT_ARGB_8888)
+				continue;
+
+			snprintf(name, sizeof(name), "convert %s->%s", formats[j].name, formats[i].name);
+			start = current_time_hires();
+			for (loop = 0; loop < BENCH_LOOPS; loop++)
+				gfx_surface_blend(s, surface[j], 0, 0);
+			gfx_bench_report(name, start);
+		}
+	}
+
+out:
+	for (i = 0; i < countof(formats); i++)
+		if (surface[i])
+			gfx_surface_destroy(surface[i]);
+	gfx_surface_destroy(source);
+
+	return ret;
+}
+
+#endif
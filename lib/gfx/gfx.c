@@ -138,107 +138,56 @@ static void putpixel32(gfx_surface *surface, uint x, uint y, uint color)
 	*dest = color;
 }
 
-static void copyrect16(gfx_surface *surface, uint x, uint y, uint width, uint height, uint x2, uint y2)
+static void putpixel24(gfx_surface *surface, uint x, uint y, uint color)
 {
-	// copy
-	const uint16_t *src = &((const uint16_t *)surface->ptr)[x + y * surface->stride];
-	uint16_t *dest = &((uint16_t *)surface->ptr)[x2 + y2 * surface->stride];
-	uint stride_diff = surface->stride - width;
+	uint8_t *dest = &((uint8_t *)surface->ptr)[(x + y * surface->stride) * 3];
 
-	if (dest < src) {
-		uint i, j;
-		for (i=0; i < height; i++) {
-			for (j=0; j < width; j++) {
-				*dest = *src;
-				dest++;
-				src++;
-			}
-			dest += stride_diff;
-			src += stride_diff;
-		}
-	} else {
-		// copy backwards
-		src += height * surface->stride + width;
-		dest += height * surface->stride + width;
-
-		uint i, j;
-		for (i=0; i < height; i++) {
-			for (j=0; j < width; j++) {
-				*dest = *src;
-				dest--;
-				src--;
-			}
-			dest -= stride_diff;
-			src -= stride_diff;
-		}
-	}
+	dest[0] = color;
+	dest[1] = color >> 8;
+	dest[2] = color >> 16;
 }
 
-static void fillrect16(gfx_surface *surface, uint x, uint y, uint width, uint height, uint color)
+static void copyrect(gfx_surface *surface, uint x, uint y, uint width, uint height, uint x2, uint y2)
 {
-	uint16_t *dest = &((uint16_t *)surface->ptr)[x + y * surface->stride];
-	uint stride_diff = surface->stride - width;
-
-	uint16_t color16 = ARGB8888_to_RGB565(color);
-	
-	uint i, j;
-	for (i=0; i < height; i++) {
-		for (j=0; j < width; j++) {
-			*dest = color16;
-			dest++;
-		}
-		dest += stride_diff;
-	}
-}
-
-static void copyrect32(gfx_surface *surface, uint x, uint y, uint width, uint height, uint x2, uint y2)
-{
-	// copy
-	const uint32_t *src = &((const uint32_t *)surface->ptr)[x + y * surface->stride];
-	uint32_t *dest = &((uint32_t *)surface->ptr)[x2 + y2 * surface->stride];
-	uint stride_diff = surface->stride - width;
+	uint pitch = surface->stride * surface->pixelsize;
+	uint len = width * surface->pixelsize;
+	const uint8_t *src = (const uint8_t *)surface->ptr + x * surface->pixelsize + y * pitch;
+	uint8_t *dest = (uint8_t *)surface->ptr + x2 * surface->pixelsize + y2 * pitch;
+	uint i;
 
 	if (dest < src) {
-		uint i, j;
 		for (i=0; i < height; i++) {
-			for (j=0; j < width; j++) {
-				*dest = *src;
-				dest++;
-				src++;
-			}
-			dest += stride_diff;
-			src += stride_diff;
+			memmove(dest, src, len);
+			dest += pitch;
+			src += pitch;
 		}
 	} else {
-		// copy backwards
-		src += height * surface->stride + width;
-		dest += height * surface->stride + width;
+		// copy backwards, bottom row first
+		src += (height - 1) * pitch;
+		dest += (height - 1) * pitch;
 
-		uint i, j;
 		for (i=0; i < height; i++) {
-			for (j=0; j < width; j++) {
-				*dest = *src;
-				dest--;
-				src--;
-			}
-			dest -= stride_diff;
-			src -= stride_diff;
+			memmove(dest, src, len);
+			dest -= pitch;
+			src -= pitch;
 		}
 	}
 }
 
-static void fillrect32(gfx_surface *surface, uint x, uint y, uint width, uint height, uint color)
+static void fillrect(gfx_surface *surface, uint x, uint y, uint width, uint height, uint color)
 {
-	uint32_t *dest = &((uint32_t *)surface->ptr)[x + y * surface->stride];
-	uint stride_diff = surface->stride - width;
-	
-	uint i, j;
-	for (i=0; i < height; i++) {
-		for (j=0; j < width; j++) {
-			*dest = color;
-			dest++;
-		}
-		dest += stride_diff;
+	uint pitch = surface->stride * surface->pixelsize;
+	uint len = width * surface->pixelsize;
+	uint8_t *first = (uint8_t *)surface->ptr + x * surface->pixelsize + y * pitch;
+	uint8_t *dest = first + pitch;
+	uint i;
+
+	// fill the first row, then replicate it
+	gfx_fill_row(first, surface->format, color, width);
+
+	for (i=1; i < height; i++) {
+		memcpy(dest, first, len);
+		dest += pitch;
 	}
 }
 
@@ -282,12 +231,11 @@ uint32_t alpha32_add_ignore_destalpha(uint32_t dest, uint32_t src)
 /**
  * @brief  Copy pixels from source to dest.
  *
- * Currently does not support alpha channel.
+ * ARGB 8888 sources are alpha blended onto the target, any other source
+ * format is converted to the target format and copied.
  */
 void gfx_surface_blend(struct gfx_surface *target, struct gfx_surface *source, uint destx, uint desty)
 {
-	DEBUG_ASSERT(target->format == source->format);
-
 	LTRACEF("target %p, source %p, destx %u, desty %u\n", target, source, destx, desty);
 
 	if (destx >= target->width)
@@ -303,67 +251,21 @@ void gfx_surface_blend(struct gfx_surface *target, struct gfx_surface *source, u
 	if (desty + height > target->height)
 		height = target->height - desty;
 
-	// XXX total hack to deal with various blends
-	if (source->format == GFX_FORMAT_RGB_565 && target->format == GFX_FORMAT_RGB_565) {
-		// 16 bit to 16 bit
-		const uint16_t *src = (const uint16_t *)source->ptr;
-		uint16_t *dest = &((uint16_t *)target->ptr)[destx + desty * target->stride];
-		uint dest_stride_diff = target->stride - width;
-		uint source_stride_diff = source->stride - width;
+	uint source_pitch = source->stride * source->pixelsize;
+	uint dest_pitch = target->stride * target->pixelsize;
+	const uint8_t *src = (const uint8_t *)source->ptr;
+	uint8_t *dest = (uint8_t *)target->ptr + (destx + desty * target->stride) * target->pixelsize;
 
-		LTRACEF("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
+	LTRACEF("w %u h %u dpitch %u spitch %u\n", width, height, dest_pitch, source_pitch);
 
-		uint i, j;
-		for (i=0; i < height; i++) {
-			for (j=0; j < width; j++) {
-				*dest = *src;
-				dest++;
-				src++;
-			}
-			dest += dest_stride_diff;
-			src += source_stride_diff;
-		}
-	} else if (source->format == GFX_FORMAT_ARGB_8888 && target->format == GFX_FORMAT_ARGB_8888) {
-		// both are 32 bit modes, both alpha
-		const uint32_t *src = (const uint32_t *)source->ptr;
-		uint32_t *dest = &((uint32_t *)target->ptr)[destx + desty * target->stride];
-		uint dest_stride_diff = target->stride - width;
-		uint source_stride_diff = source->stride - width;
-
-		LTRACEF("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
-
-		uint i, j;
-		for (i=0; i < height; i++) {
-			for (j=0; j < width; j++) {
-				// XXX ignores destination alpha
-				*dest = alpha32_add_ignore_destalpha(*dest, *src);
-				dest++;
-				src++;
-			}
-			dest += dest_stride_diff;
-			src += source_stride_diff;
-		}
-	} else if (source->format == GFX_FORMAT_RGB_x888 && target->format == GFX_FORMAT_RGB_x888) {
-		// both are 32 bit modes, no alpha
-		const uint32_t *src = (const uint32_t *)source->ptr;
-		uint32_t *dest = &((uint32_t *)target->ptr)[destx + desty * target->stride];
-		uint dest_stride_diff = target->stride - width;
-		uint source_stride_diff = source->stride - width;
-
-		LTRACEF("w %u h %u dstride %u sstride %u\n", width, height, dest_stride_diff, source_stride_diff);
-
-		uint i, j;
-		for (i=0; i < height; i++) {
-			for (j=0; j < width; j++) {
-				*dest = *src;
-				dest++;
-				src++;
-			}
-			dest += dest_stride_diff;
-			src += source_stride_diff;
-		}
-	} else {
-		panic("gfx_surface_blend: unimplemented colorspace combination (source %d target %d)\n", source->format, target->format);
+	uint i;
+	for (i=0; i < height; i++) {
+		if (source->format == GFX_FORMAT_ARGB_8888)
+			gfx_blend_row(dest, target->format, (const uint32_t *)src, width);
+		else
+			gfx_convert_row(dest, target->format, src, source->format, width);
+		dest += dest_pitch;
+		src += source_pitch;
 	}
 }
 
@@ -424,19 +326,14 @@ gfx_surface *gfx_create_surface(void *ptr, uint width, uint height, uint stride,
 	// set up some function pointers
 	switch (format) {
 		case GFX_FORMAT_RGB_565:
-			surface->copyrect = &copyrect16;
-			surface->fillrect = &fillrect16;
 			surface->putpixel = &putpixel16;
-			surface->pixelsize = 2;
-			surface->len = surface->height * surface->stride * surface->pixelsize;
+			break;
+		case GFX_FORMAT_RGB_888:
+			surface->putpixel = &putpixel24;
 			break;
 		case GFX_FORMAT_RGB_x888:
 		case GFX_FORMAT_ARGB_8888:
-			surface->copyrect = &copyrect32;
-			surface->fillrect = &fillrect32;
 			surface->putpixel = &putpixel32;
-			surface->pixelsize = 4;
-			surface->len = surface->height * surface->stride * surface->pixelsize;
 			break;
 		default:
 			dprintf(INFO, "invalid graphics format\n");
@@ -445,6 +342,11 @@ gfx_surface *gfx_create_surface(void *ptr, uint width, uint height, uint stride,
 			return NULL;
 	}
 
+	surface->copyrect = &copyrect;
+	surface->fillrect = &fillrect;
+	surface->pixelsize = gfx_format_pixelsize(format);
+	surface->len = surface->height * surface->stride * surface->pixelsize;
+
 	if (ptr == NULL) {
 		// allocate a buffer
 		ptr = malloc(surface->len);
@@ -582,10 +484,14 @@ static int cmd_gfx(int argc, const cmd_args *argv)
 usage:
 		printf("%s rgb_bars		: Fill frame buffer with rgb bars\n", argv[0].str);
 		printf("%s fill r g b	: Fill frame buffer with RGB565 value and force update\n", argv[0].str);
+		printf("%s bench		: Report fill/copy/blend/convert throughput\n", argv[0].str);
 
 		return -1;
 	}
 
+	if (!strcmp(argv[1].str, "bench"))
+		return gfx_bench();
+
 	struct display_info info;
 	display_get_info(&info);
 
@@ -1,4 +1,11 @@
 LOCAL_DIR := $(GET_LOCAL_DIR)
 
 OBJS += \
-	$(LOCAL_DIR)/gfx.o
+	$(LOCAL_DIR)/gfx.o \
+	$(LOCAL_DIR)/blit.o
+
+# ARM_WITH_NEON is set for cortex-a8 class cores in arch/arm/rules.mk
+ifeq ($(ARM_CPU),cortex-a8)
+OBJS += \
+	$(LOCAL_DIR)/blit_neon.o
+endif
@@ -314,8 +314,15 @@ OBJS += \
 	$(LOCAL_DIR)/x509v3/v3_sxnet.o \
 	$(LOCAL_DIR)/x509v3/v3err.o \
 	$(LOCAL_DIR)/x509v3/v3_utl.o \
-	$(LOCAL_DIR)/sha/asm/sha1-armv4-large.o \
-	$(LOCAL_DIR)/sha/asm/sha256-armv4.o
+	$(LOCAL_DIR)/sha/asm/sha1-armv4-large.o
+
+# ARMv7 cores take the sha256 flavour that uses rev on word aligned input
+ifeq ($(ARM_CPU),cortex-a8)
+SHA256_ASM_FLAVOUR ?= armv7
+else
+SHA256_ASM_FLAVOUR ?= armv4
+endif
+OBJS += $(LOCAL_DIR)/sha/asm/sha256-$(SHA256_ASM_FLAVOUR).o
 
 include $(LOCAL_PATH)/android-config.mk
 
@@ -13,7 +13,15 @@
 # lute" terms is ~2250 cycles per 64-byte block or ~35 cycles per
 # byte.
 
+# "armv7" flavour: word aligned input is fetched with ldr+rev, and the
+# first rotation of each Sigma function is folded into the add that
+# consumes it. ~10% fewer instructions per block. LK runs with alignment
+# faults enabled (SCTLR.A), so blocks that are not word aligned take a
+# second copy of rounds 0-15 that assembles the words with ldrb.
+
 $output=shift;
+$armv7=(shift eq "armv7");
+$arch=$armv7?"ARMv7":"ARMv4";
 open STDOUT,">$output";
 
 $ctx="r0";	$t0="r0";
@@ -40,7 +48,7 @@ $Ktbl="r14";
 sub BODY_00_15 {
 my ($i,$a,$b,$c,$d,$e,$f,$g,$h) = @_;
 
-$code.=<<___ if ($i<16);
+$code.=<<___ if ($i<16 && (!$armv7 || $bytewise));
 	ldrb	$T1,[$inp,#3]			@ $i
 	ldrb	$t2,[$inp,#2]
 	ldrb	$t1,[$inp,#1]
@@ -50,7 +58,34 @@ $code.=<<___ if ($i<16);
 	orr	$T1,$T1,$t0,lsl#24
 	`"str	$inp,[sp,#17*4]"	if ($i==15)`
 ___
-$code.=<<___;
+$code.=<<___ if ($i<16 && $armv7 && !$bytewise);
+	ldr	$T1,[$inp],#4			@ $i
+	`"str	$inp,[sp,#17*4]"	if ($i==15)`
+	rev	$T1,$T1
+___
+$code.=<<___ if ($armv7);
+	ldr	$t2,[$Ktbl],#4			@ *K256++
+	str	$T1,[sp,#`$i%16`*4]
+	eor	$t0,$e,$e,ror#`$Sigma1[1]-$Sigma1[0]`
+	eor	$t0,$t0,$e,ror#`$Sigma1[2]-$Sigma1[0]`
+	add	$T1,$T1,$t0,ror#$Sigma1[0]	@ Sigma1(e)
+	eor	$t1,$f,$g
+	and	$t1,$t1,$e
+	eor	$t1,$t1,$g			@ Ch(e,f,g)
+	add	$T1,$T1,$t1
+	add	$T1,$T1,$h
+	add	$T1,$T1,$t2
+	eor	$h,$a,$a,ror#`$Sigma0[1]-$Sigma0[0]`
+	eor	$h,$h,$a,ror#`$Sigma0[2]-$Sigma0[0]`
+	orr	$t0,$a,$b
+	and	$t0,$t0,$c
+	and	$t1,$a,$b
+	orr	$t0,$t0,$t1			@ Maj(a,b,c)
+	add	$h,$t0,$h,ror#$Sigma0[0]	@ Sigma0(a)
+	add	$d,$d,$T1
+	add	$h,$h,$T1
+___
+$code.=<<___ if (!$armv7);
 	ldr	$t2,[$Ktbl],#4			@ *K256++
 	str	$T1,[sp,#`$i%16`*4]
 	mov	$t0,$e,ror#$Sigma1[0]
@@ -133,7 +168,14 @@ sha256_block_data_order:
 	sub	sp,sp,#16*4		@ alloca(X[16])
 .Loop:
 ___
+if ($armv7) {
+	$code.="\ttst\t$inp,#3\n\tbne\t.Lunaligned\n";
+	for($i=0;$i<16;$i++)	{ &BODY_00_15($i,@V); unshift(@V,pop(@V)); }
+	$code.="\tb\t.Lrounds_16_xx\n.Lunaligned:\n";
+	$bytewise=1;
+}
 for($i=0;$i<16;$i++)	{ &BODY_00_15($i,@V); unshift(@V,pop(@V)); }
+$bytewise=0;
 $code.=".Lrounds_16_xx:\n";
 for (;$i<32;$i++)	{ &BODY_16_XX($i,@V); unshift(@V,pop(@V)); }
 $code.=<<___;
@@ -171,7 +213,7 @@ $code.=<<___;
 	moveq	pc,lr			@ be binary compatible with V4, yet
 	bx	lr			@ interoperable with Thumb ISA:-)
 .size   sha256_block_data_order,.-sha256_block_data_order
-.asciz  "SHA256 block transform for ARMv4, CRYPTOGAMS by <appro\@openssl.org>"
+.asciz  "SHA256 block transform for $arch, CRYPTOGAMS by <appro\@openssl.org>"
 .align	2
 ___
 
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2013, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <debug.h>
+#include <string.h>
+#include <printf.h>
+#include <err.h>
+#include <lib/profile.h>
+#include <kernel/thread.h>
+#include <kernel/timer.h>
+
+volatile addr_t profile_irq_pc;
+
+static struct profile_sample samples[PROFILE_MAX_SAMPLES];
+static unsigned sample_count;
+static unsigned sample_dropped;
+
+/* threads seen while sampling, the names are copied so the table stays
+ * valid after a thread exits */
+static struct {
+	thread_t *thread;
+	char name[sizeof(((thread_t *) 0)->name)];
+} threads[PROFILE_MAX_THREADS];
+static unsigned thread_count;
+
+static timer_t profile_timer;
+static bool running;
+
+static unsigned profile_thread_index(thread_t *t)
+{
+	unsigned i;
+
+	for (i = 0; i < thread_count; i++)
+		if (threads[i].thread == t)
+			return i;
+
+	/* the last slot collects everything that does not fit */
+	if (thread_count == PROFILE_MAX_THREADS)
+		return PROFILE_MAX_THREADS - 1;
+
+	threads[i].thread = t;
+	strlcpy(threads[i].name, t->name, sizeof(threads[i].name));
+	thread_count++;
+
+	return i;
+}
+
+/* runs from the timer interrupt, so profile_irq_pc is the interrupted PC */
+static enum handler_return profile_tick(struct timer *t, time_t now, void *arg)
+{
+	struct profile_sample *s;
+
+	if (sample_count == PROFILE_MAX_SAMPLES) {
+		sample_dropped++;
+		return INT_NO_RESCHEDULE;
+	}
+
+	s = &samples[sample_count++];
+	s->pc = profile_irq_pc;
+	s->thread = profile_thread_index(current_thread);
+
+	return INT_NO_RESCHEDULE;
+}
+
+int profile_start(time_t period)
+{
+	if (period == 0)
+		period = PROFILE_DEFAULT_PERIOD;
+
+	enter_critical_section();
+
+	if (running) {
+		exit_critical_section();
+		return ERR_ALREADY_STARTED;
+	}
+
+	sample_count = 0;
+	sample_dropped = 0;
+	thread_count = 0;
+
+	timer_initialize(&profile_timer);
+	timer_set_periodic(&profile_timer, period, &profile_tick, NULL);
+	running = true;
+
+	exit_critical_section();
+
+	return NO_ERROR;
+}
+
+void profile_stop(void)
+{
+	enter_critical_section();
+
+	if (running) {
+		timer_cancel(&profile_timer);
+		running = false;
+	}
+
+	exit_critical_section();
+}
+
+bool profile_running(void)
+{
+	return running;
+}
+
+unsigned profile_sample_count(void)
+{
+	return sample_count;
+}
+
+const struct profile_sample *profile_get_samples(void)
+{
+	return samples;
+}
+
+const char *profile_thread_name(unsigned index)
+{
+	if (index >= thread_count)
+		return "?";
+	return threads[index].name;
+}
+
+/* shell sort the samples by PC so equal PCs form runs */
+static void profile_sort(void)
+{
+	static const unsigned gaps[] = { 701, 301, 132, 57, 23, 10, 4, 1 };
+	struct profile_sample tmp;
+	unsigned g, i, j;
+
+	for (g = 0; g < sizeof(gaps) / sizeof(gaps[0]); g++) {
+		unsigned gap = gaps[g];
+
+		for (i = gap; i < sample_count; i++) {
+			tmp = samples[i];
+			for (j = i; j >= gap && samples[j - gap].pc > tmp.pc; j -= gap)
+				samples[j] = samples[j - gap];
+			samples[j] = tmp;
+		}
+	}
+}
+
+/* length of the run of equal PCs starting at index */
+static unsigned profile_run(unsigned index)
+{
+	unsigned end = index;
+
+	while (end < sample_count && samples[end].pc == samples[index].pc)
+		end++;
+
+	return end - index;
+}
+
+void profile_dump(unsigned top)
+{
+	unsigned per_thread[PROFILE_MAX_THREADS];
+	unsigned i, n, best, best_len, len, last_len;
+	addr_t last_pc;
+
+	if (running) {
+		printf("profiler is running, stop it first\n");
+		return;
+	}
+
+	printf("%u samples", sample_count);
+	if (sample_dropped)
+		printf(" (%u dropped, buffer full)", sample_dropped);
+	printf("\n");
+
+	if (!sample_count)
+		return;
+
+	memset(per_thread, 0, sizeof(per_thread));
+	for (i = 0; i < sample_count; i++)
+		per_thread[samples[i].thread]++;
+
+	printf("\nthread                           samples\n");
+	for (i = 0; i < thread_count; i++)
+		printf("%-32s %7u %3u%%\n", threads[i].name, per_thread[i],
+		       per_thread[i] * 100 / sample_count);
+
+	profile_sort();
+
+	/* pick the hottest runs in descending order, no extra storage:
+	 * each pass finds the longest run that is shorter than (or tied
+	 * with but after) the one printed before it */
+	printf("\n samples      pc  (symbolize with scripts/profile-symbolize and lk.sym)\n");
+	last_len = ~0u;
+	last_pc = 0;
+	for (n = 0; n < top; n++) {
+		best = sample_count;
+		best_len = 0;
+		for (i = 0; i < sample_count; i += len) {
+			len = profile_run(i);
+			if (len > last_len ||
+			    (len == last_len && samples[i].pc <= last_pc))
+				continue;
+			if (len > best_len) {
+				best = i;
+				best_len = len;
+			}
+		}
+		if (best == sample_count)
+			break;
+
+		printf("%8u  0x%08lx %3u%%\n", best_len, samples[best].pc,
+		       best_len * 100 / sample_count);
+		last_len = best_len;
+		last_pc = samples[best].pc;
+	}
+}
+
+#if defined(WITH_LIB_CONSOLE)
+
+#include <lib/console.h>
+
+static int cmd_profile(int argc, const cmd_args *argv)
+{
+	if (argc < 2) {
+usage:
+		printf("usage:\n");
+		printf("%s start [period ms]\n", argv[0].str);
+		printf("%s stop\n", argv[0].str);
+		printf("%s dump [entries]\n", argv[0].str);
+		return -1;
+	}
+
+	if (!strcmp(argv[1].str, "start")) {
+		if (profile_start(argc > 2 ? argv[2].u : 0) < 0) {
+			printf("profiler already running\n");
+			return -1;
+		}
+	} else if (!strcmp(argv[1].str, "stop")) {
+		profile_stop();
+	} else if (!strcmp(argv[1].str, "dump")) {
+		profile_dump(argc > 2 ? argv[2].u : 20);
+	} else {
+		goto usage;
+	}
+
+	return 0;
+}
+
+STATIC_COMMAND_START
+STATIC_COMMAND("profile", "sampling profiler", &cmd_profile)
+STATIC_COMMAND_END(profile);
+
+#endif
@@ -1,4 +1,7 @@
 LOCAL_DIR := $(GET_LOCAL_DIR)
 
+MODULES += \
+	lib/gfx
+
 OBJS += \
 	$(LOCAL_DIR)/tga.o
@@ -29,6 +29,9 @@
  */
 
 #include <debug.h>
+#include <err.h>
+#include <string.h>
+#include <stdlib.h>
 #include <compiler.h>
 #include <lib/tga.h>
 
@@ -66,165 +69,326 @@ static void print_tga_info(const struct tga_header *header)
 
 }
 
-static void decode_2byte(gfx_surface *surface, uint x, uint y, const void *input)
+#define TGA_CHUNK	64
+
+/* where and how decoded rows are written */
+struct tga_output {
+	gfx_surface *surface;
+	uint destx;
+	uint desty;
+	uint width;		/* image columns that land inside the surface */
+	uint height;		/* image rows */
+	uint bpp;		/* bytes per input pixel */
+	bool flip;		/* image is stored bottom row first */
+	bool blend;		/* blend 32 bit pixels instead of copying them */
+};
+
+/* convert count input pixels to ARGB 8888 */
+static void tga_load_pixels(uint32_t *dest, const uint8_t *in, uint bpp, uint count)
 {
-	const uint8_t *in = (const uint8_t *)input;
+	uint r, g, b;
+
+	switch (bpp) {
+		case 2:
+			/* x1555, little endian */
+			while (count--) {
+				uint p = in[0] | (in[1] << 8);
+
+				r = (p >> 10) & 0x1f;
+				g = (p >> 5) & 0x1f;
+				b = p & 0x1f;
+				*dest++ = 0xff000000 | ((r << 3 | r >> 2) << 16) |
+					((g << 3 | g >> 2) << 8) | (b << 3 | b >> 2);
+				in += 2;
+			}
+			break;
+		case 3:
+			while (count--) {
+				*dest++ = 0xff000000 | in[2] << 16 | in[1] << 8 | in[0];
+				in += 3;
+			}
+			break;
+		case 4:
+			memcpy(dest, in, count * 4);
+			break;
+	}
+}
+
+/*
+ * Return the surface address of image column x in image row y, clipping
+ * count to the visible part of the row.  NULL if nothing is visible.
+ */
+static uint8_t *tga_span_dest(const struct tga_output *out, uint x, uint y, uint *count)
+{
+	gfx_surface *surface = out->surface;
+	uint row;
 
-//	printf("in 0x%hhx 0x%hhx\n", in[0], in[1]);
-	uint r,g,b;
+	if (out->flip)
+		y = out->height - 1 - y;
+	row = out->desty + y;
 
-	b = (in[0] & 0x1f) << 3;
-	g = (((in[0] >> 5) & 0x7) | ((in[1] & 0x3) << 3)) << 3;
-	r = ((in[1] >> 2) & 0x1f) << 3;
+	if (row >= surface->height || x >= out->width)
+		return NULL;
+	if (x + *count > out->width)
+		*count = out->width - x;
 
-	gfx_putpixel(surface, x, y, 0xff000000 | r << 16 | g << 8 | b);
+	return (uint8_t *)surface->ptr +
+		((row * surface->stride) + out->destx + x) * surface->pixelsize;
 }
 
-static void decode_3byte(gfx_surface *surface, uint x, uint y, const void *input)
+static void tga_write_argb(const struct tga_output *out, void *dest, const uint32_t *pixels, uint count)
 {
-	const uint8_t *in = (const uint8_t *)input;
-
-//	printf("in 0x%hhx 0x%hhx\n", in[0], in[1]);
-
-	gfx_putpixel(surface, x, y, 0xff000000 | in[2] << 16 | in[1] << 8 | in[0]);
+	if (out->blend)
+		gfx_blend_row(dest, out->surface->format, pixels, count);
+	else
+		gfx_convert_row(dest, out->surface->format, pixels, GFX_FORMAT_ARGB_8888, count);
 }
 
-static void decode_4byte(gfx_surface *surface, uint x, uint y, const void *input)
+/* write a span of raw input pixels */
+static void tga_put_span(const struct tga_output *out, uint x, uint y, const uint8_t *in, uint count)
 {
-	const uint8_t *in = (const uint8_t *)input;
+	uint32_t tmp[TGA_CHUNK];
+	uint8_t *dest = tga_span_dest(out, x, y, &count);
 
-//	printf("in 0x%hhx 0x%hhx 0x%hhx 0x%hhx\n", in[0], in[1], in[2], in[3]);
+	if (!dest)
+		return;
 
-	if (in[3] == 0)
-		gfx_putpixel(surface, x, y, 0);
-	else
-		gfx_putpixel(surface, x, y, in[3] << 24 | in[2] << 16 | in[1] << 8 | in[0]);
+	/* 24 and aligned 32 bit input are already a gfx format */
+	if (out->bpp == 3) {
+		gfx_convert_row(dest, out->surface->format, in, GFX_FORMAT_RGB_888, count);
+		return;
+	}
+	if (out->bpp == 4 && ((addr_t)in & 3) == 0) {
+		tga_write_argb(out, dest, (const uint32_t *)in, count);
+		return;
+	}
+
+	while (count) {
+		uint n = MIN(count, TGA_CHUNK);
+
+		tga_load_pixels(tmp, in, out->bpp, n);
+		tga_write_argb(out, dest, tmp, n);
+
+		dest += n * out->surface->pixelsize;
+		in += n * out->bpp;
+		count -= n;
+	}
 }
 
-/**
- * @brief  Decode a tga image
- *
- * @param  ptr  Pointer to tga data in memory
- * @param  len  Length of tga data
- * @param  format  Desired format of returned graphics surface
- *
- * @return Graphics surface or NULL on error.
- *
- * @ingroup graphics
- */
-gfx_surface *tga_decode(const void *ptr, size_t len, gfx_format format)
+/* write count copies of one input pixel */
+static void tga_fill_span(const struct tga_output *out, uint x, uint y, const uint8_t *in, uint count)
 {
-	const struct tga_header *header = (const struct tga_header *)ptr;
+	uint32_t tmp[TGA_CHUNK];
+	uint32_t color;
+	uint8_t *dest = tga_span_dest(out, x, y, &count);
 
-	LTRACEF("ptr %p, len %zu\n", ptr, len);
+	if (!dest)
+		return;
 
-#if LOCAL_TRACE > 0
-	print_tga_info(header);
-#endif
+	tga_load_pixels(&color, in, out->bpp, 1);
+
+	if (!out->blend || (color >> 24) == 0xff) {
+		gfx_fill_row(dest, out->surface->format, color, count);
+		return;
+	}
+	if ((color >> 24) == 0)
+		return;
+
+	for (uint i = 0; i < MIN(count, TGA_CHUNK); i++)
+		tmp[i] = color;
 
-	/* do some sanity checks */
+	while (count) {
+		uint n = MIN(count, TGA_CHUNK);
+
+		gfx_blend_row(dest, out->surface->format, tmp, n);
+
+		dest += n * out->surface->pixelsize;
+		count -= n;
+	}
+}
+
+static int tga_check_header(const struct tga_header *header, size_t len)
+{
+	if (len < sizeof(struct tga_header)) {
+		dprintf(INFO, "tga_decode: short image\n");
+		return ERR_NOT_VALID;
+	}
 	if (header->datatypecode != 2 && header->datatypecode != 10) {
 		dprintf(INFO, "tga_decode: unknown data type %d\n", header->datatypecode);
-		return NULL;
+		return ERR_NOT_SUPPORTED;
 	}
 	if (header->bitsperpixel != 16 && header->bitsperpixel != 24 && header->bitsperpixel != 32) {
 		dprintf(INFO, "tga_decode: unsupported bits per pixel %d\n", header->bitsperpixel);
-		return NULL;
+		return ERR_NOT_SUPPORTED;
 	}
 	if (header->colormaptype != 0) {
 		dprintf(INFO, "tga_decode: has colormap, can't handle\n");
-		return NULL;
+		return ERR_NOT_SUPPORTED;
 	}
 
-	const void *imagestart = ((const uint8_t *)ptr + sizeof(struct tga_header) + header->idlength);
+	return NO_ERROR;
+}
 
-	/* create a surface to hold the decoded bits */
-	gfx_surface *surface = gfx_create_surface(NULL, header->width, header->height, header->width, format);
-	DEBUG_ASSERT(surface);
+/* decode the image data of a checked header a span at a time */
+static int tga_decode_rows(const struct tga_header *header, size_t len, struct tga_output *out)
+{
+	const uint8_t *in = (const uint8_t *)header + sizeof(struct tga_header) + header->idlength;
+	const uint8_t *end = (const uint8_t *)header + len;
+	uint width = header->width;
+	uint bpp = out->bpp;
+	uint y;
 
-	/* copy the bits out */
-	void (*decodefunc)(gfx_surface *, uint x, uint y, const void *) = NULL;
-
-	uint step = 1;
-	if (header->bitsperpixel == 16) {
-		step = 2;
-		decodefunc = decode_2byte;
-	} else if (header->bitsperpixel == 24) {
-		step = 3;
-		decodefunc = decode_3byte;
-	} else if (header->bitsperpixel == 32) {
-		step = 4;
-		decodefunc = decode_4byte;
-	}
+	if (in > end)
+		return ERR_NOT_VALID;
 
 	if (header->datatypecode == 2) {
 		/* no RLE */
-		uint pos = 0;
-		uint x, y;
-		uint surfacey;
+		if ((size_t)(end - in) < (size_t)width * header->height * bpp)
+			return ERR_NOT_VALID;
 
 		for (y = 0; y < header->height; y++) {
+			tga_put_span(out, 0, y, in, width);
+			in += width * bpp;
+		}
+	} else {
+		/* RLE compression, runs may cross row boundaries */
+		uint x = 0;
 
-			if ((header->imagedescriptor & (1 << 5)) == 0)
-				surfacey = (surface->height - 1) - y;
-			else
-				surfacey = y;
+		y = 0;
+		while (y < header->height) {
+			if (in >= end)
+				return ERR_NOT_VALID;
 
-			for (x = 0; x < header->width; x++) {
-				decodefunc(surface, x, surfacey, (const uint8_t *)imagestart + pos);
-				pos += step;
-			}
-		}
-	} else if (header->datatypecode == 10) {
-		/* RLE compression */
-		uint pos = 0;
-		uint count = 0;
-		uint x, y;
-
-		x = 0;
-		if ((header->imagedescriptor & (1 << 5)) == 0)
-			y = header->height - 1;
-		else
-			y = 0;
-
-		while (count < (uint)header->height * (uint)header->width) {
-			uint runpos;
-
-			uint8_t run = *((const uint8_t *)imagestart + pos);
+			uint8_t run = *in++;
 			bool repeat_run = (run & 0x80);
 			uint runlen = (run & 0x7f) + 1;
 
-//			printf("pos 0x%x count %u run 0x%hhx runtype %d runlen %u\n", pos, count, run, run & 0x80, runlen);
+			if ((size_t)(end - in) < (repeat_run ? 1 : runlen) * bpp)
+				return ERR_NOT_VALID;
 
-			/* consume the run byte */
-			pos++;
+			while (runlen && y < header->height) {
+				uint n = MIN(runlen, width - x);
 
-			/* start of a run */
-			for (runpos = 0; runpos < runlen; runpos++) {
-				decodefunc(surface, x, y, (const uint8_t *)imagestart + pos);
-				count++;
+				if (repeat_run) {
+					tga_fill_span(out, x, y, in, n);
+				} else {
+					tga_put_span(out, x, y, in, n);
+					in += n * bpp;
+				}
 
-				x++;
-				if (x == surface->width) {
-					if ((header->imagedescriptor & (1 << 5)) == 0)
-						y--;
-					else
-						y++;
+				runlen -= n;
+				x += n;
+				if (x == width) {
 					x = 0;
+					y++;
 				}
-
-				/* if a run of raw pixels, consume an input pixel */
-				if (!repeat_run)
-					pos += step;
 			}
-			/* if this was a run of repeated pixels, consume the one input pixel we repeated */
-			if (repeat_run)
-				pos += step;
 
+			/* consume the one input pixel we repeated */
+			if (repeat_run)
+				in += bpp;
 		}
-//		printf("done with RLE: x %d, y %d, pos %d, count %d\n", x, y, pos, count);
 	}
-	
+
+	return NO_ERROR;
+}
+
+static void tga_setup_output(const struct tga_header *header, struct tga_output *out,
+		gfx_surface *surface, uint x, uint y)
+{
+	out->surface = surface;
+	out->destx = x;
+	out->desty = y;
+	out->width = MIN((uint)header->width, surface->width - x);
+	out->height = header->height;
+	out->bpp = header->bitsperpixel / 8;
+	out->flip = (header->imagedescriptor & (1 << 5)) == 0;
+}
+
+/**
+ * @brief  Decode a tga image
+ *
+ * @param  ptr  Pointer to tga data in memory
+ * @param  len  Length of tga data
+ * @param  format  Desired format of returned graphics surface
+ *
+ * @return Graphics surface or NULL on error.
+ *
+ * @ingroup graphics
+ */
+gfx_surface *tga_decode(const void *ptr, size_t len, gfx_format format)
+{
+	const struct tga_header *header = (const struct tga_header *)ptr;
+	struct tga_output out;
+
+	LTRACEF("ptr %p, len %zu\n", ptr, len);
+
+	if (tga_check_header(header, len))
+		return NULL;
+
+#if LOCAL_TRACE > 0
+	print_tga_info(header);
+#endif
+
+	/* create a surface to hold the decoded bits */
+	gfx_surface *surface = gfx_create_surface(NULL, header->width, header->height, header->width, format);
+	DEBUG_ASSERT(surface);
+
+	tga_setup_output(header, &out, surface, 0, 0);
+	out.blend = false;
+
+	if (tga_decode_rows(header, len, &out)) {
+		dprintf(INFO, "tga_decode: truncated image data\n");
+		gfx_surface_destroy(surface);
+		return NULL;
+	}
+
 	return surface;
 }
 
+/**
+ * @brief  Decode a tga image straight into an existing surface
+ *
+ * The image is placed with its top left corner at x, y and clipped to the
+ * surface.  32 bit images are alpha blended onto the surface contents, so
+ * this replaces a tga_decode() plus gfx_surface_blend() pair without the
+ * intermediate surface.
+ *
+ * @param  ptr  Pointer to tga data in memory
+ * @param  len  Length of tga data
+ * @param  surface  Surface to draw into, e.g. the display framebuffer
+ * @param  x  Destination column
+ * @param  y  Destination row
+ *
+ * @return NO_ERROR on success.
+ *
+ * @ingroup graphics
+ */
+int tga_decode_to_surface(const void *ptr, size_t len, gfx_surface *surface, uint x, uint y)
+{
+	const struct tga_header *header = (const struct tga_header *)ptr;
+	struct tga_output out;
+	int ret;
+
+	LTRACEF("ptr %p, len %zu, surface %p, x %u y %u\n", ptr, len, surface, x, y);
+
+	ret = tga_check_header(header, len);
+	if (ret)
+		return ret;
+
+#if LOCAL_TRACE > 0
+	print_tga_info(header);
+#endif
+
+	if (x >= surface->width || y >= surface->height)
+		return NO_ERROR;
+
+	tga_setup_output(header, &out, surface, x, y);
+	out.blend = true;
+
+	ret = tga_decode_rows(header, len, &out);
+	if (ret)
+		dprintf(INFO, "tga_decode: truncated image data\n");
+
+	return ret;
+}
@@ -23,6 +23,7 @@
 #include <err.h>
 #include <debug.h>
 #include <platform.h>
+#include <smp.h>
 
 /*
  * default implementations of these routines, if the platform code
@@ -72,3 +73,12 @@ __WEAK int image_verify(unsigned char * image_ptr,
 __WEAK ce_clock_init(void)
 {
 }
+
+__WEAK status_t platform_cpu_start(unsigned cpu, addr_t entry)
+{
+	return ERR_NOT_SUPPORTED;
+}
+
+__WEAK void platform_cpu_park(unsigned cpu)
+{
+}
@@ -73,8 +73,9 @@ int available_scratch_mem = 0;
 void platform_init_mmu_mappings(void)
 {
     uint32_t i;
-    uint32_t sections;
+    uint32_t count = 0;
     struct smem_ram_ptable ram_ptable;
+    struct mmu_region regions[ARRAY_SIZE(ram_ptable.parts)];
     uint32_t vaddress = 0;
 
     if (smem_ram_ptable_init(&ram_ptable)) {
@@ -83,19 +84,21 @@ void platform_init_mmu_mappings(void)
                  && (ram_ptable.parts[i].domain == APPS_DOMAIN)
                  && (ram_ptable.parts[i].start != 0x0)
                  && (!(ram_ptable.parts[i].size < MB))) {
-                sections = ram_ptable.parts[i].size >> 20;
                 if (vaddress == 0) {
                     vaddress = ROUND_TO_MB(ram_ptable.parts[i].start);
                 }
 
-                while (sections--) {
-                    arm_mmu_map_section(ROUND_TO_MB(ram_ptable.parts[i].start) + sections*MB,
-                    vaddress + sections*MB, ALL_MEMORY);
-                }
+                regions[count].paddr = ROUND_TO_MB(ram_ptable.parts[i].start);
+                regions[count].vaddr = vaddress;
+                regions[count].size = ROUND_TO_MB(ram_ptable.parts[i].size);
+                regions[count].flags = ALL_MEMORY;
+                count++;
+
                 vaddress += ROUND_TO_MB(ram_ptable.parts[i].size);
                 available_scratch_mem += ROUND_TO_MB(ram_ptable.parts[i].size);
             }
         }
+        arm_mmu_map_regions(regions, count);
     } else {
         dprintf(CRITICAL, "ERROR: Unable to read RAM partition\n");
         ASSERT(0);
@@ -66,6 +66,8 @@
 
 #define MSM_GIC_CPU_BASE    0x02002000
 #define MSM_VIC_BASE        0x02080000
+#define MSM_ACC0_BASE       0x02088000
+#define MSM_SAW1_BASE       0x02099000
 #define MSM_USB_BASE        0x12500000
 #define TLMM_BASE_ADDR      0x00800000
 
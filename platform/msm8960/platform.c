@@ -36,7 +36,12 @@
 #include <dev/fbcon.h>
 #include <mmu.h>
 #include <arch/arm/mmu.h>
+#include <arch/arm.h>
 #include <board.h>
+#include <err.h>
+#include <smp.h>
+#include <scm.h>
+#include <platform/timer.h>
 
 extern void platform_init_timer(void);
 extern void platform_panel_backlight_on(void);
@@ -76,13 +81,13 @@ static uint8_t display_enabled = 0;
 #define IMEM_MEMORY       (MMU_MEMORY_TYPE_STRONGLY_ORDERED | \
                            MMU_MEMORY_AP_READ_WRITE | MMU_MEMORY_XN)
 
-mmu_section_t mmu_section_table[] = {
-/*  Physical addr,    Virtual addr,    Size (in MB),    Flags */
-	{MEMBASE, MEMBASE, (MEMSIZE / MB), LK_MEMORY},
-	{BASE_ADDR, BASE_ADDR, 44, KERNEL_MEMORY},
-	{SCRATCH_ADDR, SCRATCH_ADDR, 128, SCRATCH_MEMORY},
-	{MSM_IOMAP_BASE, MSM_IOMAP_BASE, MSM_IOMAP_SIZE, IOMAP_MEMORY},
-	{MSM_IMEM_BASE, MSM_IMEM_BASE, 1, IMEM_MEMORY},
+static const struct mmu_region mmu_region_table[] = {
+/*  Physical addr,    Virtual addr,    Size (in bytes),    Flags */
+	{MEMBASE, MEMBASE, MEMSIZE, LK_MEMORY},
+	{BASE_ADDR, BASE_ADDR, 44 * MB, KERNEL_MEMORY},
+	{SCRATCH_ADDR, SCRATCH_ADDR, 128 * MB, SCRATCH_MEMORY},
+	{MSM_IOMAP_BASE, MSM_IOMAP_BASE, MSM_IOMAP_SIZE * MB, IOMAP_MEMORY},
+	{MSM_IMEM_BASE, MSM_IMEM_BASE, MB, IMEM_MEMORY},
 };
 
 void platform_early_init(void)
@@ -107,24 +112,76 @@ void platform_uninit(void)
 	platform_uninit_timer();
 }
 
+#if WITH_SMP
+#define ACC_CPU_PWR_CTL(cpu)   (MSM_ACC0_BASE + (cpu) * 0x10000 + 0x04)
+#define SAW_VCTL(cpu)          (MSM_SAW1_BASE + ((cpu) - 1) * 0x10000 + 0x14)
+
+/* Powers up the second krait and releases it from reset, the same
+ * sequence the kernel uses to bring up cpu1.
+ */
+status_t platform_cpu_start(unsigned cpu, addr_t entry)
+{
+	if (cpu != 1)
+		return ERR_NOT_SUPPORTED;
+
+	if (scm_set_boot_addr(entry, SCM_FLAG_COLDBOOT_CPU1))
+		return ERR_NOT_ALLOWED;
+
+	/* turn on the cpu rail */
+	writel(0xA4, SAW_VCTL(cpu));
+	dsb();
+	udelay(10);
+
+	writel(0x109, ACC_CPU_PWR_CTL(cpu));
+	writel(0x101, ACC_CPU_PWR_CTL(cpu));
+	dsb();
+	udelay(1);
+	writel(0x121, ACC_CPU_PWR_CTL(cpu));
+	dsb();
+	udelay(2);
+	writel(0x120, ACC_CPU_PWR_CTL(cpu));
+	dsb();
+	udelay(2);
+	writel(0x100, ACC_CPU_PWR_CTL(cpu));
+	dsb();
+	udelay(100);
+	writel(0x180, ACC_CPU_PWR_CTL(cpu));
+	dsb();
+
+	return NO_ERROR;
+}
+
+/* Runs the release sequence above backwards, leaving the core clamped
+ * and out of execution with ACC_CPU_PWR_CTL at 0x109, the value the
+ * kernel's release of cpu1 starts from. The rail stays on, the kernel
+ * sets it again.
+ */
+void platform_cpu_park(unsigned cpu)
+{
+	if (cpu != 1)
+		return;
+
+	writel(0x100, ACC_CPU_PWR_CTL(cpu));
+	dsb();
+	udelay(2);
+	writel(0x120, ACC_CPU_PWR_CTL(cpu));
+	dsb();
+	udelay(2);
+	writel(0x121, ACC_CPU_PWR_CTL(cpu));
+	dsb();
+	udelay(2);
+	writel(0x101, ACC_CPU_PWR_CTL(cpu));
+	dsb();
+	udelay(1);
+	writel(0x109, ACC_CPU_PWR_CTL(cpu));
+	dsb();
+}
+#endif
+
 /* Setup memory for this platform */
 void platform_init_mmu_mappings(void)
 {
-	uint32_t i;
-	uint32_t sections;
-	uint32_t table_size = ARRAY_SIZE(mmu_section_table);
-
-	for (i = 0; i < table_size; i++) {
-		sections = mmu_section_table[i].num_of_sections;
-
-		while (sections--) {
-			arm_mmu_map_section(mmu_section_table[i].paddress +
-					    sections * MB,
-					    mmu_section_table[i].vaddress +
-					    sections * MB,
-					    mmu_section_table[i].flags);
-		}
-	}
+	arm_mmu_map_regions(mmu_region_table, ARRAY_SIZE(mmu_region_table));
 }
 
 /* Initialize DGT timer */
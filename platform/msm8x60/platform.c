@@ -69,12 +69,12 @@ static uint32_t ticks_per_sec = 0;
 
 #define MSM_IOMAP_SIZE ((MSM_IOMAP_END - MSM_IOMAP_BASE)/MB)
 
-mmu_section_t mmu_section_table[] = {
-/*  Physical addr,    Virtual addr,    Size (in MB),   Flags */
-	{MEMBASE, MEMBASE, (MEMSIZE / MB), LK_MEMORY},
-	{BASE_ADDR, BASE_ADDR, 44, KERNEL_MEMORY},
-	{SCRATCH_ADDR, SCRATCH_ADDR, 128, SCRATCH_MEMORY},
-	{MSM_IOMAP_BASE, MSM_IOMAP_BASE, MSM_IOMAP_SIZE, IOMAP_MEMORY},
+static const struct mmu_region mmu_region_table[] = {
+/*  Physical addr,    Virtual addr,    Size (in bytes),    Flags */
+	{MEMBASE, MEMBASE, MEMSIZE, LK_MEMORY},
+	{BASE_ADDR, BASE_ADDR, 44 * MB, KERNEL_MEMORY},
+	{SCRATCH_ADDR, SCRATCH_ADDR, 128 * MB, SCRATCH_MEMORY},
+	{MSM_IOMAP_BASE, MSM_IOMAP_BASE, MSM_IOMAP_SIZE * MB, IOMAP_MEMORY},
 };
 
 #define CONVERT_ENDIAN_U32(val)                   \
@@ -215,21 +215,7 @@ uint32_t platform_id_read(void)
 /* Setup memory for this platform */
 void platform_init_mmu_mappings(void)
 {
-	uint32_t i;
-	uint32_t sections;
-	uint32_t table_size = ARRAY_SIZE(mmu_section_table);
-
-	for (i = 0; i < table_size; i++) {
-		sections = mmu_section_table[i].num_of_sections;
-
-		while (sections--) {
-			arm_mmu_map_section(mmu_section_table[i].paddress +
-					    sections * MB,
-					    mmu_section_table[i].vaddress +
-					    sections * MB,
-					    mmu_section_table[i].flags);
-		}
-	}
+	arm_mmu_map_regions(mmu_region_table, ARRAY_SIZE(mmu_region_table));
 }
 
 /* Do any platform specific cleanup just before kernel entry */
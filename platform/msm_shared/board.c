@@ -36,7 +36,8 @@ static struct board_data board = {UNKNOWN,
 	HW_PLATFORM_UNKNOWN,
 	HW_PLATFORM_SUBTYPE_UNKNOWN,
 	LINUX_MACHTYPE_UNKNOWN,
-	BASEBAND_MSM};
+	BASEBAND_MSM,
+	0};
 
 static void platform_detect()
 {
@@ -64,6 +65,7 @@ static void platform_detect()
 		board.platform = board_info_v6.board_info_v3.msm_id;
 		board.platform_hw = board_info_v6.board_info_v3.hw_platform;
 		board.platform_subtype = board_info_v6.platform_subtype;
+		board.soc_version = board_info_v6.board_info_v3.msm_version;
 	}
 	else if (format == 7)
 	{
@@ -78,6 +80,7 @@ static void platform_detect()
 		board.platform = board_info_v7.board_info_v3.msm_id;
 		board.platform_hw = board_info_v7.board_info_v3.hw_platform;
 		board.platform_subtype = board_info_v7.platform_subtype;
+		board.soc_version = board_info_v7.board_info_v3.msm_version;
 
 	}
 	else
@@ -113,3 +116,8 @@ uint32_t board_hardware_id()
 {
 	return board.platform_hw;
 }
+
+uint32_t board_soc_version()
+{
+	return board.soc_version;
+}
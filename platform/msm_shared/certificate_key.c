@@ -0,0 +1,64 @@
+/* Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+/*
+ * Generated from certBuffer by scripts/mkcertkey.pl, do not edit.
+ */
+#include <certificate.h>
+
+const struct certificate_key certKey = {
+	.num = 64,
+	.n0 = 0x40c824f5,
+	.e = 3,
+	.n = {
+		0x34c398a3, 0x1c30171e, 0xb8fcf9cb, 0xb4e3868f, 0x6c84a258, 0xd43b7df0,
+		0x718b7946, 0xa6b747b3, 0x301138ae, 0x4324ace6, 0x9d9f9d01, 0x4f19000f,
+		0x8212f1bc, 0x07ada2e1, 0x35cd6fc2, 0xb8bbc713, 0x9e53d0a2, 0x3d5880c7,
+		0xfc868da1, 0x05763b8b, 0xe86f0290, 0x9806d04f, 0xd586ec39, 0xa923461a,
+		0xa2db4632, 0x378a4cdd, 0xd3a2d3e2, 0x8580ad14, 0x1753f26a, 0xad228a10,
+		0x2edd9d33, 0xf4b399e7, 0x5652e270, 0x8681cc56, 0x9531a992, 0x993a1c76,
+		0x9d118f36, 0x5e16abf5, 0x0a125f76, 0xda54d3bc, 0x47282ba9, 0x58df5e8a,
+		0xb0f4e135, 0xb7f0322d, 0xacaaabfc, 0x04538864, 0xc9d1cc42, 0x38deaca1,
+		0x773d9379, 0x8ee95f57, 0x72a6b126, 0x4dd7ed27, 0x0ecd85a0, 0x1d3b0a91,
+		0xaa8221d3, 0x8e8e1bfa, 0x7f0bc101, 0xf0cd66eb, 0xfa85975f, 0xe215ab71,
+		0x92a9260c, 0xcaa143c1, 0x843391fa, 0xc8820943,
+	},
+	.rr = {
+		0xef148919, 0x7ca9f7e2, 0x65b26f7c, 0x81b3adea, 0x8f4841a7, 0xac4d8273,
+		0x9bef0728, 0xba79334c, 0x0b9449ed, 0x886d8ac6, 0x1ded6f45, 0xb741a5f3,
+		0xfe231a18, 0x7936f06d, 0x47d351e7, 0x5483ddca, 0x186dfeb1, 0x66904d00,
+		0x5168b121, 0xfc9b82b1, 0x457f40e3, 0xac765f4a, 0x00f6b74c, 0xb06ff130,
+		0x2b3e047b, 0xd3decdfc, 0xed855ae1, 0xb6ee46bc, 0x6f76efda, 0x4c0b0a63,
+		0xfbb22941, 0x5edd24aa, 0x795e3397, 0xfa773be5, 0xf500d972, 0x1be72702,
+		0xb32e6350, 0xbd963761, 0xc7a279bb, 0x4b643bd1, 0x09bdb1b8, 0xa4f64a1a,
+		0x6b90728d, 0x8058e92a, 0x51d8d329, 0x5da30e5b, 0xe43e6dad, 0xf3a899f1,
+		0xe827fc5e, 0x286398ef, 0xcce36b52, 0xf5ec31db, 0x209db89f, 0x73643166,
+		0x9712f3b2, 0xd0f5ea10, 0xc71714f6, 0x61a00dfe, 0x87fd07c8, 0x5df54172,
+		0x8b39263f, 0x59672204, 0x90b5befd, 0xa0315bc9,
+	},
+};
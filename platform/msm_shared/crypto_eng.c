@@ -34,6 +34,48 @@
 #include "crypto_eng.h"
 #include "crypto_hash.h"
 
+#ifndef CRYPTO_DMOV
+#define CRYPTO_DMOV 0
+#endif
+
+#if CRYPTO_DMOV
+#include <stdlib.h>
+#include <arch/ops.h>
+#include <platform.h>
+#include "dmov.h"
+
+/* The DATA_SHADOW window decodes to DATA_IN, so a single item command
+ * with an incrementing destination can move up to the window size.
+ */
+#define CRYPTO_DMA_WINDOW	(CRYPTO3_DATA_SHADOW8191 + 4 - CRYPTO3_DATA_SHADOW0)
+#define CRYPTO_DMA_CMDS		((CRYPTO_MAX_AUTH_BLOCK_SIZE + CRYPTO_DMA_WINDOW - 1) \
+				 / CRYPTO_DMA_WINDOW + 1)
+/* below this, pushing words is cheaper than setting up the data mover */
+#define CRYPTO_DMA_MIN		256
+#define CRYPTO_DMA_TIMEOUT	100	/* ms */
+
+#define paddr(n) ((unsigned) (n))
+
+extern void dsb(void);
+
+static dmov_s crypto_dma_cmd[CRYPTO_DMA_CMDS] __attribute__ ((aligned(8)));
+static unsigned crypto_dma_ptr[2] __attribute__ ((aligned(8)));
+/* zero padded copy of the last few bytes of a segment */
+static unsigned char crypto_dma_tail[8] __attribute__ ((aligned(8)));
+static int crypto_dma_pending;
+static unsigned int crypto_config;
+#endif
+
+static void crypto_send_data_pio(void *ctx_ptr, unsigned char *data_ptr,
+				 unsigned int buff_size,
+				 unsigned int bytes_to_write,
+				 unsigned int *ret_status);
+
+int crypto_eng_dma_supported(void)
+{
+	return CRYPTO_DMOV;
+}
+
 /*
  * Function to reset the crypto engine.
  */
@@ -52,7 +94,8 @@ void crypto_eng_reset(void)
 /*
  * Function to initialize the crypto engine for a new session. It enables the
  * auto shutdown feature of CRYPTO3 and mask various interrupts since we use
- * polling. We are not using DMOV now.
+ * polling. The high speed input stays disabled until crypto_send_data picks
+ * the data mover for a segment.
  */
 
 void crypto_eng_init(void)
@@ -62,6 +105,10 @@ void crypto_eng_init(void)
 	       MASK_DIN_INTR | MASK_DOUT_INTR | HIGH_SPD_IN_EN_N |
 	       HIGH_SPD_OUT_EN_N | HIGH_SPD_HASH_EN_N);
 
+#if CRYPTO_DMOV
+	crypto_config = val;
+#endif
+
 	wr_ce(val, CRYPTO3_CONFIG);
 }
 
@@ -132,20 +179,166 @@ crypto_set_sha_ctx(void *ctx_ptr, unsigned int bytes_to_write,
 
 	wr_ce((bytes_to_write << AUTH_SEG_CFG_AUTH_SIZE), CRYPTO3_AUTH_SEG_CFG);
 	wr_ce(bytes_to_write, CRYPTO3_SEG_SIZE);
+#if !CRYPTO_DMOV
+	/* with the data mover, crypto_send_data starts the engine once it
+	   has chosen the input path for the segment */
 	wr_ce(GOPROC_GO, CRYPTO3_GOPROC);
+#endif
 
 	return;
 }
 
+#if CRYPTO_DMOV
+/*
+ * Collect the result of the data mover feed started by crypto_send_data.
+ * Returns 0 once the channel reported a clean completion.
+ */
+
+static int crypto_dma_wait(void)
+{
+	unsigned int status;
+	unsigned int result;
+	int err = 0;
+	time_t start = current_time();
+
+	while (!(readl(DMOV_STATUS(DMOV_CE_IN_CHAN)) & DMOV_STATUS_RSLT_VALID)) {
+		if (current_time() - start > CRYPTO_DMA_TIMEOUT) {
+			dprintf(CRITICAL, "crypto_dma_wait timeout\n");
+			/* graceful flush posts a result for the command */
+			writel(0, DMOV_FLUSH0(DMOV_CE_IN_CHAN));
+			start = current_time();
+			while (!(readl(DMOV_STATUS(DMOV_CE_IN_CHAN)) &
+				 DMOV_STATUS_RSLT_VALID) &&
+			       current_time() - start <= CRYPTO_DMA_TIMEOUT) ;
+			err = 1;
+			break;
+		}
+	}
+
+	status = readl(DMOV_STATUS(DMOV_CE_IN_CHAN));
+	while (DMOV_STATUS_RSLT_COUNT(status)) {
+		result = readl(DMOV_RSLT(DMOV_CE_IN_CHAN));
+		if (result & (DMOV_RSLT_ERROR | DMOV_RSLT_FLUSH))
+			err = 1;
+		status = readl(DMOV_STATUS(DMOV_CE_IN_CHAN));
+	}
+
+	crypto_dma_pending = 0;
+	return err ? -1 : 0;
+}
+
+/*
+ * Select the CRYPTO3 input path for the segment set up by crypto_set_sha_ctx
+ * and start it. DATA_IN must not be written by PIO while the high speed
+ * input is enabled.
+ */
+
+static void crypto_start(int dma)
+{
+	unsigned int val = crypto_config;
+
+	if (dma)
+		val &= ~HIGH_SPD_IN_EN_N;
+
+	wr_ce(val, CRYPTO3_CONFIG);
+	wr_ce(GOPROC_GO, CRYPTO3_GOPROC);
+}
+
+/*
+ * Queue a whole segment on the data mover and return without waiting;
+ * crypto_get_digest collects the completion. The trailing bytes that do
+ * not fill a doubleword are sent from a zero padded copy, the engine only
+ * consumes SEG_SIZE bytes. Words are byte swapped by the data mover like
+ * htonl in the PIO path.
+ */
+
+static void
+crypto_send_data_dma(void *ctx_ptr, unsigned char *data_ptr,
+		     unsigned int bytes_to_write, unsigned int *ret_status)
+{
+	unsigned int dma_len = bytes_to_write & ~7;
+	unsigned int tail = bytes_to_write - dma_len;
+	unsigned int off = 0;
+	unsigned int n;
+	int i = 0;
+
+	arch_clean_cache_range((addr_t) data_ptr, dma_len);
+
+	while (off < dma_len) {
+		n = MIN(dma_len - off, CRYPTO_DMA_WINDOW);
+		crypto_dma_cmd[i].cmd = CMD_MODE_SINGLE |
+		    CMD_DST_CRCI(DMOV_CE_IN_CRCI) |
+		    CMD_SRC_SWAP_BYTES | CMD_SRC_SWAP_SHORTS;
+		crypto_dma_cmd[i].src = paddr(data_ptr + off);
+		crypto_dma_cmd[i].dst = MSM_CRYPTO_BASE + CRYPTO3_DATA_SHADOW0;
+		crypto_dma_cmd[i].len = n;
+		off += n;
+		i++;
+	}
+	if (tail) {
+		memset(crypto_dma_tail, 0, sizeof(crypto_dma_tail));
+		memcpy(crypto_dma_tail, data_ptr + dma_len, tail);
+		arch_clean_cache_range((addr_t) crypto_dma_tail,
+				       sizeof(crypto_dma_tail));
+		crypto_dma_cmd[i].cmd = CMD_MODE_SINGLE |
+		    CMD_DST_CRCI(DMOV_CE_IN_CRCI) |
+		    CMD_SRC_SWAP_BYTES | CMD_SRC_SWAP_SHORTS;
+		crypto_dma_cmd[i].src = paddr(crypto_dma_tail);
+		crypto_dma_cmd[i].dst = MSM_CRYPTO_BASE + CRYPTO3_DATA_SHADOW0;
+		crypto_dma_cmd[i].len = sizeof(crypto_dma_tail);
+		i++;
+	}
+	crypto_dma_cmd[i - 1].cmd |= CMD_LC;
+	crypto_dma_ptr[0] = (paddr(crypto_dma_cmd) >> 3) | CMD_PTR_LP;
+
+	arch_clean_cache_range((addr_t) crypto_dma_cmd, sizeof(crypto_dma_cmd));
+	arch_clean_cache_range((addr_t) crypto_dma_ptr, sizeof(crypto_dma_ptr));
+	dsb();
+
+	writel(DMOV_CONFIG_FOREC_FLUSH_RSLT, DMOV_CONFIG(DMOV_CE_IN_CHAN));
+	writel(DMOV_CMD_PTR_LIST | DMOV_CMD_ADDR(paddr(crypto_dma_ptr)),
+	       DMOV_CMD_PTR(DMOV_CE_IN_CHAN));
+	crypto_dma_pending = 1;
+
+	*ret_status = CRYPTO_ERR_NONE;
+}
+#endif
+
 /*
- * Function to send data to CRYPTO3. This is non-DMOV implementation and uses
- * polling to send the requested amount of data.
+ * Function to send data to CRYPTO3. Large aligned segments are fed by the
+ * data mover where it is available, everything else by PIO.
  */
 
 void
 crypto_send_data(void *ctx_ptr, unsigned char *data_ptr,
 		 unsigned int buff_size, unsigned int bytes_to_write,
 		 unsigned int *ret_status)
+{
+#if CRYPTO_DMOV
+	crypto_SHA1_ctx *sha1_ctx = (crypto_SHA1_ctx *) ctx_ptr;
+
+	if (crypto_dma_feed && sha1_ctx->saved_buff_indx == 0 &&
+	    !((unsigned int)data_ptr & 7) && bytes_to_write >= CRYPTO_DMA_MIN) {
+		crypto_start(TRUE);
+		crypto_send_data_dma(ctx_ptr, data_ptr, bytes_to_write,
+				     ret_status);
+		return;
+	}
+	crypto_start(FALSE);
+#endif
+	crypto_send_data_pio(ctx_ptr, data_ptr, buff_size, bytes_to_write,
+			     ret_status);
+}
+
+/*
+ * Function to send data to CRYPTO3 by polling and writing one word at a
+ * time to DATA_IN.
+ */
+
+static void
+crypto_send_data_pio(void *ctx_ptr, unsigned char *data_ptr,
+		     unsigned int buff_size, unsigned int bytes_to_write,
+		     unsigned int *ret_status)
 {
 	crypto_SHA1_ctx *sha1_ctx = (crypto_SHA1_ctx *) ctx_ptr;
 	unsigned int bytes_left = 0;
@@ -295,6 +488,15 @@ crypto_get_digest(unsigned char *digest_ptr, unsigned int *ret_status,
 	unsigned int i = 0;
 	unsigned int digest_len = 0;
 
+#if CRYPTO_DMOV
+	if (crypto_dma_pending && crypto_dma_wait()) {
+		crypto_eng_reset();
+		*ret_status = CRYPTO_ERR_FAIL;
+		dprintf(CRITICAL, "crypto_get_digest dma error\n");
+		return;
+	}
+#endif
+
 	do {
 		ce_status = rd_ce(CRYPTO3_STATUS);
 		ce_status &= ce_err_bmsk;
@@ -27,20 +27,30 @@
  */
 
 #include <string.h>
+#include <stdlib.h>
 #include <debug.h>
+#include <platform.h>
 #include <sys/types.h>
+#include <sha.h>
 #include "crypto_hash.h"
 
 static crypto_SHA256_ctx g_sha256_ctx;
 static crypto_SHA1_ctx g_sha1_ctx;
 static unsigned char crypto_init_done = FALSE;
 
+int crypto_dma_feed;
+
 extern void ce_clock_init(void);
 
 __WEAK void crypto_eng_cleanup()
 {
 }
 
+__WEAK int crypto_eng_dma_supported(void)
+{
+	return FALSE;
+}
+
 /*
  * Top level function which calculates SHAx digest with given data and size.
  * Digest varies based on the authentication algorithm.
@@ -90,6 +100,7 @@ static void crypto_init(void)
 	if (crypto_init_done != TRUE) {
 		ce_clock_init();
 		crypto_eng_reset();
+		crypto_dma_feed = crypto_eng_dma_supported();
 		crypto_init_done = TRUE;
 	}
 	crypto_eng_init();
@@ -258,6 +269,42 @@ do_sha(unsigned char *buff_ptr,
 	return CRYPTO_SHA_ERR_NONE;
 }
 
+/*
+ * Function to hash one segment of at most CRYPTO_MAX_AUTH_BLOCK_SIZE bytes:
+ * sets up the engine, sends the data and reads back the intermediate or
+ * final digest into the context.
+ */
+
+static unsigned int
+do_sha_segment(void *ctx_ptr, unsigned char *buff_ptr,
+	       unsigned int buff_size, unsigned int bytes_to_write,
+	       crypto_auth_alg_type auth_alg, bool first, bool last)
+{
+	unsigned int ret_val = CRYPTO_ERR_NONE;
+
+	/* Set SHAx context in the crypto engine */
+	crypto_set_sha_ctx(ctx_ptr, bytes_to_write, auth_alg, first, last);
+
+	/* Send data to the crypto engine */
+	crypto_send_data(ctx_ptr, buff_ptr, buff_size, bytes_to_write,
+			 &ret_val);
+
+	if (ret_val != CRYPTO_ERR_NONE) {
+		dprintf(CRITICAL, "do_sha_segment error from crypto_send_data\n");
+		return ret_val;
+	}
+
+	/* Get the SHAx digest from the crypto engine */
+	crypto_get_digest((unsigned char *)
+			  (((crypto_SHA1_ctx *) ctx_ptr)->auth_iv),
+			  &ret_val, auth_alg, last);
+
+	if (ret_val != CRYPTO_ERR_NONE)
+		dprintf(CRITICAL, "do_sha_segment error from crypto_get_digest\n");
+
+	return ret_val;
+}
+
 /*
  * Common function to calculate SHA1 and SHA256 digest based on auth algorithm.
  * Calls crypto engine APIs to setup SHAx registers, send the data and gets
@@ -329,27 +376,25 @@ do_sha_update(void *ctx_ptr,
 			tmp_last = last;
 		}
 
-		/* Set SHAx context in the crypto engine */
-		crypto_set_sha_ctx(ctx_ptr, tmp_bytes, auth_alg, tmp_first,
-				   tmp_last);
+		ret_val = do_sha_segment(ctx_ptr, tmp_buff_ptr, tmp_buff_size,
+					 tmp_bytes, auth_alg, tmp_first,
+					 tmp_last);
 
-		/* Send data to the crypto engine */
-		crypto_send_data(ctx_ptr, tmp_buff_ptr, tmp_buff_size,
-				 tmp_bytes, &ret_val);
-
-		if (ret_val != CRYPTO_ERR_NONE) {
+		if (ret_val != CRYPTO_ERR_NONE && crypto_dma_feed) {
+			/* Data mover feed failed, the context is untouched
+			   so redo the segment by PIO from now on */
 			dprintf(CRITICAL,
-				"do_sha_update returns error from crypto_send_data\n");
-			return CRYPTO_SHA_ERR_FAIL;
+				"do_sha_update: DMA feed failed, using PIO\n");
+			crypto_dma_feed = FALSE;
+			crypto_eng_reset();
+			crypto_eng_init();
+			ret_val = do_sha_segment(ctx_ptr, tmp_buff_ptr,
+						 tmp_buff_size, tmp_bytes,
+						 auth_alg, tmp_first, tmp_last);
 		}
 
-		/* Get the SHAx digest from the crypto engine */
-		crypto_get_digest((unsigned char *)(sha1_ctx->auth_iv),
-				  &ret_val, auth_alg, tmp_last);
-
 		if (ret_val != CRYPTO_ERR_NONE) {
-			dprintf(CRITICAL,
-				"do_sha_update returns error from crypto_get_digest\n");
+			dprintf(CRITICAL, "do_sha_update returns error\n");
 			return CRYPTO_SHA_ERR_FAIL;
 		}
 
@@ -400,3 +445,100 @@ calc_num_bytes_to_send(void *ctx_ptr, unsigned int buff_size, bool last)
 	}
 	return bytes_to_write;
 }
+
+#if WITH_LIB_CONSOLE
+
+#include <lib/console.h>
+
+static int cmd_crypto(int argc, const cmd_args *argv);
+
+STATIC_COMMAND_START
+	{ "crypto", "crypto engine commands", &cmd_crypto },
+STATIC_COMMAND_END(crypto);
+
+/* MB/s of one SHA256 pass over buf, the digest is left in digest */
+static unsigned crypto_bench_run(const char *name, int hw, unsigned char *buf,
+				 unsigned size, unsigned char *digest)
+{
+	bigtime_t start, elapsed;
+	crypto_result_type ret = CRYPTO_SHA_ERR_NONE;
+	unsigned rate;
+
+	start = current_time_hires();
+	if (hw)
+		ret = crypto_sha256(buf, size, digest);
+	else
+		SHA256(buf, size, digest);
+	elapsed = current_time_hires() - start;
+
+	if (ret != CRYPTO_SHA_ERR_NONE) {
+		printf("%-8s failed (%d)\n", name, ret);
+		return 0;
+	}
+
+	rate = elapsed ? (unsigned) (((unsigned long long) size * 100) / elapsed) : 0;
+	printf("%-8s %6u us  %u.%02u MB/s\n", name, (unsigned) elapsed,
+	       rate / 100, rate % 100);
+	return rate;
+}
+
+static int cmd_crypto(int argc, const cmd_args *argv)
+{
+	unsigned char sw_digest[32], hw_digest[32];
+	unsigned char *buf;
+	unsigned size = 1024 * 1024;
+	unsigned i;
+	int feed;
+
+	if (argc < 2 || strcmp(argv[1].str, "bench")) {
+		printf("usage: %s bench [size in KB]\n", argv[0].str);
+		return -1;
+	}
+	if (argc > 2 && argv[2].u)
+		size = argv[2].u * 1024;
+
+	buf = memalign(CACHE_LINE, size);
+	if (!buf) {
+		printf("cannot allocate %u bytes\n", size);
+		return -1;
+	}
+	for (i = 0; i < size; i++)
+		buf[i] = i * 7 + (i >> 8);
+
+	printf("SHA256 over %u bytes\n", size);
+	crypto_bench_run("SW", FALSE, buf, size, sw_digest);
+
+	/* boards that hash in software by default still carry the engine */
+	if (board_ce_type() != CRYPTO_ENGINE_TYPE_NONE) {
+		/* first HW pass initializes the engine and the default feed */
+		crypto_init();
+		feed = crypto_dma_feed;
+
+		crypto_dma_feed = FALSE;
+		crypto_bench_run("HW-PIO", TRUE, buf, size, hw_digest);
+		if (memcmp(sw_digest, hw_digest, sizeof(hw_digest)))
+			printf("HW-PIO digest mismatch\n");
+
+		if (crypto_eng_dma_supported()) {
+			crypto_dma_feed = TRUE;
+			crypto_bench_run("HW-DMA", TRUE, buf, size, hw_digest);
+			if (memcmp(sw_digest, hw_digest, sizeof(hw_digest)))
+				printf("HW-DMA digest mismatch\n");
+			/* a failed DMA pass falls back to PIO for good */
+			if (!crypto_dma_feed)
+				feed = FALSE;
+		} else {
+			printf("HW-DMA   not supported\n");
+		}
+
+		crypto_dma_feed = feed;
+		crypto_eng_cleanup();
+	} else {
+		printf("no hardware crypto engine\n");
+	}
+
+	free(buf);
+	return 0;
+}
+
+#endif
@@ -125,6 +125,11 @@
 
 #define DMOV_USB_CHAN         11
 
+/* CE input, as in the kernel's arch/arm/mach-msm/include/mach/dma.h for
+ * the 7x27/7x27a/7x30 ADM; a wrong CRCI leaves the channel waiting forever */
+#define DMOV_CE_IN_CHAN       5
+#define DMOV_CE_IN_CRCI       4
+
 /* no client rate control ifc (eg, ram) */
 #define DMOV_NONE_CRCI        0
 
@@ -28,6 +28,8 @@
  * SUCH DAMAGE.
  */
 
+#define DEBUG_MODULE DBG_USB
+
 #include <string.h>
 #include <stdlib.h>
 #include <debug.h>
@@ -36,6 +38,9 @@
 #include <platform/interrupts.h>
 #include <platform/timer.h>
 #include <kernel/thread.h>
+#include <arch/ops.h>
+#include <arch/arm.h>
+#include <arch/arm/mmu.h>
 #include <reg.h>
 
 #include <dev/udc.h>
@@ -141,6 +146,19 @@ struct udc_endpoint {
 struct udc_endpoint *ept_list = 0;
 struct ept_queue_head *epts = 0;
 
+/* The queue heads and the transfer descriptors share one page that is
+ * mapped uncached, so neither the CPU nor the controller needs cache
+ * maintenance on them.  The heads take the first 2KB, descriptors are
+ * handed out in 32 byte slots from the rest.
+ */
+#define DESC_POOL_SIZE	4096
+#define EPT_HEADS_SIZE	(32 * sizeof(struct ept_queue_head))
+#define ITEM_SLOT_SIZE	32
+#define ITEM_SLOTS	((DESC_POOL_SIZE - EPT_HEADS_SIZE) / ITEM_SLOT_SIZE)
+
+static unsigned char *desc_pool;
+static unsigned char item_slot_used[ITEM_SLOTS];
+
 static int usb_online = 0;
 static int usb_highspeed = 0;
 
@@ -241,27 +259,126 @@ static void endpoint_enable(struct udc_endpoint *ept, unsigned yes)
 	writel(n, USB_ENDPTCTRL(ept->num));
 }
 
+static void desc_pool_init(void)
+{
+	desc_pool = memalign(DESC_POOL_SIZE, DESC_POOL_SIZE);
+	ASSERT(desc_pool);
+
+	memset(desc_pool, 0, DESC_POOL_SIZE);
+	arch_clean_invalidate_cache_range((addr_t) desc_pool, DESC_POOL_SIZE);
+
+#if ARM_WITH_MMU
+	arm_mmu_map_page(arm_mmu_virt2phy((uint32_t) desc_pool),
+			 (addr_t) desc_pool,
+			 MMU_MEMORY_TYPE_STRONGLY_ORDERED |
+			 MMU_MEMORY_AP_READ_WRITE | MMU_MEMORY_XN);
+#endif
+
+	epts = (struct ept_queue_head *) desc_pool;
+}
+
+static struct ept_queue_item *item_alloc(void)
+{
+	unsigned n;
+
+	for (n = 0; n < ITEM_SLOTS; n++) {
+		if (!item_slot_used[n]) {
+			item_slot_used[n] = 1;
+			return (struct ept_queue_item *)
+			    (desc_pool + EPT_HEADS_SIZE + n * ITEM_SLOT_SIZE);
+		}
+	}
+	return 0;
+}
+
+static void item_free(struct ept_queue_item *item)
+{
+	unsigned n = ((unsigned char *)item - desc_pool - EPT_HEADS_SIZE) /
+	    ITEM_SLOT_SIZE;
+
+	item_slot_used[n] = 0;
+}
+
 struct udc_request *udc_request_alloc(void)
 {
 	struct usb_request *req;
 	req = malloc(sizeof(*req));
+	if (!req)
+		return 0;
 	req->req.buf = 0;
 	req->req.length = 0;
-	req->item = memalign(32, 32);
+	req->item = item_alloc();
+	if (!req->item) {
+		dprintf(CRITICAL, "udc: out of transfer descriptors\n");
+		free(req);
+		return 0;
+	}
 	return &req->req;
 }
 
-void udc_request_free(struct udc_request *req)
+void udc_request_free(struct udc_request *_req)
 {
+	struct usb_request *req = (struct usb_request *)_req;
+
+	item_free(req->item);
 	free(req);
 }
 
+/* Drop cached copies of an OUT buffer before the controller writes it.
+ * Lines only partly covered by the buffer are written back first so the
+ * data sharing them survives.
+ */
+static void out_buffer_prepare(addr_t buf, unsigned len)
+{
+	addr_t end = buf + len;
+
+	if (buf & (CACHE_LINE - 1))
+		arch_clean_invalidate_cache_range(buf, 1);
+	if (end & (CACHE_LINE - 1))
+		arch_clean_invalidate_cache_range(end, 1);
+
+	arch_invalidate_cache_range(buf, len);
+}
+
+/* Drop lines speculatively fetched while the controller wrote an OUT
+ * buffer. The CPU may have written data sharing the partial edge lines
+ * meanwhile, so that data is saved and put back around the invalidate.
+ */
+static void out_buffer_complete(addr_t buf, unsigned len)
+{
+	addr_t end = buf + len;
+	unsigned head = buf & (CACHE_LINE - 1);
+	unsigned tail = (CACHE_LINE - (end & (CACHE_LINE - 1))) & (CACHE_LINE - 1);
+	unsigned char edge[2][CACHE_LINE];
+
+	if (head)
+		memcpy(edge[0], (void *)(buf - head), head);
+	if (tail)
+		memcpy(edge[1], (void *)end, tail);
+
+	arch_invalidate_cache_range(buf, len);
+
+	if (head)
+		memcpy((void *)(buf - head), edge[0], head);
+	if (tail)
+		memcpy((void *)end, edge[1], tail);
+}
+
 int udc_request_queue(struct udc_endpoint *ept, struct udc_request *_req)
 {
 	struct usb_request *req = (struct usb_request *)_req;
 	struct ept_queue_item *item = req->item;
 	uint32_t phys = arm_mmu_virt2phy((uint32_t)req->req.buf);
 
+	if (req->req.length) {
+		if (ept->in)
+			arch_clean_cache_range((addr_t) req->req.buf,
+					       req->req.length);
+		else
+			out_buffer_prepare((addr_t) req->req.buf,
+					   req->req.length);
+	}
+
 	item->next = TERMINATE;
 	item->info = INFO_BYTES(req->req.length) | INFO_IOC | INFO_ACTIVE;
 	item->page0 = phys;
@@ -275,17 +392,6 @@ int udc_request_queue(struct udc_endpoint *ept, struct udc_request *_req)
 	ept->head->info = 0;
 	ept->req = req;
 
-	arch_clean_invalidate_cache_range((addr_t) ept,
-					  sizeof(struct udc_endpoint));
-	arch_clean_invalidate_cache_range((addr_t) ept->head,
-					  sizeof(struct ept_queue_head));
-	arch_clean_invalidate_cache_range((addr_t) ept->req,
-					  sizeof(struct usb_request));
-	arch_clean_invalidate_cache_range((addr_t) req->req.buf,
-					  req->req.length);
-	arch_clean_invalidate_cache_range((addr_t) ept->req->item,
-					  sizeof(struct ept_queue_item));
-
 	DBG("ept%d %s queue req=%p\n", ept->num, ept->in ? "in" : "out", req);
 
 	writel(ept->bit, USB_ENDPTPRIME);
@@ -303,11 +409,6 @@ static void handle_ept_complete(struct udc_endpoint *ept)
 	DBG("ept%d %s complete req=%p\n",
 	    ept->num, ept->in ? "in" : "out", ept->req);
 
-	arch_clean_invalidate_cache_range((addr_t) ept,
-					  sizeof(struct udc_endpoint));
-	arch_clean_invalidate_cache_range((addr_t) ept->req,
-					  sizeof(struct usb_request));
-
 	req = ept->req;
 	if (req) {
 		ept->req = 0;
@@ -318,18 +419,7 @@ static void handle_ept_complete(struct udc_endpoint *ept)
 		 * transfer completion before the active bit has cleared.
 		 * HACK: wait for the ACTIVE bit to clear:
 		 */
-		do {
-			/* Must clean/invalidate cached item data before checking
-			 * the status every time.
-			 */
-			arch_clean_invalidate_cache_range((addr_t) item,
-							  sizeof(struct
-								 ept_queue_item));
-		}
-		while (readl(&(item->info)) & INFO_ACTIVE);
-
-		arch_clean_invalidate_cache_range((addr_t) req->req.buf,
-						  req->req.length);
+		while (readl(&(item->info)) & INFO_ACTIVE) ;
 
 		if (item->info & 0xff) {
 			actual = 0;
@@ -341,6 +431,10 @@ static void handle_ept_complete(struct udc_endpoint *ept)
 			actual =
 			    req->req.length - ((item->info >> 16) & 0x7fff);
 			status = 0;
+
+			if (!ept->in && actual)
+				out_buffer_complete((addr_t) req->req.buf,
+						    actual);
 		}
 		if (req->req.complete)
 			req->req.complete(&req->req, actual, status);
@@ -436,8 +530,6 @@ static void handle_setup(struct udc_endpoint *ept)
 {
 	struct setup_packet s;
 
-	arch_clean_invalidate_cache_range((addr_t) ept->head->setup_data,
-					  sizeof(struct ept_queue_head));
 	memcpy(&s, ept->head->setup_data, sizeof(s));
 	writel(ept->bit, USB_ENDPTSETUPSTAT);
 
@@ -581,12 +673,9 @@ int udc_init(struct udc_device *dev)
 
 	thread_sleep(20);
 
-	epts = memalign(4096, 4096);
+	desc_pool_init();
 
 	dprintf(INFO, "USB init ept @ %p\n", epts);
-	memset(epts, 0, 32 * sizeof(struct ept_queue_head));
-	arch_clean_invalidate_cache_range((addr_t) epts,
-					  32 * sizeof(struct ept_queue_head));
 
 	writel((unsigned)epts, USB_ENDPOINTLISTADDR);
 
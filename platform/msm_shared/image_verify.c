@@ -24,55 +24,144 @@
  * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
  * SUCH DAMAGE.
  */
-#include <x509.h>
+#include <debug.h>
+#include <string.h>
+#include <stdlib.h>
+#include <platform.h>
 #include <certificate.h>
 #include <crypto_hash.h>
+#include <sha.h>
+#include <smp.h>
+#include <arch/defines.h>
 #include "image_verify.h"
 
+/* OpenSSL's armv4-mont: rp = ap * bp / R mod np, R = 2^(32*num) */
+int bn_mul_mont(unsigned int *rp, const unsigned int *ap,
+		const unsigned int *bp, const unsigned int *np,
+		const unsigned int *n0, int num);
+
+/* PKCS#1 v1.5 type 1 needs at least 8 bytes of 0xff padding */
+#define PKCS1_MIN_PAD 8
+
+/* 1 if x == 0, else 0, for x < 2^31 */
+static inline unsigned int ct_is_zero(unsigned int x)
+{
+	return (x - 1) >> 31;
+}
+
+/*
+ * Strips PKCS#1 v1.5 type 1 padding (00 01 ff..ff 00 T) from em without
+ * branching on its contents. Returns the offset of T, or 0 if malformed.
+ */
+static unsigned int pkcs1_unpad(const unsigned char *em)
+{
+	unsigned int i;
+	unsigned int bad = em[0] | (em[1] ^ 0x01);
+	unsigned int found = 0;
+	unsigned int zero_idx = 0;
+
+	for (i = 2; i < SIGNATURE_SIZE; i++) {
+		unsigned int z = ct_is_zero(em[i]);
+		unsigned int first = z & ~found & 1;
+
+		zero_idx |= (0 - first) & i;
+		bad |= ~found & ~z & 1 & (1 ^ ct_is_zero(em[i] ^ 0xff));
+		found |= z;
+	}
+	bad |= ~found & 1;
+	bad |= (zero_idx - (2 + PKCS1_MIN_PAD)) >> 31;
+
+	return (0 - ct_is_zero(bad)) & (zero_idx + 1);
+}
+
 /*
  * Returns -1 if decryption failed otherwise size of plain_text in bytes
  */
 static int
 image_decrypt_signature(unsigned char *signature_ptr, unsigned char *plain_text)
 {
-	/*
-	 * Extract Public Key and Decrypt Signature
-	 */
-	int ret = -1;
-	X509 *x509_certificate = NULL;
-	unsigned char *cert_ptr = certBuffer;
-	unsigned int cert_size = sizeof(certBuffer);
-	EVP_PKEY *pub_key = NULL;
-	RSA *rsa_key = NULL;
+	const struct certificate_key *key = &certKey;
+	unsigned int s[CERTIFICATE_KEY_WORDS];
+	unsigned int a[CERTIFICATE_KEY_WORDS];
+	unsigned int x[CERTIFICATE_KEY_WORDS];
+	unsigned char em[SIGNATURE_SIZE];
+	unsigned int num = key->num;
+	unsigned int i, off;
+	int bit;
 
-	/*
-	 * Get Pubkey and Convert the internal EVP_PKEY to RSA internal struct
-	 */
-	if ((x509_certificate = d2i_X509(NULL, &cert_ptr, cert_size)) == NULL) {
-		dprintf(CRITICAL,
-			"ERROR: Image Invalid, X509_Certificate is NULL!\n");
-		goto cleanup;
+	if (num * 4 != SIGNATURE_SIZE) {
+		dprintf(CRITICAL, "ERROR: Unsupported key size %u\n", num * 32);
+		return -1;
 	}
-	pub_key = X509_get_pubkey(x509_certificate);
-	rsa_key = EVP_PKEY_get1_RSA(pub_key);
-	if (rsa_key == NULL) {
-		dprintf(CRITICAL, "ERROR: Boot Invalid, RSA_KEY is NULL!\n");
-		goto cleanup;
+
+	/* Big-endian signature to little-endian words */
+	for (i = 0; i < num; i++) {
+		const unsigned char *p = signature_ptr + SIGNATURE_SIZE - 4 * (i + 1);
+		s[i] = (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
 	}
 
-	ret = RSA_public_decrypt(SIGNATURE_SIZE, signature_ptr, plain_text,
-				 rsa_key, RSA_PKCS1_PADDING);
-	dprintf(SPEW, "DEBUG openssl: Return of RSA_public_decrypt = %d\n",
-		ret);
+	/* The signature must be a residue mod n */
+	for (i = num; i-- > 0;) {
+		if (s[i] != key->n[i])
+			break;
+	}
+	if (i == (unsigned int)-1 || s[i] > key->n[i]) {
+		dprintf(CRITICAL, "ERROR: Signature out of range\n");
+		return -1;
+	}
 
- cleanup:
-	if (rsa_key != NULL)
-		RSA_free(rsa_key);
-	if (x509_certificate != NULL)
-		X509_free(x509_certificate);
-	if (pub_key != NULL)
-		EVP_PKEY_free(pub_key);
-	return ret;
+	/* s^e mod n, in Montgomery form; e is public */
+	bn_mul_mont(a, s, key->rr, key->n, &key->n0, num);
+	memcpy(x, a, sizeof(x));
+	for (bit = 31 - __builtin_clz(key->e) - 1; bit >= 0; bit--) {
+		bn_mul_mont(x, x, x, key->n, &key->n0, num);
+		if (key->e & (1 << bit))
+			bn_mul_mont(x, x, a, key->n, &key->n0, num);
+	}
+	memset(s, 0, sizeof(s));
+	s[0] = 1;
+	bn_mul_mont(x, x, s, key->n, &key->n0, num);
+
+	for (i = 0; i < num; i++) {
+		unsigned char *p = em + SIGNATURE_SIZE - 4 * (i + 1);
+		p[0] = x[i] >> 24;
+		p[1] = x[i] >> 16;
+		p[2] = x[i] >> 8;
+		p[3] = x[i];
+	}
+
+	off = pkcs1_unpad(em);
+	if (off == 0)
+		return -1;
+
+	memcpy(plain_text, em + off, SIGNATURE_SIZE - off);
+	return SIGNATURE_SIZE - off;
+}
+
+struct image_hash_args {
+	const unsigned char *addr;
+	unsigned int size;
+	unsigned char *digest;
+	unsigned hash_type;
+};
+
+/* written by the second core, so it gets whole cache lines */
+static struct {
+	unsigned char digest[SHA256_SIZE];
+} image_hash_result __ALIGNED(CACHE_LINE);
+
+/*
+ * Software hash of the image for the second core. hash_find() is not used
+ * here as it also tears down the crypto engine, which belongs to CPU0.
+ */
+static void image_hash_job(void *arg)
+{
+	struct image_hash_args *args = arg;
+
+	if (args->hash_type == CRYPTO_AUTH_ALG_SHA256)
+		SHA256(args->addr, args->size, args->digest);
+	else
+		SHA1(args->addr, args->size, args->digest);
 }
 
 /*
@@ -91,6 +180,10 @@ image_verify(unsigned char *image_ptr,
 	unsigned char *plain_text = NULL;
 	unsigned int digest[8];
 	unsigned int hash_size;
+	bigtime_t t_start, t_rsa, t_hash;
+	struct image_hash_args args;
+	int ticket = -1;
+	bool offload;
 
 	plain_text = (unsigned char *)calloc(sizeof(char), SIGNATURE_SIZE);
 	if (plain_text == NULL) {
@@ -98,7 +191,33 @@ image_verify(unsigned char *image_ptr,
 		goto cleanup;
 	}
 
+	hash_size =
+	    (hash_type == CRYPTO_AUTH_ALG_SHA256) ? SHA256_SIZE : SHA1_SIZE;
+
+	/*
+	 * Without a hardware engine the image is hashed on the second core,
+	 * if there is one, while this one decrypts the signature.
+	 */
+	offload = board_ce_type() == CRYPTO_ENGINE_TYPE_SW &&
+	    smp_secondary_online();
+	if (offload) {
+		args.addr = image_ptr;
+		args.size = image_size;
+		args.digest = image_hash_result.digest;
+		args.hash_type = hash_type;
+		ticket = smp_job_post(image_hash_job, &args, sizeof(args),
+				      image_ptr, image_size, &image_hash_result,
+				      sizeof(image_hash_result));
+	}
+
+	t_start = current_time_hires();
 	ret = image_decrypt_signature(signature_ptr, plain_text);
+	t_rsa = current_time_hires();
+
+	/* the job reads the image, let it finish before giving up */
+	if (offload)
+		smp_job_wait(ticket);
+
 	if (ret == -1) {
 		dprintf(CRITICAL, "ERROR: Image Invalid! Decryption failed!\n");
 		goto cleanup;
@@ -107,9 +226,16 @@ image_verify(unsigned char *image_ptr,
 	/*
 	 * Calculate hash of image for comparison
 	 */
-	hash_size =
-	    (hash_type == CRYPTO_AUTH_ALG_SHA256) ? SHA256_SIZE : SHA1_SIZE;
-	hash_find(image_ptr, image_size, (unsigned char *)&digest, hash_type);
+	if (offload)
+		memcpy(digest, image_hash_result.digest, hash_size);
+	else
+		hash_find(image_ptr, image_size, (unsigned char *)&digest,
+			  hash_type);
+	t_hash = current_time_hires();
+
+	dprintf(INFO, "Image verify: rsa %u us, hash %u bytes %u us%s\n",
+		(unsigned)(t_rsa - t_start), image_size,
+		(unsigned)(t_hash - t_rsa), offload ? " waiting for cpu1" : "");
 	if (memcmp(plain_text, digest, hash_size) != 0) {
 		dprintf(CRITICAL,
 			"ERROR: Image Invalid! Please use another image!\n");
@@ -120,12 +246,8 @@ image_verify(unsigned char *image_ptr,
 		auth = 1;
 	}
 
-	/* Cleanup after complete usage of openssl - cached data and objects */
  cleanup:
 	if (plain_text != NULL)
 		free(plain_text);
-	EVP_cleanup();
-	CRYPTO_cleanup_all_ex_data();
-	ERR_remove_thread_state(NULL);
 	return auth;
 }
@@ -38,6 +38,7 @@ struct board_data {
 	uint32_t platform_subtype;
 	uint32_t target;
 	uint32_t baseband;
+	uint32_t soc_version;
 };
 
 void board_init();
@@ -47,5 +48,6 @@ uint32_t board_platform_id();
 uint32_t board_target_id();
 uint32_t board_baseband();
 uint32_t board_hardware_id();
+uint32_t board_soc_version();
 
 #endif
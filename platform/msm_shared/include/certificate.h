@@ -29,3 +29,20 @@
 #define CERTIFICATE_SIZE 724
 
 extern const char certBuffer[CERTIFICATE_SIZE];
+
+/* Words of a 2048-bit modulus */
+#define CERTIFICATE_KEY_WORDS 64
+
+/*
+ * RSA public key of certBuffer, pre-extracted by
+ * scripts/mkcertkey.pl. Multi-word values are little-endian 32-bit words.
+ */
+struct certificate_key {
+	unsigned int num;	/* words in n */
+	unsigned int n0;	/* -n^-1 mod 2^32 */
+	unsigned int e;		/* public exponent */
+	unsigned int n[CERTIFICATE_KEY_WORDS];
+	unsigned int rr[CERTIFICATE_KEY_WORDS];	/* R^2 mod n, R = 2^(32*num) */
+};
+
+extern const struct certificate_key certKey;
@@ -79,6 +79,14 @@ typedef struct {
 	unsigned char flags;
 } crypto_SHA256_ctx;
 
+/* feed the engine through the data mover where crypto_eng_dma_supported */
+extern int crypto_dma_feed;
+
+extern int crypto_eng_dma_supported(void);
+
+/* which engine hash_find uses, provided by the target */
+extern crypto_engine_type board_ce_type(void);
+
 extern void crypto_eng_reset(void);
 
 extern void crypto_eng_init(void);
@@ -112,6 +120,13 @@ static crypto_result_type do_sha_update(void *ctx_ptr,
 					crypto_auth_alg_type auth_alg,
 					bool first, bool last);
 
+static unsigned int do_sha_segment(void *ctx_ptr,
+				   unsigned char *buff_ptr,
+				   unsigned int buff_size,
+				   unsigned int bytes_to_write,
+				   crypto_auth_alg_type auth_alg,
+				   bool first, bool last);
+
 static unsigned int calc_num_bytes_to_send(void *ctx_ptr,
 					   unsigned int buff_size, bool last);
 
@@ -376,14 +376,32 @@ extern unsigned int mmc_boot_mci_base;
 /* EXT_CSD */
 #define MMC_BOOT_ACCESS_WRITE             0x3
 
+#define MMC_BOOT_EXT_WR_REL_PARAM         166
 #define MMC_BOOT_EXT_USER_WP              171
 #define MMC_BOOT_EXT_ERASE_GROUP_DEF      175
 #define MMC_BOOT_EXT_ERASE_MEM_CONT       181
 #define MMC_BOOT_EXT_CMMC_BUS_WIDTH       183
 #define MMC_BOOT_EXT_CMMC_HS_TIMING       185
 #define MMC_BOOT_EXT_HC_WP_GRP_SIZE       221
+#define MMC_BOOT_EXT_REL_WR_SEC_C         222
 #define MMC_BOOT_EXT_ERASE_TIMEOUT_MULT   223
 #define MMC_BOOT_EXT_HC_ERASE_GRP_SIZE    224
+#define MMC_BOOT_EXT_SEC_FEATURE_SUPPORT  231
+
+/* WR_REL_PARAM bits */
+#define MMC_BOOT_EN_REL_WR                (1 << 2)
+
+/* CMD23 argument bits */
+#define MMC_BOOT_CMD23_REL_WRITE          (1 << 31)
+
+/* SEC_FEATURE_SUPPORT bits */
+#define MMC_BOOT_SEC_ER_EN                (1 << 0)
+#define MMC_BOOT_SEC_GB_CL_EN             (1 << 4)
+
+/* CMD38 arguments */
+#define MMC_BOOT_ERASE_ARG                0x00000000
+#define MMC_BOOT_TRIM_ARG                 0x00000001
+#define MMC_BOOT_SECURE_ERASE_ARG         0x80000000
 
 #define IS_BIT_SET_EXT_CSD(val, bit)      ((ext_csd_buf[val]) & (1<<(bit)))
 #define IS_ADDR_OUT_OF_RANGE(resp)        ((resp >> 31) & 0x01)
@@ -580,6 +598,8 @@ unsigned int mmc_boot_read_from_card(struct mmc_boot_host *host,
 				     unsigned int data_len, unsigned int *out);
 unsigned int mmc_write(unsigned long long data_addr,
 		       unsigned int data_len, unsigned int *in);
+unsigned int mmc_write_reliable(unsigned long long data_addr,
+				unsigned int data_len, unsigned int *in);
 
 unsigned int mmc_read(unsigned long long data_addr, unsigned int *out,
 		      unsigned int data_len);
@@ -593,6 +613,28 @@ unsigned int mmc_boot_write_to_card(struct mmc_boot_host *host,
 unsigned int mmc_erase_card(unsigned long long data_addr,
 			    unsigned long long data_len);
 
+/* mmc_erase_range() flags */
+#define MMC_ERASE_SECURE                  (1 << 0)
+
+typedef void (*mmc_erase_progress_t) (unsigned long long done,
+				      unsigned long long total);
+
+unsigned int mmc_erase_range(unsigned long long data_addr,
+			     unsigned long long data_len, unsigned int flags,
+			     mmc_erase_progress_t progress);
+
+/* Accumulated by mmc_write()/mmc_write_reliable(), one entry per command */
+struct mmc_write_stats {
+	unsigned int writes;
+	unsigned int predefined;	/* CMD23 + CMD25, no CMD12 */
+	unsigned int reliable;
+	unsigned long long bytes;
+	unsigned long long total_us;
+	unsigned int max_us;
+	unsigned int max_us_bytes;	/* size of the slowest write */
+};
+
 struct mmc_boot_host *get_mmc_host(void);
 struct mmc_boot_card *get_mmc_card(void);
+struct mmc_write_stats *get_mmc_write_stats(void);
 #endif
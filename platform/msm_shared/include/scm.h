@@ -86,6 +86,12 @@ AP_CE_ADM_USE = 1
 
 uint8_t switch_ce_chn_cmd(enum ap_ce_channel_type channel);
 
+#define SCM_SVC_BOOT                0x01
+#define SCM_BOOT_ADDR               0x01
+#define SCM_FLAG_COLDBOOT_CPU1      0x01
+
+int scm_set_boot_addr(uint32_t addr, uint32_t flags);
+
 
 void set_tamper_fuse_cmd();
 
@@ -31,11 +31,17 @@
 #include <platform/irqs.h>
 #include <platform/interrupts.h>
 #include <debug.h>
+#if WITH_LIB_PROFILE
+#include <lib/profile.h>
+#endif
 
 extern int target_supports_qgic();
 
 enum handler_return platform_irq(struct arm_iframe *frame)
 {
+#if WITH_LIB_PROFILE
+	profile_irq_pc = frame->pc;
+#endif
 #if TARGET_USES_GIC_VIC
 	if(target_supports_qgic())
 		return gic_platform_irq(frame);
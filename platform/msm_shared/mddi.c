@@ -39,6 +39,8 @@
 #include "mddi_hw.h"
 
 static mddi_llentry *mlist = NULL;
+static unsigned mlist_count;
+static unsigned mlist_last;	/* entry currently terminating mlist */
 static mddi_llentry *mlist_remote_write = NULL;
 
 #define MDDI_MAX_REV_PKT_SIZE 0x60
@@ -53,12 +55,14 @@ void panel_backlight(int on);
 /* forward decls */
 static void mddi_start_update(void);
 static int mddi_update_done(void);
+static void mddi_update_region(unsigned y, unsigned height);
 
 static struct fbcon_config fb_cfg = {
 	.format = FB_FORMAT_RGB565,
 	.bpp = 16,
 	.update_start = mddi_start_update,
 	.update_done = mddi_update_done,
+	.update_region = mddi_update_region,
 };
 
 static void printcaps(struct mddi_client_caps *c)
@@ -151,11 +155,43 @@ mddi_remote_multiwrite(unsigned *val_list, unsigned reg, unsigned val_count)
 }
 #endif
 
+/* Make entry last the end of the video stream link list. Only called
+ * once the previous update is done, so the list is not in use.
+ */
+static void mddi_terminate_list(unsigned last)
+{
+	if (last == mlist_last)
+		return;
+
+	mlist[mlist_last].flags = 0;
+	mlist[mlist_last].next = &mlist[mlist_last + 1];
+
+	mlist[last].flags = 1;
+	mlist[last].next = 0;
+	mlist_last = last;
+}
+
 static void mddi_start_update(void)
 {
+	mddi_terminate_list(mlist_count - 1);
 	writel((unsigned)mlist, MDDI_PRI_PTR);
 }
 
+/* Send only the 8-line video stream packets covering [y, y + height) */
+static void mddi_update_region(unsigned y, unsigned height)
+{
+	unsigned first = y / 8;
+	unsigned last = (y + height - 1) / 8;
+
+	if (!height || first >= mlist_count)
+		return;
+	if (last >= mlist_count)
+		last = mlist_count - 1;
+
+	mddi_terminate_list(last);
+	writel((unsigned)&mlist[first], MDDI_PRI_PTR);
+}
+
 static int mddi_update_done(void)
 {
 	return !!(readl(MDDI_STAT) & MDDI_STAT_PRI_LINK_LIST_DONE);
@@ -367,6 +403,8 @@ struct fbcon_config *mddi_init(void)
 
 	mlist[n - 1].flags = 1;
 	mlist[n - 1].next = 0;
+	mlist_count = n;
+	mlist_last = n - 1;
 
 	mddi_set_auto_hibernate(1);
 	mddi_do_cmd(CMD_LINK_ACTIVE);
@@ -26,6 +26,8 @@
  * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#define DEBUG_MODULE DBG_MMC
+
 #include <string.h>
 #include <stdlib.h>
 #include <debug.h>
@@ -34,6 +36,8 @@
 #include <partition_parser.h>
 #include <platform/iomap.h>
 #include <platform/timer.h>
+#include <platform.h>
+#include <kernel/mutex.h>
 
 #if MMC_BOOT_ADM
 #include "adm.h"
@@ -93,6 +97,14 @@ static unsigned int mmc_boot_read_reg(struct mmc_boot_card *card,
 				      unsigned int data_len,
 				      unsigned int command,
 				      unsigned int addr, unsigned int *out);
+static unsigned int mmc_boot_set_block_count(struct mmc_boot_card *card,
+					     unsigned int block_count);
+
+static struct mmc_write_stats mmc_wr_stats;
+
+/* Serialises mmc_read/mmc_write/mmc_erase_range between threads */
+static mutex_t mmc_lock;
+static unsigned char mmc_lock_ready;
 
 unsigned int SWAP_ENDIAN(unsigned int val)
 {
@@ -1299,15 +1311,38 @@ mmc_boot_send_write_command(struct mmc_boot_card *card,
 	return MMC_BOOT_E_SUCCESS;
 }
 
+/*
+ * Reliable write is only honoured when the card has enhanced reliable
+ * write, or the transfer is aligned to REL_WR_SEC_C sectors.
+ */
+static unsigned int
+mmc_boot_rel_write_ok(struct mmc_boot_card *card,
+		      unsigned long long data_addr, unsigned int data_len)
+{
+	unsigned int sec_c = ext_csd_buf[MMC_BOOT_EXT_REL_WR_SEC_C];
+
+	if ((card->type != MMC_BOOT_TYPE_MMCHC) &&
+	    (card->type != MMC_BOOT_TYPE_STD_MMC))
+		return 0;
+
+	if (ext_csd_buf[MMC_BOOT_EXT_WR_REL_PARAM] & MMC_BOOT_EN_REL_WR)
+		return 1;
+
+	return sec_c && !((data_addr / 512) % sec_c) &&
+	    !((data_len / 512) % sec_c);
+}
+
 /*
  * Write data_len data to address specified by data_addr. data_len is
- * multiple of blocks for block data transfer.
+ * multiple of blocks for block data transfer. MMC cards get the block
+ * count up front (CMD23), which saves the CMD12 and lets the card
+ * program the whole transfer as one unit; with reliable set the CMD23
+ * also requests a reliable write.
  */
-unsigned int
-mmc_boot_write_to_card(struct mmc_boot_host *host,
-		       struct mmc_boot_card *card,
-		       unsigned long long data_addr,
-		       unsigned int data_len, unsigned int *in)
+static unsigned int
+mmc_boot_write(struct mmc_boot_host *host, struct mmc_boot_card *card,
+	       unsigned long long data_addr, unsigned int data_len,
+	       unsigned int *in, unsigned int reliable)
 {
 	unsigned int mmc_ret = MMC_BOOT_E_SUCCESS;
 	unsigned int mmc_status = 0;
@@ -1315,6 +1350,8 @@ mmc_boot_write_to_card(struct mmc_boot_host *host,
 	unsigned int addr;
 	unsigned int xfer_type;
 	unsigned int status;
+	unsigned int block_count;
+	unsigned char predefined = 0;
 
 	if ((host == NULL) || (card == NULL)) {
 		return MMC_BOOT_E_INVAL;
@@ -1340,6 +1377,33 @@ mmc_boot_write_to_card(struct mmc_boot_host *host,
 	     rd_block_len) ? MMC_BOOT_XFER_MULTI_BLOCK :
 	    MMC_BOOT_XFER_SINGLE_BLOCK;
 
+	if (reliable && !mmc_boot_rel_write_ok(card, data_addr, data_len)) {
+		dprintf(SPEW, "mmc: reliable write not possible at 0x%llx\n",
+			data_addr);
+		reliable = 0;
+	}
+
+	/* SD cards do not support CMD23, restrict this to MMC. */
+	if (((card->type == MMC_BOOT_TYPE_MMCHC)
+	     || (card->type == MMC_BOOT_TYPE_STD_MMC))
+	    && ((xfer_type == MMC_BOOT_XFER_MULTI_BLOCK) || reliable)) {
+		block_count = data_len / card->wr_block_len;
+		if (reliable)
+			block_count |= MMC_BOOT_CMD23_REL_WRITE;
+
+		mmc_ret = mmc_boot_set_block_count(card, block_count);
+		if (mmc_ret != MMC_BOOT_E_SUCCESS) {
+			dprintf(CRITICAL,
+				"Error No.%d: Failure setting write block count for Card (RCA:%x)\n",
+				mmc_ret, card->rca);
+			return mmc_ret;
+		}
+
+		/* CMD23 must be followed by CMD25, even for a single block */
+		xfer_type = MMC_BOOT_XFER_MULTI_BLOCK;
+		predefined = 1;
+	}
+
 	/* For MMCHC/SDHC data address is specified in unit of 512B */
 	addr = ((card->type != MMC_BOOT_TYPE_MMCHC)
 		&& (card->type !=
@@ -1408,8 +1472,9 @@ mmc_boot_write_to_card(struct mmc_boot_host *host,
 	/* Send command to the card/device in order to poll the de-assertion of
 	   card/device BUSY condition. It is important to set PROG_ENA bit in
 	   MCI_CLK register before sending the command. Possible commands are
-	   CMD12/13. */
-	if (xfer_type == MMC_BOOT_XFER_MULTI_BLOCK) {
+	   CMD12/13. A pre-defined transfer ends by itself, so it only needs
+	   the CMD13. */
+	if ((xfer_type == MMC_BOOT_XFER_MULTI_BLOCK) && !predefined) {
 		mmc_ret = mmc_boot_send_stop_transmission(card, 1);
 		if (mmc_ret != MMC_BOOT_E_SUCCESS) {
 			dprintf(CRITICAL, "Error No.%d: Failure sending Stop Transmission \
@@ -1438,9 +1503,23 @@ mmc_boot_write_to_card(struct mmc_boot_host *host,
 	}
 	while (1);
 
+	if (predefined)
+		mmc_wr_stats.predefined++;
+	if (reliable)
+		mmc_wr_stats.reliable++;
+
 	return MMC_BOOT_E_SUCCESS;
 }
 
+unsigned int
+mmc_boot_write_to_card(struct mmc_boot_host *host,
+		       struct mmc_boot_card *card,
+		       unsigned long long data_addr,
+		       unsigned int data_len, unsigned int *in)
+{
+	return mmc_boot_write(host, card, data_addr, data_len, in, 0);
+}
+
 /*
  * Adjust the interface speed to optimal speed
  */
@@ -1545,9 +1624,9 @@ mmc_boot_read_from_card(struct mmc_boot_host *host,
 	    && (card->type != MMC_BOOT_TYPE_SDHC)) {
 		mmc_ret = mmc_boot_set_block_len(card, card->rd_block_len);
 		if (mmc_ret != MMC_BOOT_E_SUCCESS) {
-			dprintf(CRITICAL,
-				"Error No.%d: Failure setting block length for Card (RCA:%s)\n",
-				mmc_ret, (char *)(card->rca));
+			dlog(CRITICAL,
+			     "Error No.%d: Failure setting block length for Card (RCA:%x)\n",
+			     mmc_ret, card->rca);
 			return mmc_ret;
 		}
 	}
@@ -1571,9 +1650,9 @@ mmc_boot_read_from_card(struct mmc_boot_host *host,
 						     data_len /
 						     (card->rd_block_len));
 			if (mmc_ret != MMC_BOOT_E_SUCCESS) {
-				dprintf(CRITICAL,
-					"Error No.%d: Failure setting read block count for Card (RCA:%s)\n",
-					mmc_ret, (char *)(card->rca));
+				dlog(CRITICAL,
+				     "Error No.%d: Failure setting read block count for Card (RCA:%x)\n",
+				     mmc_ret, card->rca);
 				return mmc_ret;
 			}
 
@@ -1632,9 +1711,9 @@ mmc_boot_read_from_card(struct mmc_boot_host *host,
 	   transfer. Possible commands: CMD17/18/53/60/61. */
 	mmc_ret = mmc_boot_send_read_command(card, xfer_type, addr);
 	if (mmc_ret != MMC_BOOT_E_SUCCESS) {
-		dprintf(CRITICAL,
-			"Error No.%d: Failure sending read command to the Card(RCA:%x)\n",
-			mmc_ret, card->rca);
+		dlog(CRITICAL,
+		     "Error No.%d: Failure sending read command to the Card(RCA:%x)\n",
+		     mmc_ret, card->rca);
 		return mmc_ret;
 	}
 
@@ -1643,9 +1722,9 @@ mmc_boot_read_from_card(struct mmc_boot_host *host,
 	    mmc_boot_fifo_data_transfer(out, data_len, MMC_BOOT_DATA_READ);
 
 	if (mmc_ret != MMC_BOOT_E_SUCCESS) {
-		dprintf(CRITICAL, "Error No.%d: Failure on data transfer from the \
-                Card(RCA:%x)\n", mmc_ret,
-			card->rca);
+		dlog(CRITICAL,
+		     "Error No.%d: Failure on data transfer from the Card(RCA:%x)\n",
+		     mmc_ret, card->rca);
 		return mmc_ret;
 	}
 
@@ -1654,9 +1733,9 @@ mmc_boot_read_from_card(struct mmc_boot_host *host,
 	if ((xfer_type == MMC_BOOT_XFER_MULTI_BLOCK) && open_ended_read) {
 		mmc_ret = mmc_boot_send_stop_transmission(card, 0);
 		if (mmc_ret != MMC_BOOT_E_SUCCESS) {
-			dprintf(CRITICAL, "Error No.%d: Failure sending Stop Transmission \
-                    command to the Card(RCA:%x)\n", mmc_ret,
-				card->rca);
+			dlog(CRITICAL,
+			     "Error No.%d: Failure sending Stop Transmission command to the Card(RCA:%x)\n",
+			     mmc_ret, card->rca);
 			return mmc_ret;
 		}
 	}
@@ -2135,6 +2214,11 @@ unsigned int mmc_boot_main(unsigned char slot, unsigned int base)
 	mmc_slot = slot;
 	mmc_boot_mci_base = base;
 
+	if (!mmc_lock_ready) {
+		mutex_init(&mmc_lock);
+		mmc_lock_ready = 1;
+	}
+
 	/* Initialize necessary data structure and enable/set clock and power */
 	dprintf(SPEW, " Initializing MMC host data structure and clock!\n");
 	mmc_ret = mmc_boot_init(&mmc_host);
@@ -2159,39 +2243,81 @@ unsigned int mmc_boot_main(unsigned char slot, unsigned int base)
 }
 
 /*
- * MMC write function
+ * Write in chunks the data length register can describe, timing each
+ * command into mmc_wr_stats.
  */
-unsigned int
-mmc_write(unsigned long long data_addr, unsigned int data_len, unsigned int *in)
+static unsigned int
+mmc_write_chunks(unsigned long long data_addr, unsigned int data_len,
+		 unsigned int *in, unsigned int reliable)
 {
 	int val = 0;
 	unsigned int write_size = ((unsigned)(0xFFFFFF / 512)) * 512;
 	unsigned offset = 0;
 	unsigned int *sptr = in;
+	unsigned int n;
+	unsigned int us;
+	bigtime_t start;
 
 	if (data_len % 512)
 		data_len = ROUND_TO_PAGE(data_len, 511);
 
-	while (data_len > write_size) {
-		val = mmc_boot_write_to_card(&mmc_host, &mmc_card,
-					     data_addr + offset, write_size,
-					     sptr);
+	while (data_len) {
+		n = (data_len > write_size) ? write_size : data_len;
+
+		start = current_time_hires();
+		val = mmc_boot_write(&mmc_host, &mmc_card, data_addr + offset,
+				     n, sptr, reliable);
 		if (val) {
 			return val;
 		}
+		us = current_time_hires() - start;
+
+		mmc_wr_stats.writes++;
+		mmc_wr_stats.bytes += n;
+		mmc_wr_stats.total_us += us;
+		if (us > mmc_wr_stats.max_us) {
+			mmc_wr_stats.max_us = us;
+			mmc_wr_stats.max_us_bytes = n;
+		}
 
-		sptr += (write_size / sizeof(unsigned));
-		offset += write_size;
-		data_len -= write_size;
-	}
-	if (data_len) {
-		val = mmc_boot_write_to_card(&mmc_host, &mmc_card,
-					     data_addr + offset, data_len,
-					     sptr);
+		sptr += (n / sizeof(unsigned));
+		offset += n;
+		data_len -= n;
 	}
 	return val;
 }
 
+/*
+ * MMC write function
+ */
+unsigned int
+mmc_write(unsigned long long data_addr, unsigned int data_len, unsigned int *in)
+{
+	unsigned int val;
+
+	mutex_acquire(&mmc_lock);
+	val = mmc_write_chunks(data_addr, data_len, in, 0);
+	mutex_release(&mmc_lock);
+	return val;
+}
+
+/*
+ * Write that the card commits atomically per sector (reliable write).
+ * Meant for small metadata; falls back to a normal write when the card
+ * cannot honour it for this range.
+ */
+unsigned int
+mmc_write_reliable(unsigned long long data_addr, unsigned int data_len,
+		   unsigned int *in)
+{
+	unsigned int val;
+
+	mutex_acquire(&mmc_lock);
+	val = mmc_write_chunks(data_addr, data_len, in, 1);
+	mutex_release(&mmc_lock);
+	return val;
+}
+
 /*
  * MMC read function
  */
@@ -2200,9 +2326,12 @@ unsigned int
 mmc_read(unsigned long long data_addr, unsigned int *out, unsigned int data_len)
 {
 	int val = 0;
+
+	mutex_acquire(&mmc_lock);
 	val =
 	    mmc_boot_read_from_card(&mmc_host, &mmc_card, data_addr, data_len,
 				    out);
+	mutex_release(&mmc_lock);
 	return val;
 }
 
@@ -2626,7 +2755,9 @@ mmc_boot_send_erase_group_start(struct mmc_boot_card *card,
 	memset((struct mmc_boot_command *)&cmd, 0,
 	       sizeof(struct mmc_boot_command));
 
-	cmd.cmd_index = CMD35_ERASE_GROUP_START;
+	cmd.cmd_index = ((card->type == MMC_BOOT_TYPE_STD_SD) ||
+			 (card->type == MMC_BOOT_TYPE_SDHC))
+	    ? CMD32_ERASE_WR_BLK_START : CMD35_ERASE_GROUP_START;
 	cmd.argument = data_addr;
 	cmd.cmd_type = MMC_BOOT_CMD_ADDRESS;
 	cmd.resp_type = MMC_BOOT_RESP_R1;
@@ -2661,7 +2792,9 @@ mmc_boot_send_erase_group_end(struct mmc_boot_card *card,
 	memset((struct mmc_boot_command *)&cmd, 0,
 	       sizeof(struct mmc_boot_command));
 
-	cmd.cmd_index = CMD36_ERASE_GROUP_END;
+	cmd.cmd_index = ((card->type == MMC_BOOT_TYPE_STD_SD) ||
+			 (card->type == MMC_BOOT_TYPE_SDHC))
+	    ? CMD33_ERASE_WR_BLK_END : CMD36_ERASE_GROUP_END;
 	cmd.argument = data_addr;
 	cmd.cmd_type = MMC_BOOT_CMD_ADDRESS;
 	cmd.resp_type = MMC_BOOT_RESP_R1;
@@ -2680,9 +2813,10 @@ mmc_boot_send_erase_group_end(struct mmc_boot_card *card,
 }
 
 /*
- * CMD38 ERASE
+ * CMD38 ERASE, arg selects erase, trim or secure erase
  */
-static unsigned int mmc_boot_send_erase(struct mmc_boot_card *card)
+static unsigned int
+mmc_boot_send_erase(struct mmc_boot_card *card, unsigned int arg)
 {
 
 	struct mmc_boot_command cmd;
@@ -2696,7 +2830,7 @@ static unsigned int mmc_boot_send_erase(struct mmc_boot_card *card)
 	       sizeof(struct mmc_boot_command));
 
 	cmd.cmd_index = CMD38_ERASE;
-	cmd.argument = 0x00000000;
+	cmd.argument = arg;
 	cmd.cmd_type = MMC_BOOT_CMD_ADDRESS;
 	cmd.resp_type = MMC_BOOT_RESP_R1B;
 
@@ -2720,7 +2854,7 @@ static unsigned int mmc_boot_send_erase(struct mmc_boot_card *card)
 	/* Checking for write protect */
 	if (cmd.resp[0] & MMC_BOOT_R1_WP_ERASE_SKIP) {
 		dprintf(CRITICAL, "Write protect enabled for sector \n");
-		return;
+		return MMC_BOOT_E_FAILURE;
 	}
 
 	/* Checking if the erase operation for the card is compelete */
@@ -2740,89 +2874,200 @@ static unsigned int mmc_boot_send_erase(struct mmc_boot_card *card)
 }
 
 /*
- * Function to erase data on the eMMC card
+ * Erase group size of the card in sectors. SD cards erase in write
+ * blocks, so any range is a whole number of groups.
  */
-#define DEFAULT_ERASE_SECTORS	8
-unsigned int
-mmc_erase_card(unsigned long long data_addr, unsigned long long size)
+static unsigned long long mmc_boot_erase_grp_size(struct mmc_boot_card *card)
 {
-	unsigned int mmc_ret = MMC_BOOT_E_SUCCESS;
-	unsigned long long erase_grp_size;
-	unsigned long long data_end = 0x00000000;
-	unsigned long long loop_count;
-	unsigned int out[512 * DEFAULT_ERASE_SECTORS] = { 0 };
-
-	/* Converting size to sectors */
-	size = size / 512;
+	if ((card->type == MMC_BOOT_TYPE_STD_SD) ||
+	    (card->type == MMC_BOOT_TYPE_SDHC))
+		return 1;
 
-	if (ext_csd_buf[MMC_BOOT_EXT_ERASE_GROUP_DEF]) {
-		erase_grp_size =
-		    (512 * ext_csd_buf[MMC_BOOT_EXT_HC_ERASE_GRP_SIZE] * 1024);
-		erase_grp_size = erase_grp_size / 512;
-	} else {
-		erase_grp_size = (mmc_card.csd.erase_grp_size + 1) *
-		    (mmc_card.csd.erase_grp_mult + 1);
-	}
+	if (ext_csd_buf[MMC_BOOT_EXT_ERASE_GROUP_DEF])
+		return 1024 * ext_csd_buf[MMC_BOOT_EXT_HC_ERASE_GRP_SIZE];
 
-	if (erase_grp_size == 0) {
-		return MMC_BOOT_E_FAILURE;
-	}
+	return (card->csd.erase_grp_size + 1) * (card->csd.erase_grp_mult + 1);
+}
 
-	if (size % erase_grp_size) {
-		dprintf(CRITICAL, "Overflow beyond ERASE_GROUP_SIZE:%llu\n",
-			(size % erase_grp_size));
+/*
+ * One CMD35/36/38 sequence (CMD32/33/38 on SD) over sectors
+ * [start, start + count).
+ */
+static unsigned int
+mmc_boot_erase_sectors(struct mmc_boot_card *card, unsigned long long start,
+		       unsigned long long count, unsigned int arg)
+{
+	unsigned long long end = start + count - 1;
+	unsigned int mmc_ret;
 
-	}
-	loop_count = (size / erase_grp_size);
-	/*
-	 *In case the partition size is less than the erase_grp_size
-	 0 is written to the first block of the partition.
-	 */
-	if (loop_count < 1) {
-		mmc_ret = mmc_write(data_addr, 512 * DEFAULT_ERASE_SECTORS, (unsigned int *)out);
-		if (mmc_ret != MMC_BOOT_E_SUCCESS)
-			return mmc_ret;
-		else
-			return MMC_BOOT_E_SUCCESS;
-	} else {
-		data_addr = ((mmc_card.type != MMC_BOOT_TYPE_MMCHC) &&
-			     (mmc_card.type != MMC_BOOT_TYPE_SDHC))
-		    ? (unsigned int)data_addr : (unsigned int)(data_addr / 512);
-		data_end = data_addr + erase_grp_size * (loop_count - 1);
+	if ((card->type != MMC_BOOT_TYPE_MMCHC) &&
+	    (card->type != MMC_BOOT_TYPE_SDHC)) {
+		start *= 512;
+		end *= 512;
 	}
 
-	/* Sending CMD35 */
-	mmc_ret = mmc_boot_send_erase_group_start(&mmc_card, data_addr);
+	mmc_ret = mmc_boot_send_erase_group_start(card, start);
 	if (mmc_ret != MMC_BOOT_E_SUCCESS) {
 		dprintf(CRITICAL, "Error %d: Failure sending erase group start "
-			"command to the card (RCA:%x)\n", mmc_ret,
-			mmc_card.rca);
+			"command to the card (RCA:%x)\n", mmc_ret, card->rca);
 		return mmc_ret;
 	}
 
-	/* Sending CMD36 */
-	mmc_ret = mmc_boot_send_erase_group_end(&mmc_card, data_end);
+	mmc_ret = mmc_boot_send_erase_group_end(card, end);
 	if (mmc_ret != MMC_BOOT_E_SUCCESS) {
 		dprintf(CRITICAL, "Error %d: Failure sending erase group end "
-			"command to the card (RCA:%x)\n", mmc_ret,
-			mmc_card.rca);
+			"command to the card (RCA:%x)\n", mmc_ret, card->rca);
 		return mmc_ret;
 	}
 
-	/* Sending CMD38 */
-	mmc_ret = mmc_boot_send_erase(&mmc_card);
+	mmc_ret = mmc_boot_send_erase(card, arg);
 	if (mmc_ret != MMC_BOOT_E_SUCCESS) {
-		dprintf(CRITICAL,
-			"Error %d: Failure sending erase command "
-			"to the card (RCA:%x)\n", mmc_ret, mmc_card.rca);
+		dprintf(CRITICAL, "Error %d: Failure sending erase command "
+			"to the card (RCA:%x)\n", mmc_ret, card->rca);
+		return mmc_ret;
+	}
+
+	return MMC_BOOT_E_SUCCESS;
+}
+
+#define MMC_ERASE_ZERO_SECTORS		32
+static unsigned int mmc_erase_zeros[128 * MMC_ERASE_ZERO_SECTORS]
+    __attribute__ ((aligned(CACHE_LINE)));
+
+/*
+ * Clear a partial erase group. TRIM when the card supports it, which
+ * costs one command regardless of length; otherwise write zeros. Secure
+ * erase always writes zeros here, a plain TRIM would leave the data in
+ * the flash.
+ */
+static unsigned int
+mmc_boot_clear_sectors(struct mmc_boot_card *card, unsigned long long start,
+		       unsigned long long count, unsigned int flags)
+{
+	unsigned int mmc_ret = MMC_BOOT_E_SUCCESS;
+	unsigned int n;
+
+	if (count == 0)
+		return MMC_BOOT_E_SUCCESS;
+
+	if (!(flags & MMC_ERASE_SECURE) &&
+	    (ext_csd_buf[MMC_BOOT_EXT_SEC_FEATURE_SUPPORT] &
+	     MMC_BOOT_SEC_GB_CL_EN))
+		return mmc_boot_erase_sectors(card, start, count,
+					      MMC_BOOT_TRIM_ARG);
+
+	while (count) {
+		n = (count > MMC_ERASE_ZERO_SECTORS) ?
+		    MMC_ERASE_ZERO_SECTORS : count;
+		mmc_ret = mmc_write_chunks(start * 512, n * 512,
+					   mmc_erase_zeros, 0);
+		if (mmc_ret != MMC_BOOT_E_SUCCESS)
+			return mmc_ret;
+		start += n;
+		count -= n;
+	}
+	return MMC_BOOT_E_SUCCESS;
+}
+
+/* Erase groups covered by one CMD38, bounds the time between progress calls */
+#define MMC_ERASE_CHUNK_SECTORS		(256 * 1024 * 1024 / 512)
+
+/*
+ * Erase data_len bytes at data_addr, both 512 byte aligned. Whole erase
+ * groups are erased (or securely erased with MMC_ERASE_SECURE), the
+ * unaligned head and tail are cleared by mmc_boot_clear_sectors().
+ * progress, if not NULL, is called with the bytes done after each step.
+ */
+static unsigned int
+mmc_boot_erase_range(unsigned long long data_addr,
+		     unsigned long long data_len, unsigned int flags,
+		     mmc_erase_progress_t progress)
+{
+	unsigned int mmc_ret = MMC_BOOT_E_SUCCESS;
+	unsigned long long start = data_addr / 512;
+	unsigned long long end = (data_addr + data_len) / 512;
+	unsigned long long grp, chunk, head_end, tail_start, pos, n;
+	unsigned int arg = MMC_BOOT_ERASE_ARG;
+
+	if ((data_addr % 512) || (data_len % 512))
+		return MMC_BOOT_E_INVAL;
+
+	grp = mmc_boot_erase_grp_size(&mmc_card);
+	if (grp == 0)
+		return MMC_BOOT_E_FAILURE;
+
+	if (flags & MMC_ERASE_SECURE) {
+		if (!(ext_csd_buf[MMC_BOOT_EXT_SEC_FEATURE_SUPPORT] &
+		      MMC_BOOT_SEC_ER_EN))
+			return MMC_BOOT_E_NOT_SUPPORTED;
+		arg = MMC_BOOT_SECURE_ERASE_ARG;
+	}
+
+	head_end = ((start + grp - 1) / grp) * grp;
+	tail_start = (end / grp) * grp;
+	if (head_end > end || tail_start < head_end)
+		head_end = tail_start = end;
+
+	mmc_ret = mmc_boot_clear_sectors(&mmc_card, start, head_end - start,
+					 flags);
+	if (mmc_ret != MMC_BOOT_E_SUCCESS)
 		return mmc_ret;
 
+	chunk = (MMC_ERASE_CHUNK_SECTORS / grp) * grp;
+	if (chunk == 0)
+		chunk = grp;
+
+	for (pos = head_end; pos < tail_start; pos += n) {
+		if (progress)
+			progress((pos - start) * 512, data_len);
+
+		n = tail_start - pos;
+		if (n > chunk)
+			n = chunk;
+		mmc_ret = mmc_boot_erase_sectors(&mmc_card, pos, n, arg);
+		if (mmc_ret != MMC_BOOT_E_SUCCESS)
+			return mmc_ret;
 	}
 
-	dprintf(CRITICAL, "ERASE SUCCESSFULLY COMPLETED\n");
+	mmc_ret = mmc_boot_clear_sectors(&mmc_card, tail_start,
+					 end - tail_start, flags);
+	if (mmc_ret != MMC_BOOT_E_SUCCESS)
+		return mmc_ret;
+
+	if (progress)
+		progress(data_len, data_len);
+
+	dprintf(INFO, "Erased %llu sectors: %llu in erase groups of %llu\n",
+		end - start, tail_start - head_end, grp);
 	return MMC_BOOT_E_SUCCESS;
 }
 
+unsigned int
+mmc_erase_range(unsigned long long data_addr, unsigned long long data_len,
+		unsigned int flags, mmc_erase_progress_t progress)
+{
+	unsigned int mmc_ret;
+
+	mutex_acquire(&mmc_lock);
+	mmc_ret = mmc_boot_erase_range(data_addr, data_len, flags, progress);
+	mutex_release(&mmc_lock);
+	return mmc_ret;
+}
+
+/*
+ * Function to erase data on the eMMC card
+ */
+unsigned int
+mmc_erase_card(unsigned long long data_addr, unsigned long long size)
+{
+	return mmc_erase_range(data_addr, size, 0, NULL);
+}
+
+struct mmc_write_stats *get_mmc_write_stats(void)
+{
+	return &mmc_wr_stats;
+}
+
 struct mmc_boot_host *get_mmc_host(void)
 {
 	return &mmc_host;
@@ -27,6 +27,8 @@
  * SUCH DAMAGE.
  */
 
+#define DEBUG_MODULE DBG_NAND
+
 #include <debug.h>
 #include <reg.h>
 #include <stdlib.h>
@@ -34,6 +36,8 @@
 #include <dev/flash.h>
 #include <lib/ptable.h>
 #include <nand.h>
+#include <platform.h>
+#include <kernel/mutex.h>
 
 #include "dmov.h"
 
@@ -79,6 +83,17 @@ static unsigned ECC_BCH_CFG;
 static uint32_t enable_bch_ecc;
 static unsigned int *bbtbl;
 
+/* Corrected bitflips seen by ECC reads, per block, for scrubbing */
+struct flash_ecc_block {
+	unsigned short corrected;
+	unsigned char max_cw;
+	unsigned char uncorrectable;
+};
+static struct flash_ecc_block *ecc_tbl;
+
+/* Serializes users of the shared command lists */
+static mutex_t flash_lock;
+
 #define CFG1_WIDE_FLASH (1U << 1)
 
 #define paddr(n) ((unsigned) (n))
@@ -531,8 +546,15 @@ flash_nand_erase_block(dmov_s * cmdlist, unsigned *ptrlist, unsigned page)
 	if (page & num_pages_per_blk_mask)
 		return -1;
 
-	/* Check for bad block and erase only if block is not marked bad */
-	isbad = flash_nand_block_isbad(cmdlist, ptrlist, page);
+	/* Check for bad block and erase only if block is not marked bad.
+	 * The result is cached in bbtbl so erasing a range that was already
+	 * scanned issues back to back erase commands.
+	 */
+	isbad = bbtbl[page / num_pages_per_blk];
+	if (isbad == -1) {
+		isbad = flash_nand_block_isbad(cmdlist, ptrlist, page);
+		bbtbl[page / num_pages_per_blk] = isbad ? 1 : 0;
+	}
 
 	if (isbad) {
 		dprintf(INFO, "skipping @ %d (bad block)\n",
@@ -756,6 +778,22 @@ flash_nand_erase_block_interleave(dmov_s * cmdlist, unsigned *ptrlist,
 	return 0;
 }
 
+static int flash_page_is_erased(const unsigned char *buf, unsigned len)
+{
+	const unsigned *p = (const unsigned *)buf;
+	unsigned n;
+
+	/* page data is word aligned, only OOB tags may have an odd length */
+	for (n = len / sizeof(unsigned); n > 0; n--)
+		if (*p++ != 0xffffffff)
+			return 0;
+	for (n = len & (sizeof(unsigned) - 1), buf = (const unsigned char *)p;
+	     n > 0; n--)
+		if (*buf++ != 0xff)
+			return 0;
+	return 1;
+}
+
 struct data_flash_io {
 	unsigned cmd;
 	unsigned addr0;
@@ -769,12 +807,51 @@ struct data_flash_io {
 	unsigned ecc_cfg_save;
 	unsigned clrfstatus;
 	unsigned clrrstatus;
-	struct {
+	struct flash_io_result {
 		unsigned flash_status;
 		unsigned buffer_status;
 	} result[8];
 };
 
+/* NANDC BUFFER_STATUS: bit 8 flags an uncorrectable codeword, the low bits
+ * count the corrected symbols (3 bits for RS, 5 for BCH). Same layout as
+ * MSM_NAND_BUF_STAT_UNCRCTBL_ERR / NUM_ERR in the kernel's msm_nand driver.
+ */
+#define NAND_BUF_STAT_UNCORRECTABLE	(1 << 8)
+
+/* Bits the ECC engine can correct per 512 byte codeword */
+unsigned flash_ecc_strength(void)
+{
+	return enable_bch_ecc ? 8 : 4;
+}
+
+static void
+flash_ecc_record(unsigned block, const struct flash_io_result *result,
+		 unsigned cwperpage, const void *page_data)
+{
+	struct flash_ecc_block *e = &ecc_tbl[block];
+	unsigned mask = enable_bch_ecc ? 0x1f : 0x7;
+	unsigned n, bits, lost = 0;
+
+	for (n = 0; n < cwperpage; n++) {
+		if (result[n].buffer_status & NAND_BUF_STAT_UNCORRECTABLE) {
+			lost++;
+			continue;
+		}
+		bits = result[n].buffer_status & mask;
+		if (bits > e->max_cw)
+			e->max_cw = bits;
+		if (e->corrected + bits > 0xffff)
+			e->corrected = 0xffff;
+		else
+			e->corrected += bits;
+	}
+
+	/* erased pages have no valid ECC */
+	if (lost && !flash_page_is_erased(page_data, flash_pagesize))
+		e->uncorrectable = MIN(e->uncorrectable + lost, 0xff);
+}
+
 struct interleave_data_flash_io {
 	uint32_t cmd;
 	uint32_t addr0;
@@ -942,6 +1019,9 @@ _flash_nand_read_page(dmov_s * cmdlist, unsigned *ptrlist,
 	}
 #endif
 
+	/* uncorrectable codewords also fail the read below, count them first */
+	flash_ecc_record(block, data->result, cwperpage, _addr);
+
 	/* if any of the writes failed (0x10), or there was a
 	 ** protection violation (0x100), we lose
 	 */
@@ -3129,6 +3209,8 @@ flash_onenand_mark_badblock(dmov_s * cmdlist, unsigned *ptrlist, unsigned page)
 static int
 flash_mark_badblock(dmov_s * cmdlist, unsigned *ptrlist, unsigned page)
 {
+	bbtbl[page / num_pages_per_blk] = 1;
+
 	switch (flash_info.type) {
 	case FLASH_8BIT_NAND_DEVICE:
 	case FLASH_16BIT_NAND_DEVICE:
@@ -3343,6 +3425,10 @@ void flash_init(void)
 				   flash_info.num_blocks);
 	for (i = 0; i < flash_info.num_blocks; i++)
 		bbtbl[i] = -1;
+
+	ecc_tbl = calloc(flash_info.num_blocks, sizeof(*ecc_tbl));
+	ASSERT(ecc_tbl);
+	mutex_init(&flash_lock);
 }
 
 struct ptable *flash_get_ptable(void)
@@ -3361,7 +3447,7 @@ struct flash_info *flash_get_info(void)
 	return &flash_info;
 }
 
-int flash_erase(struct ptentry *ptn)
+static int _flash_erase(struct ptentry *ptn)
 {
 	unsigned block = ptn->start;
 	unsigned count = ptn->length;
@@ -3378,9 +3464,9 @@ int flash_erase(struct ptentry *ptn)
 	return 0;
 }
 
-int
-flash_read_ext(struct ptentry *ptn, unsigned extra_per_page,
-	       unsigned offset, void *data, unsigned bytes)
+static int
+_flash_read_ext(struct ptentry *ptn, unsigned extra_per_page,
+		unsigned offset, void *data, unsigned bytes)
 {
 	unsigned page =
 	    (ptn->start * num_pages_per_blk) + (offset / flash_pagesize);
@@ -3454,18 +3540,55 @@ flash_read_ext(struct ptentry *ptn, unsigned extra_per_page,
 	return 0xffffffff;
 }
 
+int flash_erase(struct ptentry *ptn)
+{
+	int ret;
+
+	mutex_acquire(&flash_lock);
+	ret = _flash_erase(ptn);
+	mutex_release(&flash_lock);
+	return ret;
+}
+
 int
-flash_write(struct ptentry *ptn, unsigned extra_per_page, const void *data,
-	    unsigned bytes)
+flash_read_ext(struct ptentry *ptn, unsigned extra_per_page,
+	       unsigned offset, void *data, unsigned bytes)
+{
+	int ret;
+
+	mutex_acquire(&flash_lock);
+	ret = _flash_read_ext(ptn, extra_per_page, offset, data, bytes);
+	mutex_release(&flash_lock);
+	return ret;
+}
+
+/*
+ * Program npages pages starting at the beginning of ptn. Page i is read
+ * from pages + i * page_stride. Its spare comes from tags + i * tag_stride
+ * if tag_len covers everything the controller stores, is padded with 0xff
+ * in flash_spare otherwise, and is all 0xff when there are no tags.
+ */
+static int
+flash_write_pages(struct ptentry *ptn, const unsigned char *pages,
+		  unsigned page_stride, const unsigned char *tags,
+		  unsigned tag_stride, unsigned tag_len, unsigned npages,
+		  unsigned tail_blocks, unsigned flags,
+		  struct flash_write_stats *stats)
 {
 	unsigned page = ptn->start * num_pages_per_blk;
 	unsigned lastpage = (ptn->start + ptn->length) * num_pages_per_blk;
 	unsigned *spare = (unsigned *)flash_spare;
-	const unsigned char *image = data;
-	unsigned wsize = flash_pagesize + extra_per_page;
+	const unsigned char *image;
+	const unsigned char *tag;
+	const void *sparep;
+	struct flash_write_stats st;
+	bigtime_t t;
+	unsigned i = 0;
 	unsigned n;
 	int r;
 
+	memset(&st, 0, sizeof(st));
+
 	if ((flash_info.type == FLASH_ONENAND_DEVICE)
 	    && (ptn->type == TYPE_MODEM_PARTITION)) {
 		dprintf(CRITICAL, "flash_write_image: feature not supported\n");
@@ -3476,21 +3599,18 @@ flash_write(struct ptentry *ptn, unsigned extra_per_page, const void *data,
 	for (n = 0; n < 16; n++)
 		spare[n] = 0xffffffff;
 
-	while (bytes > 0) {
-		if (bytes < wsize) {
-			dprintf(CRITICAL,
-				"flash_write_image: image undersized (%d < %d)\n",
-				bytes, wsize);
-			return -1;
-		}
+	while (i < npages) {
 		if (page >= lastpage) {
 			dprintf(CRITICAL, "flash_write_image: out of space\n");
 			return -1;
 		}
 
 		if ((page & num_pages_per_blk_mask) == 0) {
-			if (flash_erase_block
-			    (flash_cmdlist, flash_ptrlist, page)) {
+			t = current_time_hires();
+			r = flash_erase_block(flash_cmdlist, flash_ptrlist, page);
+			st.erase_us += current_time_hires() - t;
+			st.erased_blocks++;
+			if (r) {
 				dprintf(INFO,
 					"flash_write_image: bad block @ %d\n",
 					page / num_pages_per_blk);
@@ -3499,20 +3619,40 @@ flash_write(struct ptentry *ptn, unsigned extra_per_page, const void *data,
 			}
 		}
 
-		if (extra_per_page) {
-			r = _flash_write_page(flash_cmdlist, flash_ptrlist,
-					      page, arm_mmu_virt2phy(image),
-					      arm_mmu_virt2phy(image + flash_pagesize));
+		image = pages + i * page_stride;
+		tag = tags ? tags + i * tag_stride : NULL;
+
+		/* A freshly erased page already reads back as all 0xff */
+		if ((flags & FLASH_WRITE_SKIP_ERASED)
+		    && flash_page_is_erased(image, flash_pagesize)
+		    && (!tag || flash_page_is_erased(tag, tag_len))) {
+			st.skipped_pages++;
+			page++;
+			i++;
+			continue;
+		}
+
+		if (!tag) {
+			sparep = spare;
+		} else if (tag_len >= flash_tag_size()) {
+			sparep = (const void *)arm_mmu_virt2phy((unsigned)tag);
 		} else {
-			r = _flash_write_page(flash_cmdlist, flash_ptrlist,
-					      page, arm_mmu_virt2phy(image), spare);
+			memset(spare, 0xff, 16 * sizeof(unsigned));
+			memcpy(spare, tag, tag_len);
+			sparep = spare;
 		}
+
+		t = current_time_hires();
+		r = _flash_write_page(flash_cmdlist, flash_ptrlist, page,
+				      (const void *)arm_mmu_virt2phy((unsigned)image),
+				      sparep);
+		st.program_us += current_time_hires() - t;
+		st.programmed_pages++;
 		if (r) {
 			dprintf(INFO,
 				"flash_write_image: write failure @ page %d (src %d)\n",
-				page, image - (const unsigned char *)data);
-			image -= (page & num_pages_per_blk_mask) * wsize;
-			bytes += (page & num_pages_per_blk_mask) * wsize;
+				page, i);
+			i -= page & num_pages_per_blk_mask;
 			page &= ~num_pages_per_blk_mask;
 			if (flash_erase_block
 			    (flash_cmdlist, flash_ptrlist, page)) {
@@ -3526,29 +3666,265 @@ flash_write(struct ptentry *ptn, unsigned extra_per_page, const void *data,
 			}
 			dprintf(INFO,
 				"flash_write_image: restart write @ page %d (src %d)\n",
-				page, image - (const unsigned char *)data);
+				page, i);
 			page += num_pages_per_blk;
 			continue;
 		}
 		page++;
-		image += wsize;
-		bytes -= wsize;
+		i++;
 	}
 
-	/* erase any remaining pages in the partition */
+	/* erase the requested number of blocks past the image */
 	page = (page + num_pages_per_blk_mask) & (~num_pages_per_blk_mask);
-	while (page < lastpage) {
+	t = current_time_hires();
+	while (page < lastpage && tail_blocks-- > 0) {
 		if (flash_erase_block(flash_cmdlist, flash_ptrlist, page)) {
 			dprintf(INFO, "flash_write_image: bad block @ %d\n",
 				page / num_pages_per_blk);
 		}
+		st.erased_blocks++;
 		page += num_pages_per_blk;
 	}
+	st.erase_us += current_time_hires() - t;
+
+	if (stats)
+		*stats = st;
 
 	dprintf(INFO, "flash_write_image: success\n");
 	return 0;
 }
 
+unsigned flash_tag_size(void)
+{
+	switch (flash_info.type) {
+	case FLASH_8BIT_NAND_DEVICE:
+	case FLASH_16BIT_NAND_DEVICE:
+		/* 4 bytes per codeword, all carried in the last one */
+		return (flash_pagesize >> 9) << 2;
+	case FLASH_ONENAND_DEVICE:
+		/* sum of oobfree_length[] */
+		return 20;
+	default:
+		return 0;
+	}
+}
+
+int
+flash_write_ext(struct ptentry *ptn, unsigned extra_per_page, const void *data,
+		unsigned bytes, unsigned tail_blocks, unsigned flags,
+		struct flash_write_stats *stats)
+{
+	unsigned wsize = flash_pagesize + extra_per_page;
+	const unsigned char *image = data;
+	int ret;
+
+	if (bytes % wsize) {
+		dprintf(CRITICAL,
+			"flash_write_image: image undersized (%d < %d)\n",
+			bytes % wsize, wsize);
+		return -1;
+	}
+
+	mutex_acquire(&flash_lock);
+	ret = flash_write_pages(ptn, image, wsize,
+				extra_per_page ? image + flash_pagesize : NULL,
+				wsize, extra_per_page, bytes / wsize,
+				tail_blocks, flags, stats);
+	mutex_release(&flash_lock);
+	return ret;
+}
+
+int
+flash_write_tags(struct ptentry *ptn, const void *pages, const void *tags,
+		 unsigned tag_size, unsigned npages, unsigned tail_blocks,
+		 unsigned flags, struct flash_write_stats *stats)
+{
+	int ret;
+
+	if (tag_size > flash_tag_size()) {
+		dprintf(CRITICAL,
+			"flash_write_image: %u tag bytes, only %u fit in spare\n",
+			tag_size, flash_tag_size());
+		return -1;
+	}
+
+	mutex_acquire(&flash_lock);
+	ret = flash_write_pages(ptn, pages, flash_pagesize, tags, tag_size,
+				tag_size, npages, tail_blocks, flags, stats);
+	mutex_release(&flash_lock);
+	return ret;
+}
+
+int
+flash_write(struct ptentry *ptn, unsigned extra_per_page, const void *data,
+	    unsigned bytes)
+{
+	return flash_write_ext(ptn, extra_per_page, data, bytes,
+			       FLASH_ERASE_TAIL_ALL, 0, NULL);
+}
+
+int flash_ecc_get_stats(unsigned block, struct flash_ecc_stats *stats)
+{
+	if (block >= flash_info.num_blocks)
+		return -1;
+
+	stats->corrected = ecc_tbl[block].corrected;
+	stats->max_cw = ecc_tbl[block].max_cw;
+	stats->uncorrectable = ecc_tbl[block].uncorrectable;
+	return 0;
+}
+
+/*
+ * Refresh one block: read it with ECC, erase it and program the corrected
+ * data back. Pages that read back erased are left unprogrammed, including
+ * the ones whose ECC check failed only because they are erased. A write
+ * failure is retried once; the block is not marked bad, as that would
+ * shift the rest of a raw image. Returns 1 if the block could not be read
+ * cleanly and was left untouched, -1 if the rewrite failed.
+ */
+static int flash_scrub_block(unsigned block, unsigned char *buf)
+{
+	unsigned first = block * num_pages_per_blk;
+	unsigned wsize = flash_pagesize + 64;
+	unsigned char *image;
+	unsigned n, phys;
+	int tries, r;
+
+	for (n = 0, image = buf; n < num_pages_per_blk; n++, image += wsize) {
+		memset(image + flash_pagesize, 0xff, 64);
+		r = _flash_read_page(flash_cmdlist, flash_ptrlist, first + n,
+				     image, image + flash_pagesize);
+		/* erased pages have no valid ECC and fail the read; they
+		   stay erased in the rewrite */
+		if (r && flash_page_is_erased(image, flash_pagesize)) {
+			memset(image + flash_pagesize, 0xff, 64);
+			r = 0;
+		}
+		if (r) {
+			dprintf(CRITICAL,
+				"flash_scrub: read failure @ page %d, skipped\n",
+				first + n);
+			return 1;
+		}
+	}
+	if (ecc_tbl[block].uncorrectable) {
+		dprintf(CRITICAL, "flash_scrub: block %d has lost data, skipped\n",
+			block);
+		return 1;
+	}
+
+	for (tries = 0; tries < 2; tries++) {
+		r = flash_erase_block(flash_cmdlist, flash_ptrlist, first);
+		for (n = 0, image = buf; !r && n < num_pages_per_blk;
+		     n++, image += wsize) {
+			if (flash_page_is_erased(image, wsize))
+				continue;
+			phys = arm_mmu_virt2phy((unsigned)image);
+			r = _flash_write_page(flash_cmdlist, flash_ptrlist,
+					      first + n, (void *)phys,
+					      (void *)(phys + flash_pagesize));
+		}
+		if (!r)
+			break;
+	}
+	if (r) {
+		dprintf(CRITICAL, "flash_scrub: rewrite of block %d failed, "
+			"stopping\n", block);
+		return -1;
+	}
+
+	memset(&ecc_tbl[block], 0, sizeof(ecc_tbl[block]));
+	return 0;
+}
+
+int flash_scrub(struct ptentry *ptn, unsigned threshold)
+{
+	unsigned block;
+	unsigned char *buf = NULL;
+	int scrubbed = 0;
+	int r;
+
+	mutex_acquire(&flash_lock);
+	set_nand_configuration(ptn->type);
+
+	for (block = ptn->start; block < ptn->start + ptn->length; block++) {
+		if (bbtbl[block] == 1 || !ecc_tbl[block].max_cw ||
+		    ecc_tbl[block].max_cw < threshold)
+			continue;
+
+		if (!buf) {
+			buf = memalign(32, num_pages_per_blk *
+				       (flash_pagesize + 64));
+			if (!buf) {
+				scrubbed = -1;
+				break;
+			}
+		}
+
+		dprintf(INFO, "flash_scrub: %s block %d, %d bitflips/cw\n",
+			ptn->name, block, ecc_tbl[block].max_cw);
+		r = flash_scrub_block(block, buf);
+		if (r < 0) {
+			scrubbed = -1;
+			break;
+		}
+		if (!r)
+			scrubbed++;
+	}
+
+	mutex_release(&flash_lock);
+	free(buf);
+	return scrubbed;
+}
+
+#if WITH_LIB_CONSOLE
+
+#include <lib/console.h>
+
+static int cmd_nand(int argc, const cmd_args *argv)
+{
+	struct ptentry *ptn;
+	unsigned block;
+	int ret;
+
+	if (argc < 3 || !flash_ptable ||
+	    (strcmp(argv[1].str, "ecc") && strcmp(argv[1].str, "scrub"))) {
+		printf("usage: %s ecc|scrub <partition> [threshold]\n",
+		       argv[0].str);
+		return -1;
+	}
+
+	ptn = ptable_find(flash_ptable, argv[2].str);
+	if (!ptn) {
+		printf("no partition %s\n", argv[2].str);
+		return -1;
+	}
+
+	if (!strcmp(argv[1].str, "scrub")) {
+		ret = flash_scrub(ptn, argc > 3 ? argv[3].u :
+				  NAND_SCRUB_THRESHOLD);
+		printf("%s: %d blocks scrubbed\n", ptn->name, ret);
+		return ret < 0 ? ret : 0;
+	}
+
+	printf("%s: ecc %u bits/cw, blocks with corrected bitflips:\n",
+	       ptn->name, flash_ecc_strength());
+	for (block = ptn->start; block < ptn->start + ptn->length; block++) {
+		if (!ecc_tbl[block].corrected && !ecc_tbl[block].uncorrectable)
+			continue;
+		printf("  block %u: %u corrected, max %u/cw, %u uncorrectable\n",
+		       block, ecc_tbl[block].corrected, ecc_tbl[block].max_cw,
+		       ecc_tbl[block].uncorrectable);
+	}
+	return 0;
+}
+
+STATIC_COMMAND_START
+	{ "nand", "nand ecc statistics and scrubbing", &cmd_nand },
+STATIC_COMMAND_END(nand);
+
+#endif
+
 #if 0
 static int flash_read_page(unsigned page, void *data, void *extra)
 {
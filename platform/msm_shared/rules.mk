@@ -29,6 +29,7 @@ ifeq ($(PLATFORM),msm8x60)
 			$(LOCAL_DIR)/qgic.o \
 			$(LOCAL_DIR)/mdp4.o \
 			$(LOCAL_DIR)/certificate.o \
+			$(LOCAL_DIR)/certificate_key.o \
 			$(LOCAL_DIR)/image_verify.o \
 			$(LOCAL_DIR)/hdmi.o \
 			$(LOCAL_DIR)/interrupts.o \
@@ -44,6 +45,7 @@ ifeq ($(PLATFORM),msm8960)
 			$(LOCAL_DIR)/crypto4_eng.o \
 			$(LOCAL_DIR)/crypto_hash.o \
 			$(LOCAL_DIR)/certificate.o \
+			$(LOCAL_DIR)/certificate_key.o \
 			$(LOCAL_DIR)/image_verify.o \
 			$(LOCAL_DIR)/scm.o \
 			$(LOCAL_DIR)/interrupts.o \
@@ -78,6 +80,7 @@ ifeq ($(PLATFORM),msm7x27a)
 			$(LOCAL_DIR)/crypto_eng.o \
 			$(LOCAL_DIR)/crypto_hash.o \
 			$(LOCAL_DIR)/certificate.o \
+			$(LOCAL_DIR)/certificate_key.o \
 			$(LOCAL_DIR)/image_verify.o \
 			$(LOCAL_DIR)/qgic.o \
 			$(LOCAL_DIR)/interrupts.o \
@@ -102,6 +105,7 @@ ifeq ($(PLATFORM),msm7x30)
 			$(LOCAL_DIR)/lcdc.o \
 			$(LOCAL_DIR)/mddi.o \
 			$(LOCAL_DIR)/certificate.o \
+			$(LOCAL_DIR)/certificate_key.o \
 			$(LOCAL_DIR)/image_verify.o \
 			$(LOCAL_DIR)/timer.o
 endif
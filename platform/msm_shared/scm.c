@@ -320,3 +320,20 @@ uint8_t switch_ce_chn_cmd(enum ap_ce_channel_type channel)
 	return resp_buf;
 }
 
+/*
+ * Tells the secure side where a core released from reset starts
+ * executing. flags selects the core(s), e.g. SCM_FLAG_COLDBOOT_CPU1.
+ */
+int scm_set_boot_addr(uint32_t addr, uint32_t flags)
+{
+	struct {
+		uint32_t flags;
+		uint32_t addr;
+		} __PACKED cmd_buf;
+
+	cmd_buf.flags = flags;
+	cmd_buf.addr = addr;
+
+	return scm_call(SCM_SVC_BOOT, SCM_BOOT_ADDR, &cmd_buf, sizeof(cmd_buf),
+			NULL, 0);
+}
@@ -0,0 +1,157 @@
+#!/usr/bin/env perl
+#
+# Copyright (c) 2011, Code Aurora Forum. All rights reserved.
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+#     * Redistributions of source code must retain the above copyright
+#       notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above
+#       copyright notice, this list of conditions and the following
+#       disclaimer in the documentation and/or other materials provided
+#       with the distribution.
+#     * Neither the name of Code Aurora Forum, Inc. nor the names of its
+#       contributors may be used to endorse or promote products derived
+#       from this software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+# WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+# ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+# BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+# BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+# WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+# OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+# Extract the RSA public key from the DER certificate embedded in
+# platform/msm_shared/certificate.c and emit it as a struct certificate_key
+# with the Montgomery constants precomputed, so the bootloader can verify
+# signatures without parsing X509 at boot.
+#
+# usage: mkcertkey.pl platform/msm_shared/certificate.c \
+#            > platform/msm_shared/certificate_key.c
+
+use strict;
+use warnings;
+use Math::BigInt;
+
+my $src = shift or die "usage: $0 certificate.c\n";
+open(my $fh, '<', $src) or die "$src: $!\n";
+my $text = do { local $/; <$fh> };
+close($fh);
+
+$text =~ s{/\*.*?\*/}{}sg;
+$text =~ /certBuffer\s*\[[^\]]*\]\s*=\s*\{(.*?)\}/s
+	or die "$src: certBuffer not found\n";
+my @der = map { hex } ($1 =~ /0x([0-9a-fA-F]{1,2})/g);
+
+# Returns (tag, content offset, content length) of the TLV at $pos.
+sub tlv {
+	my ($pos) = @_;
+	my $tag = $der[$pos++];
+	my $len = $der[$pos++];
+	if ($len & 0x80) {
+		my $n = $len & 0x7f;
+		die "bad DER length at $pos\n" if ($n == 0 || $n > 3);
+		$len = 0;
+		$len = ($len << 8) | $der[$pos++] for (1 .. $n);
+	}
+	die "DER overrun at $pos\n" if ($pos + $len > @der);
+	return ($tag, $pos, $len);
+}
+
+sub expect {
+	my ($pos, $want) = @_;
+	my ($tag, $off, $len) = tlv($pos);
+	die sprintf("expected tag 0x%02x, got 0x%02x at %d\n", $want, $tag, $pos)
+		if ($tag != $want);
+	return ($off, $len);
+}
+
+sub next_tlv {
+	my ($pos) = @_;
+	my (undef, $off, $len) = tlv($pos);
+	return $off + $len;
+}
+
+sub integer {
+	my ($off, $len) = @_;
+	my $hex = join('', map { sprintf("%02x", $_) } @der[$off .. $off + $len - 1]);
+	return Math::BigInt->from_hex($hex);
+}
+
+# Certificate ::= SEQUENCE { tbsCertificate, signatureAlgorithm, signature }
+my ($p) = expect(0, 0x30);
+($p) = expect($p, 0x30);
+# optional version [0], serial, signature, issuer, validity, subject
+$p = next_tlv($p) if ($der[$p] == 0xa0);
+$p = next_tlv($p) for (1 .. 5);
+# SubjectPublicKeyInfo ::= SEQUENCE { algorithm, BIT STRING }
+($p) = expect($p, 0x30);
+$p = next_tlv($p);
+my ($bits) = expect($p, 0x03);
+die "unexpected unused bits in key\n" if ($der[$bits] != 0);
+# RSAPublicKey ::= SEQUENCE { modulus INTEGER, publicExponent INTEGER }
+($p) = expect($bits + 1, 0x30);
+my ($n_off, $n_len) = expect($p, 0x02);
+my ($e_off, $e_len) = expect($n_off + $n_len, 0x02);
+
+my $n = integer($n_off, $n_len);
+my $e = integer($e_off, $e_len);
+
+my $nbits = length($n->as_bin()) - 2;
+my $num = int(($nbits + 31) / 32);
+die "modulus is $nbits bits, expected 2048\n" if ($num != 64);
+die "unsupported exponent\n" if ($e < 3 || $e > 0xffffffff || $e->is_even());
+
+my $w = Math::BigInt->new(1)->blsft(32);
+my $n0 = $w->copy->bsub(Math::BigInt->new($n)->bmodinv($w))->bmod($w);
+my $rr = Math::BigInt->new(1)->blsft(64 * $num)->bmod($n);
+
+sub words {
+	my ($v) = @_;
+	my @out;
+	$v = $v->copy;
+	for (1 .. $num) {
+		push @out, sprintf("0x%08x", $v->copy->band(0xffffffff)->numify);
+		$v->brsft(32);
+	}
+	return @out;
+}
+
+sub emit_words {
+	my @w = @_;
+	my $s = '';
+	while (my @row = splice(@w, 0, 6)) {
+		$s .= "\t\t" . join(', ', @row) . ",\n";
+	}
+	return $s;
+}
+
+open(my $hdr, '<', $src) or die "$src: $!\n";
+while (<$hdr>) {
+	print;
+	last if m{^\s*\*/};
+}
+close($hdr);
+
+print <<"___";
+/*
+ * Generated from certBuffer by scripts/mkcertkey.pl, do not edit.
+ */
+#include <certificate.h>
+
+const struct certificate_key certKey = {
+	.num = $num,
+	.n0 = ${\ sprintf("0x%08x", $n0->numify)},
+	.e = ${\ $e->numify},
+	.n = {
+${\ emit_words(words($n))}	},
+	.rr = {
+${\ emit_words(words($rr))}	},
+};
+___
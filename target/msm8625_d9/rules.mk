@@ -35,6 +35,9 @@ DEFINES += DISPLAY_MIPI_CMD_PANEL_NOVATEK_SHARP_QHD=1		#linxc add +++ 2012-12-19
 DEFINES += USE_PCOM_SECBOOT=1
 DEFINES += TARGET_USES_GIC_VIC=1
 DEFINES += MIPI_VIDEO_MODE=0
+# Rewrite boot blocks close to the ECC limit while booting. A power loss
+# between the erase and the reprogram of a block corrupts the boot image.
+DEFINES += NAND_SCRUB=1
 
 MODULES += \
 	dev/keys \
@@ -16,6 +16,9 @@ SCRATCH_ADDR     := 0x90000000
 
 KEYS_USE_GPIO_KEYPAD := 1
 
+# run the second krait as a job worker while booting, see arch/arm/smp.c
+ENABLE_SMP := 1
+
 DEFINES += DISPLAY_SPLASH_SCREEN=1
 DEFINES += DISPLAY_TYPE_MIPI=1
 